@@ -21,21 +21,30 @@ extern "C" {
 
 #include "switch/kernel/svc.h"
 #include "switch/kernel/wait.h"
+#include "switch/kernel/waitset.h"
 #include "switch/kernel/tmem.h"
 #include "switch/kernel/shmem.h"
 #include "switch/kernel/mutex.h"
 #include "switch/kernel/event.h"
 #include "switch/kernel/levent.h"
 #include "switch/kernel/uevent.h"
+#include "switch/kernel/lsemaphore.h"
+#include "switch/kernel/lbarrier.h"
+#include "switch/kernel/llatch.h"
+#include "switch/kernel/spscqueue.h"
+#include "switch/kernel/mpmcqueue.h"
 #include "switch/kernel/utimer.h"
+#include "switch/kernel/timerwheel.h"
 #include "switch/kernel/rwlock.h"
 #include "switch/kernel/condvar.h"
 #include "switch/kernel/thread.h"
 #include "switch/kernel/semaphore.h"
 #include "switch/kernel/virtmem.h"
 #include "switch/kernel/detect.h"
+#include "switch/kernel/topology.h"
 #include "switch/kernel/random.h"
 #include "switch/kernel/jit.h"
+#include "switch/kernel/codecache.h"
 #include "switch/kernel/barrier.h"
 
 #include "switch/sf/hipc.h"
@@ -150,6 +159,7 @@ extern "C" {
 #include "switch/nvidia/gpu_channel.h"
 
 #include "switch/audio/driver.h"
+#include "switch/audio/adpcm.h"
 
 #include "switch/applets/libapplet.h"
 #include "switch/applets/album_la.h"
@@ -170,6 +180,16 @@ extern "C" {
 #include "switch/runtime/nxlink.h"
 #include "switch/runtime/resolver.h"
 #include "switch/runtime/pad.h"
+#include "switch/runtime/input_sampler.h"
+#include "switch/runtime/task_scheduler.h"
+#include "switch/runtime/tcalloc.h"
+#include "switch/runtime/profiler.h"
+#include "switch/runtime/trace.h"
+#include "switch/runtime/trace_file.h"
+#include "switch/runtime/connpool.h"
+#include "switch/runtime/nxlink_log.h"
+#include "switch/runtime/plugin.h"
+#include "switch/runtime/startup.h"
 #include "switch/runtime/ringcon.h"
 #include "switch/runtime/btdev.h"
 
@@ -180,6 +200,7 @@ extern "C" {
 #include "switch/runtime/devices/fs_dev.h"
 #include "switch/runtime/devices/romfs_dev.h"
 #include "switch/runtime/devices/socket.h"
+#include "switch/runtime/devices/ssl_stream.h"
 
 #include "switch/crypto/aes.h"
 #include "switch/crypto/aes_cbc.h"
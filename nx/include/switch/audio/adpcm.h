@@ -0,0 +1,63 @@
+/**
+ * @file adpcm.h
+ * @brief DSP-ADPCM encoder/decoder, for producing PcmFormat_Adpcm wavebuf data.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../services/audren.h"
+
+#define ADPCM_SAMPLES_PER_FRAME 14 ///< Number of samples encoded by a single ADPCM frame.
+#define ADPCM_BYTES_PER_FRAME   8  ///< Size of a single ADPCM frame (1 header byte + 14 4-bit samples).
+
+/// Returns the number of bytes needed to store \p num_samples samples as ADPCM.
+NX_CONSTEXPR size_t adpcmGetEncodedSize(u32 num_samples)
+{
+    return (size_t)((num_samples + ADPCM_SAMPLES_PER_FRAME - 1) / ADPCM_SAMPLES_PER_FRAME) * ADPCM_BYTES_PER_FRAME;
+}
+
+/// Returns the size of a mempool-compatible buffer able to hold \p num_samples samples as ADPCM.
+NX_CONSTEXPR size_t adpcmGetMemPoolSize(u32 num_samples)
+{
+    return (adpcmGetEncodedSize(num_samples) + AUDREN_MEMPOOL_ALIGNMENT - 1) &~ (AUDREN_MEMPOOL_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Computes a set of ADPCM coefficients suited to the specified PCM data.
+ * @param[out] out_params Output coefficient set, to be passed to the voice using \ref audrvVoiceSetExtraParams.
+ * @param[in] pcm Input PCM16 samples.
+ * @param[in] num_samples Number of samples to analyze.
+ * @param[in] stride Distance between consecutive samples in \p pcm, in samples (1 for mono data, or the channel count for interleaved data).
+ * @note This performs a full analysis of the input and is intended to be run once per sound, typically at load time.
+ * @return Result code.
+ */
+Result adpcmComputeParameters(AudioRendererAdpcmParameters* out_params, const s16* pcm, u32 num_samples, u32 stride);
+
+/**
+ * @brief Encodes PCM16 samples to ADPCM.
+ * @param[out] out Output buffer, which must be at least \ref adpcmGetEncodedSize bytes long.
+ * @param[in] out_size Size of the output buffer.
+ * @param[in] pcm Input PCM16 samples.
+ * @param[in] num_samples Number of samples to encode.
+ * @param[in] stride Distance between consecutive samples in \p pcm, in samples.
+ * @param[in] params Coefficient set to use, usually obtained with \ref adpcmComputeParameters.
+ * @param[in,out] ctx Decoder context. On input, its history contains the samples preceding \p pcm (zero for the start of a stream).
+ *                    On output, it describes the decoder state after the last encoded sample, so that it can be passed to a subsequent call.
+ * @param[out] out_start_ctx Optional (may be NULL). Receives the decoder context at the start of the encoded data, suitable for use as a wavebuf context.
+ * @note When \p num_samples is not a multiple of \ref ADPCM_SAMPLES_PER_FRAME, the last frame is zero-padded. Only the last call of a stream should do this.
+ * @note The output buffer is written to by the CPU; it must be flushed with \ref armDCacheFlush before being used by the audio renderer.
+ * @return Result code.
+ */
+Result adpcmEncode(void* out, size_t out_size, const s16* pcm, u32 num_samples, u32 stride, const AudioRendererAdpcmParameters* params, AudioRendererAdpcmContext* ctx, AudioRendererAdpcmContext* out_start_ctx);
+
+/**
+ * @brief Decodes ADPCM data back to PCM16, mainly intended for verifying encoder output.
+ * @param[out] pcm Output PCM16 samples.
+ * @param[in] num_samples Number of samples to decode.
+ * @param[in] in Input ADPCM data, which must be at least \ref adpcmGetEncodedSize bytes long.
+ * @param[in] in_size Size of the input data.
+ * @param[in] params Coefficient set used to encode the data.
+ * @param[in,out] ctx Decoder context. On input, its history contains the samples preceding the data; on output, it describes the state after the last decoded sample.
+ * @return Result code.
+ */
+Result adpcmDecode(s16* pcm, u32 num_samples, const void* in, size_t in_size, const AudioRendererAdpcmParameters* params, AudioRendererAdpcmContext* ctx);
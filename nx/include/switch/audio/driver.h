@@ -17,14 +17,32 @@ typedef struct {
     AudioRendererVoiceInfoIn* in_voices;
     AudioRendererMixInfoIn* in_mixes;
     AudioRendererSinkInfoIn* in_sinks;
+    bool is_dirty; ///< Set whenever the input parameters are modified; must be set manually when modifying the in_* arrays directly.
 } AudioDriver;
 
 Result audrvCreate(AudioDriver* d, const AudioRendererConfig* config, int num_final_mix_channels);
 Result audrvUpdate(AudioDriver* d);
+bool audrvNeedsUpdate(AudioDriver* d); ///< Always true when the renderer was configured with performance frames (num_perf_frames != 0), as those must be drained every update.
 void audrvClose(AudioDriver* d);
 
 //-----------------------------------------------------------------------------
 
+typedef struct {
+    u32 total_processing_time; ///< Total DSP time spent on the frame, in microseconds.
+    u32 voice_drop_count;
+    u32 num_entries;
+    u32 num_details;
+    const AudioRendererPerformanceEntry* entries;
+    const AudioRendererPerformanceDetail* details;
+} AudioDriverPerformanceFrame;
+
+int audrvPerformanceGetFrameCount(AudioDriver* d);
+const AudioDriverPerformanceFrame* audrvPerformanceGetFrame(AudioDriver* d, int index);
+u32 audrvPerformanceGetNodeProcessingTime(AudioDriver* d, u32 node_id);
+void audrvPerformanceSetDetailTarget(AudioDriver* d, u32 node_id);
+
+//-----------------------------------------------------------------------------
+
 int audrvMemPoolAdd(AudioDriver* d, void* buffer, size_t size);
 bool audrvMemPoolRemove(AudioDriver* d, int id);
 bool audrvMemPoolAttach(AudioDriver* d, int id);
@@ -70,46 +88,59 @@ u32 audrvVoiceGetPlayedSampleCount(AudioDriver* d, int id);
 u32 audrvVoiceGetVoiceDropsCount(AudioDriver* d, int id);
 void audrvVoiceSetBiquadFilter(AudioDriver* d, int id, int biquad_id, float a0, float a1, float a2, float b0, float b1, float b2);
 
+static inline u32 audrvVoiceGetNodeId(AudioDriver* d, int id)
+{
+    return d->in_voices[id].node_id;
+}
+
 static inline void audrvVoiceSetExtraParams(AudioDriver* d, int id, const void* params, size_t params_size)
 {
+    d->is_dirty = true;
     d->in_voices[id].extra_params_ptr = params;
     d->in_voices[id].extra_params_sz = params_size;
 }
 
 static inline void audrvVoiceSetDestinationMix(AudioDriver* d, int id, int mix_id)
 {
+    d->is_dirty = true;
     d->in_voices[id].dest_mix_id = mix_id;
     d->in_voices[id].dest_splitter_id = AUDREN_UNUSED_SPLITTER_ID;
 }
 
 static inline void audrvVoiceSetMixFactor(AudioDriver* d, int id, float factor, int src_channel_id, int dest_channel_id)
 {
+    d->is_dirty = true;
     int channel_id = d->in_voices[id].channel_ids[src_channel_id];
     d->in_channels[channel_id].mix[dest_channel_id] = factor;
 }
 
 static inline void audrvVoiceSetVolume(AudioDriver* d, int id, float volume)
 {
+    d->is_dirty = true;
     d->in_voices[id].volume = volume;
 }
 
 static inline void audrvVoiceSetPitch(AudioDriver* d, int id, float pitch)
 {
+    d->is_dirty = true;
     d->in_voices[id].pitch = pitch;
 }
 
 static inline void audrvVoiceSetPriority(AudioDriver* d, int id, int priority)
 {
+    d->is_dirty = true;
     d->in_voices[id].priority = priority;
 }
 
 static inline void audrvVoiceClearBiquadFilter(AudioDriver* d, int id, int biquad_id)
 {
+    d->is_dirty = true;
     d->in_voices[id].biquads[biquad_id].enable = false;
 }
 
 static inline void audrvVoiceSetPaused(AudioDriver* d, int id, bool paused)
 {
+    d->is_dirty = true;
     d->in_voices[id].state = paused ? AudioRendererVoicePlayState_Paused : AudioRendererVoicePlayState_Started;
 }
 
@@ -123,19 +154,27 @@ static inline void audrvVoiceStart(AudioDriver* d, int id)
 int audrvMixAdd(AudioDriver* d, int sample_rate, int num_channels);
 void audrvMixRemove(AudioDriver* d, int id);
 
+static inline u32 audrvMixGetNodeId(AudioDriver* d, int id)
+{
+    return d->in_mixes[id].node_id;
+}
+
 static inline void audrvMixSetDestinationMix(AudioDriver* d, int id, int mix_id)
 {
+    d->is_dirty = true;
     d->in_mixes[id].dest_mix_id = mix_id;
     d->in_mixes[id].dest_splitter_id = AUDREN_UNUSED_SPLITTER_ID;
 }
 
 static inline void audrvMixSetMixFactor(AudioDriver* d, int id, float factor, int src_channel_id, int dest_channel_id)
 {
+    d->is_dirty = true;
     d->in_mixes[id].mix[src_channel_id][dest_channel_id] = factor;
 }
 
 static inline void audrvMixSetVolume(AudioDriver* d, int id, float volume)
 {
+    d->is_dirty = true;
     d->in_mixes[id].volume = volume;
 }
 
@@ -0,0 +1,104 @@
+/**
+ * @file codecache.h
+ * @brief Code cache allocator on top of JIT buffers.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "mutex.h"
+#include "jit.h"
+
+/// Allocation granularity of code cache blocks (one cache line).
+#define CODECACHE_ALIGN 0x40
+
+/// Free range within a code cache region.
+typedef struct CodeCacheFreeNode CodeCacheFreeNode;
+struct CodeCacheFreeNode {
+    CodeCacheFreeNode* next;
+    size_t offset;
+    size_t size;
+};
+
+/// Code cache region, backed by a single JIT buffer.
+typedef struct {
+    Jit jit;
+    CodeCacheFreeNode* free_list;   ///< Free ranges, sorted by offset.
+    size_t dirty_start;             ///< Start of the range written in the current batch.
+    size_t dirty_end;               ///< End of the range written in the current batch (0 if none).
+} CodeCacheRegion;
+
+/// Code cache object.
+typedef struct {
+    RMutex mutex;
+    size_t region_size;
+    u32 max_regions;
+    u32 num_regions;
+    CodeCacheRegion* regions;
+    u32 batch_depth;
+} CodeCache;
+
+/// Code cache block.
+typedef struct {
+    void* rw_addr;                  ///< Writable alias of the block.
+    void* rx_addr;                  ///< Executable alias of the block.
+    size_t size;                    ///< Size of the block.
+    u32 region;                     ///< Index of the region containing the block.
+    size_t offset;                  ///< Offset of the block within its region.
+} CodeCacheBlock;
+
+/**
+ * @brief Creates a code cache.
+ * @param c Code cache.
+ * @param region_size Size of each JIT region, created on demand.
+ * @param max_regions Maximum number of JIT regions.
+ * @return Result code.
+ */
+Result codecacheCreate(CodeCache* c, size_t region_size, u32 max_regions);
+
+/**
+ * @brief Destroys a code cache, along with all of its blocks.
+ * @param c Code cache.
+ */
+void codecacheClose(CodeCache* c);
+
+/**
+ * @brief Allocates a block of code.
+ * @param c Code cache.
+ * @param size Size of the block, rounded up to \ref CODECACHE_ALIGN.
+ * @param[out] out Output block.
+ * @note A new region is created when none of the existing ones has enough free space (blocks larger than the region size get a dedicated region).
+ * @return Result code.
+ */
+Result codecacheAlloc(CodeCache* c, size_t size, CodeCacheBlock* out);
+
+/**
+ * @brief Frees a block of code.
+ * @param c Code cache.
+ * @param b Block.
+ */
+void codecacheFree(CodeCache* c, const CodeCacheBlock* b);
+
+/**
+ * @brief Starts a write batch. Batches can be nested, only the outermost one has an effect.
+ * @param c Code cache.
+ * @note The code cache is locked for the duration of the batch.
+ */
+void codecacheBeginBatch(CodeCache* c);
+
+/**
+ * @brief Prepares a range of a block to be written in the current batch.
+ * @param c Code cache.
+ * @param b Block.
+ * @param offset Offset of the range within the block.
+ * @param size Size of the range.
+ * @note With \ref JitType_SetProcessMemoryPermission, this makes the whole region non-executable until the end of the batch.
+ * @return Result code.
+ */
+Result codecachePrepareWrite(CodeCache* c, const CodeCacheBlock* b, size_t offset, size_t size);
+
+/**
+ * @brief Ends a write batch: flushes the caches for the written ranges only, and makes the written regions executable again.
+ * @param c Code cache.
+ * @return Result code.
+ */
+Result codecacheEndBatch(CodeCache* c);
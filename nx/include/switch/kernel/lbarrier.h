@@ -0,0 +1,32 @@
+/**
+ * @file lbarrier.h
+ * @brief Light barrier synchronization primitive [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// User-mode light barrier structure.
+typedef struct LBarrier {
+    u32 count;      ///< Number of threads which reached the barrier in the current generation.
+    u32 total;      ///< Number of threads to wait on.
+    u32 generation; ///< Incremented each time all threads reach the barrier.
+} LBarrier;
+
+/**
+ * @brief Initializes a user-mode light barrier.
+ * @param[out] b Pointer to \ref LBarrier structure.
+ * @param[in] thread_count Number of threads the barrier must wait for.
+ */
+NX_CONSTEXPR void lbarrierInit(LBarrier* b, u32 thread_count) {
+    b->count = 0;
+    b->total = thread_count;
+    b->generation = 0;
+}
+
+/**
+ * @brief Waits until all threads have called lbarrierWait.
+ * @param[in] b Pointer to \ref LBarrier structure.
+ * @return true for exactly one of the threads (the last one to arrive), false for the others.
+ */
+bool lbarrierWait(LBarrier* b);
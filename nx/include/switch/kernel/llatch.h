@@ -0,0 +1,48 @@
+/**
+ * @file llatch.h
+ * @brief Light latch (single-use countdown) synchronization primitive [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// User-mode light latch structure.
+typedef struct LLatch {
+    u32 count;   ///< Remaining count before the latch opens.
+    u32 waiters; ///< Number of threads which may be blocked on the latch.
+} LLatch;
+
+/**
+ * @brief Initializes a user-mode light latch.
+ * @param[out] l Pointer to \ref LLatch structure.
+ * @param[in] count Number of times \ref llatchCountDown must be called before waiting threads are released.
+ */
+NX_CONSTEXPR void llatchInit(LLatch* l, u32 count) {
+    l->count = count;
+    l->waiters = 0;
+}
+
+/**
+ * @brief Decrements the latch counter, releasing all waiting threads when it reaches zero.
+ * @param[in] l Pointer to \ref LLatch structure.
+ * @param[in] n Value to decrement the counter by.
+ * @note This only enters the kernel if the counter reaches zero while threads are waiting.
+ */
+void llatchCountDown(LLatch* l, u32 n);
+
+/**
+ * @brief Waits for the latch counter to reach zero.
+ * @param[in] l Pointer to \ref LLatch structure.
+ * @param[in] timeout_ns Timeout in nanoseconds (pass UINT64_MAX to wait indefinitely).
+ * @return true if the latch is open, false if wait timed out.
+ */
+bool llatchWait(LLatch* l, u64 timeout_ns);
+
+/**
+ * @brief Checks whether the latch counter reached zero.
+ * @param[in] l Pointer to \ref LLatch structure.
+ * @return true if the latch is open, false otherwise.
+ */
+static inline bool llatchTryWait(LLatch* l) {
+    return __atomic_load_n(&l->count, __ATOMIC_ACQUIRE) == 0;
+}
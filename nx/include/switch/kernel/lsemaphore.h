@@ -0,0 +1,46 @@
+/**
+ * @file lsemaphore.h
+ * @brief Light semaphore synchronization primitive [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// User-mode light semaphore structure.
+typedef struct LSemaphore {
+    s32 count;   ///< Number of available resources.
+    u32 waiters; ///< Number of threads which may be blocked on the semaphore.
+} LSemaphore;
+
+/**
+ * @brief Initializes a user-mode light semaphore.
+ * @param[out] s Pointer to \ref LSemaphore structure.
+ * @param[in] initial_count Initial value for the internal counter (typically the number of free resources).
+ */
+NX_CONSTEXPR void lsemaphoreInit(LSemaphore* s, s32 initial_count) {
+    s->count = initial_count;
+    s->waiters = 0;
+}
+
+/**
+ * @brief Decrements the semaphore counter, waiting for it to become non-zero if needed.
+ * @param[in] s Pointer to \ref LSemaphore structure.
+ * @param[in] timeout_ns Timeout in nanoseconds (pass UINT64_MAX to wait indefinitely).
+ * @return true if the counter was decremented, false if wait timed out.
+ * @note This only enters the kernel if the counter is zero.
+ */
+bool lsemaphoreWait(LSemaphore* s, u64 timeout_ns);
+
+/**
+ * @brief Attempts to decrement the semaphore counter without waiting.
+ * @param[in] s Pointer to \ref LSemaphore structure.
+ * @return true if the counter was decremented, false otherwise.
+ */
+bool lsemaphoreTryWait(LSemaphore* s);
+
+/**
+ * @brief Increments the semaphore counter, waking up a waiting thread if there is one.
+ * @param[in] s Pointer to \ref LSemaphore structure.
+ * @note This only enters the kernel if there are threads waiting on the semaphore.
+ */
+void lsemaphoreSignal(LSemaphore* s);
@@ -0,0 +1,63 @@
+/**
+ * @file mpmcqueue.h
+ * @brief Bounded lock-free multi-producer multi-consumer queue.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "wait.h"
+
+typedef struct MpmcQueue MpmcQueue;
+
+/// Multi-producer multi-consumer queue object.
+struct MpmcQueue {
+    Waitable waitable;
+    bool has_listeners;
+    u8* buffer;
+    u32 cell_size;
+    u32 elem_size;
+    u32 mask;
+    u32 head;
+    u32 tail;
+};
+
+/// Returns the size of the buffer required by a multi-producer multi-consumer queue (each entry carries a sequence number).
+NX_CONSTEXPR size_t mpmcqueueGetBufferSize(u32 elem_size, u32 capacity)
+{
+    return (size_t)(8 + ((elem_size + 7) &~ 7)) * capacity;
+}
+
+/// Creates a waiter for a multi-producer multi-consumer queue, which is signalled while the queue is non-empty.
+static inline Waiter waiterForMpmcQueue(MpmcQueue* q)
+{
+    Waiter wait_obj;
+    wait_obj.type = WaiterType_Waitable;
+    wait_obj.waitable = &q->waitable;
+    return wait_obj;
+}
+
+/**
+ * @brief Creates a multi-producer multi-consumer queue.
+ * @param[out] q MpmcQueue object.
+ * @param[in] buffer Storage for the queue entries, which must be 8-byte aligned and at least \ref mpmcqueueGetBufferSize bytes long.
+ * @param[in] elem_size Size of an entry.
+ * @param[in] capacity Maximum number of entries in the queue, must be a power of two.
+ */
+void mpmcqueueCreate(MpmcQueue* q, void* buffer, u32 elem_size, u32 capacity);
+
+/**
+ * @brief Pushes an entry to the queue.
+ * @param[in] q MpmcQueue object.
+ * @param[in] elem Entry to copy into the queue.
+ * @return true on success, false if the queue is full.
+ * @note This only takes the waitable mutex if a thread is waiting on the queue.
+ */
+bool mpmcqueuePush(MpmcQueue* q, const void* elem);
+
+/**
+ * @brief Pops an entry from the queue.
+ * @param[in] q MpmcQueue object.
+ * @param[out] elem Output entry.
+ * @return true on success, false if the queue is empty.
+ * @note When several consumers wait on the queue, all of them are woken up but only some may be able to pop an entry.
+ */
+bool mpmcqueuePop(MpmcQueue* q, void* elem);
@@ -10,11 +10,11 @@
 
 /// Read/write lock structure.
 typedef struct {
-    Mutex mutex;
+    Mutex mutex;                    ///< Protects the slow (blocking) paths.
     CondVar condvar_reader_wait;
     CondVar condvar_writer_wait;
-    u32 read_lock_count;
-    u32 read_waiter_count;
+    u32 state;                      ///< Reader count and writer flags, updated atomically.
+    u32 read_lock_count;            ///< Read locks acquired by the write owner.
     u32 write_lock_count;
     u32 write_waiter_count;
     u32 write_owner_tag;
@@ -29,6 +29,7 @@ void rwlockInit(RwLock* r);
 /**
  * @brief Locks the read/write lock for reading.
  * @param r Read/write lock object.
+ * @note When no writer holds or is waiting for the lock, this is a single atomic operation.
  */
 void rwlockReadLock(RwLock* r);
 
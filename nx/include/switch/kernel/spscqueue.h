@@ -0,0 +1,55 @@
+/**
+ * @file spscqueue.h
+ * @brief Bounded lock-free single-producer single-consumer queue.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "wait.h"
+
+typedef struct SpscQueue SpscQueue;
+
+/// Single-producer single-consumer queue object.
+struct SpscQueue {
+    Waitable waitable;
+    bool has_listeners;
+    u8* buffer;
+    u32 elem_size;
+    u32 mask;
+    u32 head; ///< Read position, only modified by the consumer.
+    u32 tail; ///< Write position, only modified by the producer.
+};
+
+/// Creates a waiter for a single-producer single-consumer queue, which is signalled while the queue is non-empty.
+static inline Waiter waiterForSpscQueue(SpscQueue* q)
+{
+    Waiter wait_obj;
+    wait_obj.type = WaiterType_Waitable;
+    wait_obj.waitable = &q->waitable;
+    return wait_obj;
+}
+
+/**
+ * @brief Creates a single-producer single-consumer queue.
+ * @param[out] q SpscQueue object.
+ * @param[in] buffer Storage for the queue entries, which must be at least elem_size*capacity bytes long.
+ * @param[in] elem_size Size of an entry.
+ * @param[in] capacity Maximum number of entries in the queue, must be a power of two.
+ */
+void spscqueueCreate(SpscQueue* q, void* buffer, u32 elem_size, u32 capacity);
+
+/**
+ * @brief Pushes an entry to the queue. Must only be called by the producer thread.
+ * @param[in] q SpscQueue object.
+ * @param[in] elem Entry to copy into the queue.
+ * @return true on success, false if the queue is full.
+ * @note This only takes the waitable mutex if a thread is waiting on the queue.
+ */
+bool spscqueuePush(SpscQueue* q, const void* elem);
+
+/**
+ * @brief Pops an entry from the queue. Must only be called by the consumer thread.
+ * @param[in] q SpscQueue object.
+ * @param[out] elem Output entry.
+ * @return true on success, false if the queue is empty.
+ */
+bool spscqueuePop(SpscQueue* q, void* elem);
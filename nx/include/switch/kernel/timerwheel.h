@@ -0,0 +1,95 @@
+/**
+ * @file timerwheel.h
+ * @brief Hierarchical timer wheel, for managing large numbers of timers.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "wait.h"
+
+#define TIMERWHEEL_LEVELS    4 ///< Number of wheel levels.
+#define TIMERWHEEL_SLOT_BITS 6 ///< log2 of the number of slots per level.
+#define TIMERWHEEL_SLOTS     (1U << TIMERWHEEL_SLOT_BITS)
+
+typedef struct TimerWheel TimerWheel;
+typedef struct TimerWheelEntry TimerWheelEntry;
+
+/// Timer callback.
+typedef void (*TimerWheelCallback)(TimerWheelEntry* e, void* arg);
+
+/// Timer wheel list node.
+typedef struct TimerWheelNode TimerWheelNode;
+struct TimerWheelNode {
+    TimerWheelNode* prev;
+    TimerWheelNode* next;
+};
+
+/// Timer entry. Its storage is owned by the caller and must remain valid while the timer is pending.
+struct TimerWheelEntry {
+    TimerWheelNode node;
+    TimerWheelCallback callback;
+    void* arg;
+    u64 expires;  ///< Expiration time, in wheel units.
+    u64 period;   ///< Period in wheel units, or 0 for one-shot timers.
+    bool pending;
+};
+
+/// Timer wheel object.
+struct TimerWheel {
+    Waitable waitable;
+    u64 granularity;                                        ///< Duration of a wheel unit, in system ticks.
+    u64 current;                                            ///< Time up to which the wheel has been processed, in wheel units.
+    u64 occupied[TIMERWHEEL_LEVELS];                        ///< Bitmap of non-empty slots in each level.
+    TimerWheelNode slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+    TimerWheelNode expired;                                 ///< Timers waiting for their callback to be run.
+};
+
+/// Creates a waiter for a timer wheel, which is signalled when timers need to be processed with \ref timerwheelProcess.
+static inline Waiter waiterForTimerWheel(TimerWheel* tw)
+{
+    Waiter wait_obj;
+    wait_obj.type = WaiterType_Waitable;
+    wait_obj.waitable = &tw->waitable;
+    return wait_obj;
+}
+
+/**
+ * @brief Creates a timer wheel.
+ * @param[out] tw TimerWheel object.
+ * @param[in] granularity Timer resolution (in nanoseconds). Timers expiring within the same unit fire together.
+ * @note Timers up to granularity*2^24 in the future are handled directly; later ones are transparently re-queued.
+ */
+void timerwheelCreate(TimerWheel* tw, u64 granularity);
+
+/**
+ * @brief Initializes a timer entry.
+ * @param[out] e TimerWheelEntry object.
+ * @param[in] callback Function called when the timer fires.
+ * @param[in] arg Argument passed to the callback.
+ */
+void timerwheelEntryInit(TimerWheelEntry* e, TimerWheelCallback callback, void* arg);
+
+/**
+ * @brief Starts (or restarts) a timer.
+ * @param[in] tw TimerWheel object.
+ * @param[in] e TimerWheelEntry object.
+ * @param[in] timeout Time until the timer first fires (in nanoseconds), rounded up to the wheel granularity.
+ * @param[in] period Period of the timer (in nanoseconds), or 0 for a one-shot timer.
+ * @note This is O(1), and can be called from any thread, including from timer callbacks.
+ */
+void timerwheelStart(TimerWheel* tw, TimerWheelEntry* e, u64 timeout, u64 period);
+
+/**
+ * @brief Cancels a timer.
+ * @param[in] tw TimerWheel object.
+ * @param[in] e TimerWheelEntry object.
+ * @note This is O(1), and can be called from any thread, including from timer callbacks.
+ */
+void timerwheelCancel(TimerWheel* tw, TimerWheelEntry* e);
+
+/**
+ * @brief Runs the callbacks of all the expired timers.
+ * @param[in] tw TimerWheel object.
+ * @return Number of callbacks which were run.
+ * @note Callbacks are run on the calling thread, without any lock held.
+ */
+u32 timerwheelProcess(TimerWheel* tw);
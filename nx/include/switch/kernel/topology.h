@@ -0,0 +1,72 @@
+/**
+ * @file topology.h
+ * @brief CPU topology and core load information.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "thread.h"
+
+/// Maximum number of CPU cores.
+#define TOPOLOGY_MAX_CORES 4
+
+/// CPU resources available to the current process.
+typedef struct {
+    u64 core_mask;        ///< Bitmask of the cores the process may use.
+    u64 priority_mask;    ///< Bitmask of the thread priorities the process may use.
+    u32 num_cores;        ///< Number of cores the process may use.
+    s32 default_core;     ///< Preferred core of the main thread, which is also the core used for cpuid -2 by default.
+    s32 highest_priority; ///< Highest (numerically lowest) usable thread priority.
+    s32 lowest_priority;  ///< Lowest (numerically highest) usable thread priority.
+} TopologyInfo;
+
+/// Snapshot of per-core idle tick counters, see \ref topologySampleLoad.
+typedef struct {
+    u64 tick;                                ///< System tick at which the sample was taken.
+    u64 core_mask;                           ///< Cores which were sampled.
+    u64 idle_ticks[TOPOLOGY_MAX_CORES];      ///< Idle tick counter of each sampled core.
+} TopologyLoadSample;
+
+/**
+ * @brief Retrieves the CPU resources available to the current process.
+ * @param[out] out \ref TopologyInfo
+ * @return Result code.
+ */
+Result topologyGetInfo(TopologyInfo* out);
+
+/**
+ * @brief Retrieves the idle tick counter of a core.
+ * @param[in] core Core ID, which must be usable by the process.
+ * @param[out] out Output idle tick count.
+ * @note The kernel only reports this for the core the calling thread is running on, so the calling thread is
+ *       temporarily moved to the requested core.
+ * @return Result code.
+ */
+Result topologyGetIdleTickCount(u32 core, u64* out);
+
+/**
+ * @brief Samples the idle tick counters of all the cores usable by the process.
+ * @param[out] out \ref TopologyLoadSample
+ * @note See \ref topologyGetIdleTickCount regarding migration of the calling thread.
+ * @return Result code.
+ */
+Result topologySampleLoad(TopologyLoadSample* out);
+
+/**
+ * @brief Computes the load of a core between two samples.
+ * @param[in] prev Earlier sample.
+ * @param[in] cur Later sample.
+ * @param[in] core Core ID.
+ * @return Fraction of the time the core was busy (0.0 to 1.0), or a negative value if the core wasn't sampled.
+ */
+float topologyGetCoreLoad(const TopologyLoadSample* prev, const TopologyLoadSample* cur, u32 core);
+
+/**
+ * @brief Pins a set of threads to distinct cores, one core per thread when possible.
+ * @param[in] threads Array of threads.
+ * @param[in] count Number of threads.
+ * @param[in] core_mask Bitmask of cores to use (0 for all the cores usable by the process).
+ * @note Cores other than the main thread's core are used first, then threads are distributed round-robin.
+ * @return Result code.
+ */
+Result topologyPinThreads(Thread* threads, u32 count, u64 core_mask);
@@ -0,0 +1,83 @@
+/**
+ * @file waitset.h
+ * @brief Persistent wait set, for waiting on large numbers of synchronization objects.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "wait.h"
+#include "thread.h"
+
+typedef struct WaitSetEntry WaitSetEntry;
+
+/// Group of up to \ref MAX_WAIT_OBJECTS handles waited on by a single thread (implementation detail).
+typedef struct {
+    Thread thread;                      ///< Helper thread (unused for the first tier, which is waited on by the owner thread).
+    struct WaitSet* ws;
+    bool started;
+    bool needs_cancel;
+    u32 count;
+    s32 ids[MAX_WAIT_OBJECTS];
+    Handle handles[MAX_WAIT_OBJECTS];
+} WaitSetTier;
+
+/// Wait set object.
+typedef struct WaitSet {
+    Mutex mutex;                        ///< Protects the handle tiers and the owner's waiting state.
+    Handle owner;                       ///< Handle of the thread which owns the wait set.
+    u32 capacity;
+    u32 num_tiers;
+    u32 num_timed;                      ///< Number of registered waitables with a pending timeout.
+    u32 rearm_count;
+    bool exiting;
+    bool owner_waiting;                 ///< The owner is blocked in \ref waitsetWait (protected by the mutex).
+    WaitSetEntry* entries;
+    WaitSetTier* tiers;
+    u64* ready;                         ///< Bitmap of entries signalled asynchronously.
+    s32* rearm_list;                    ///< Waitable entries which need to be registered again.
+} WaitSet;
+
+/**
+ * @brief Creates a wait set.
+ * @param[out] ws \ref WaitSet object.
+ * @param[in] capacity Maximum number of objects in the set.
+ * @note A wait set must only be used by the thread which created it.
+ * @note Handles beyond the first \ref MAX_WAIT_OBJECTS are waited on by helper threads, each covering \ref MAX_WAIT_OBJECTS handles.
+ * @return Result code.
+ */
+Result waitsetCreate(WaitSet* ws, u32 capacity);
+
+/**
+ * @brief Closes a wait set, unregistering every object and stopping the helper threads.
+ * @param[in] ws \ref WaitSet object.
+ */
+void waitsetClose(WaitSet* ws);
+
+/**
+ * @brief Adds an object to a wait set.
+ * @param[in] ws \ref WaitSet object.
+ * @param[in] w \ref Waiter describing the object.
+ * @param[out] out_id Identifier of the object within the set, reported by \ref waitsetWait.
+ * @return Result code.
+ */
+Result waitsetAdd(WaitSet* ws, Waiter w, s32* out_id);
+
+/**
+ * @brief Removes an object from a wait set.
+ * @param[in] ws \ref WaitSet object.
+ * @param[in] id Identifier returned by \ref waitsetAdd.
+ * @note Handles must be removed from the set before being closed.
+ */
+void waitsetRemove(WaitSet* ws, s32 id);
+
+/**
+ * @brief Waits for one or more objects in a wait set to be signalled.
+ * @param[in] ws \ref WaitSet object.
+ * @param[out] out_ids Output array receiving the identifiers of the signalled objects.
+ * @param[in] max_ids Size of the output array.
+ * @param[out] out_count Number of identifiers written to the output array.
+ * @param[in] timeout Timeout (in nanoseconds).
+ * @note Registrations are kept between calls; only objects which were reported are registered again.
+ * @note Objects follow the same semantics as with \ref waitObjects (e.g. auto-clear for \ref WaiterType_HandleWithClear and auto-clear UEvents).
+ * @return Result code (KERNELRESULT(TimedOut) if nothing was signalled before the timeout).
+ */
+Result waitsetWait(WaitSet* ws, s32* out_ids, s32 max_ids, s32* out_count, u64 timeout);
@@ -0,0 +1,81 @@
+/**
+ * @file connpool.h
+ * @brief Keep-alive pool of TCP and TLS connections, keyed by host and port.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/mutex.h"
+#include "../kernel/condvar.h"
+#include "../services/ssl.h"
+
+typedef struct ConnPoolHost ConnPoolHost;
+typedef struct ConnPoolConnection ConnPoolConnection;
+
+/// Connection pool configuration.
+typedef struct {
+    SslContext *ssl_context;                ///< SSL context used to create the TLS connections, or NULL to only allow plain TCP connections.
+    SslSessionCacheMode session_cache_mode; ///< Session cache mode of the TLS connections, used to resume sessions when new connections to the same host are needed.
+    u32 max_connections_per_host;           ///< Maximum number of connections to a host which can be acquired at the same time (0 for no limit).
+    u32 max_idle_connections;               ///< Maximum number of idle connections kept across all hosts.
+    u64 idle_timeout;                       ///< Time in nanoseconds after which an idle connection gets closed instead of reused.
+} ConnPoolConfig;
+
+/// Pooled connection.
+struct ConnPoolConnection {
+    ConnPoolConnection *next;
+    ConnPoolHost *host;
+    int fd;                                 ///< fd used to transfer data: an SSL stream fd (see \ref sslStreamOpen) for TLS connections, otherwise the socket.
+    int sockfd;                             ///< Socket fd.
+    int ssl_sockfd;
+    bool is_ssl;                            ///< Whether this is a TLS connection.
+    SslConnection ssl;                      ///< \ref SslConnection of TLS connections.
+    u64 last_used;                          ///< System tick at which the connection was last released.
+    u32 use_count;                          ///< Number of times the connection was acquired.
+};
+
+/// Connection pool object.
+typedef struct {
+    Mutex mutex;
+    CondVar condvar;
+    ConnPoolConfig config;
+    ConnPoolHost *hosts;
+    u32 num_idle;
+} ConnPool;
+
+/**
+ * @brief Creates a connection pool.
+ * @param[out] p \ref ConnPool
+ * @param[in] config \ref ConnPoolConfig
+ * @note The socket driver (and ssl when used) must have been initialized.
+ */
+Result connpoolCreate(ConnPool *p, const ConnPoolConfig *config);
+
+/**
+ * @brief Closes all idle connections and frees the pool.
+ * @note All connections must have been released beforehand.
+ */
+void connpoolClose(ConnPool *p);
+
+/**
+ * @brief Acquires a connection to a host, reusing an idle one if possible.
+ * @param p \ref ConnPool
+ * @param[in] hostname Host name, also used for TLS certificate verification.
+ * @param[in] port Port.
+ * @param[in] use_ssl Whether to use TLS.
+ * @param[in] timeout Timeout in nanoseconds, when waiting for the per-host connection limit.
+ * @param[out] out Output connection, which must be released with \ref connpoolRelease.
+ * @note Idle connections which were closed by the peer are detected and discarded.
+ */
+Result connpoolAcquire(ConnPool *p, const char *hostname, u16 port, bool use_ssl, u64 timeout, ConnPoolConnection **out);
+
+/**
+ * @brief Releases a connection.
+ * @param p \ref ConnPool
+ * @param c \ref ConnPoolConnection
+ * @param[in] reusable Whether the connection can be reused, ie. whether the response was completely read and the server didn't request it to be closed.
+ */
+void connpoolRelease(ConnPool *p, ConnPoolConnection *c, bool reusable);
+
+/// Closes the idle connections which exceeded the idle timeout.
+void connpoolPrune(ConnPool *p);
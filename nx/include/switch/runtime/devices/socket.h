@@ -1,5 +1,6 @@
 #pragma once
 #include "../../types.h"
+#include "../../services/fs.h"
 
 /// BSD service type used by the socket driver.
 typedef enum {
@@ -24,6 +25,21 @@ typedef struct  {
     BsdServiceType bsd_service_type;            ///< BSD service type (typically \ref BsdServiceType_User).
 } SocketInitConfig;
 
+/// Transfer statistics of a socket, see \ref socketStatsInitialize.
+typedef struct {
+    u64 bytes_sent;                             ///< Total bytes sent.
+    u64 bytes_received;                         ///< Total bytes received.
+    u64 first_tick;                             ///< System tick of the first transfer.
+    u64 last_tick;                              ///< System tick of the last transfer.
+    u32 peak_tx_queued;                         ///< Peak number of bytes queued in the send buffer.
+    u32 peak_rx_queued;                         ///< Peak number of bytes queued in the receive buffer.
+    u32 tx_buf_size;                            ///< Current send buffer size (SO_SNDBUF).
+    u32 rx_buf_size;                            ///< Current receive buffer size (SO_RCVBUF).
+    u32 tx_full_count;                          ///< Number of transfers after which the send buffer was (nearly) full.
+    u32 rx_full_count;                          ///< Number of transfers after which the receive buffer was (nearly) full.
+    bool is_tcp;                                ///< Whether this is a TCP socket.
+} SocketStats;
+
 /// Fetch the default configuration for the socket driver.
 const SocketInitConfig *socketGetDefaultInitConfig(void);
 /// Initalize the socket driver.
@@ -33,6 +49,33 @@ Result socketGetLastResult(void);
 /// Deinitialize the socket driver.
 void socketExit(void);
 
+/**
+ * @brief Starts recording transfer statistics for sockets.
+ * @param[in] max_sockets Maximum number of sockets to track, sockets with a higher bsd descriptor are ignored.
+ * @note While enabled, each send/receive operation issues an additional ioctl to sample the queue occupancy: only use this for tuning.
+ * @return Result code.
+ */
+Result socketStatsInitialize(u32 max_sockets);
+/// Stops recording transfer statistics.
+void socketStatsExit(void);
+/// Retrieves the transfer statistics of a socket. Returns 0 on success and -1 on error.
+int socketGetStats(int sockfd, SocketStats *out);
+
+/**
+ * @brief Computes a configuration for \ref socketInitialize from the statistics recorded so far.
+ * @param[out] out Output \ref SocketInitConfig, based on the current configuration.
+ * @note Buffer sizes which got full are doubled, the others are reduced to their peak occupancy with some headroom. sb_efficiency is set to the peak number of concurrently active sockets (up to 8).
+ */
+void socketStatsGetRecommendedConfig(SocketInitConfig *out);
+
+/**
+ * @brief Adjusts the SO_SNDBUF/SO_RCVBUF of a TCP socket from the statistics recorded since the previous call.
+ * @param[in] sockfd Socket.
+ * @note Buffers which got full are doubled, up to the configured maximum buffer sizes and while the total of the tuned buffers fits in the transfer memory budget (sb_efficiency times the maximum buffer size). Mostly empty buffers are halved, down to the initial buffer size.
+ * @return 0 on success and -1 on error.
+ */
+int socketAutotune(int sockfd);
+
 /// Initalize the socket driver using the default configuration.
 NX_INLINE Result socketInitializeDefault(void) {
     return socketInitialize(NULL);
@@ -56,3 +99,15 @@ int socketNifmRequestRegisterSocketDescriptor(NifmRequest* r, int sockfd);
 /// Wrapper for \ref nifmRequestUnregisterSocketDescriptor. Returns 0 on success and -1 on error.
 int socketNifmRequestUnregisterSocketDescriptor(NifmRequest* r, int sockfd);
 
+/**
+ * @brief Sends data from a file to a socket, like sendfile.
+ * @param[in] sockfd Output descriptor, which can be a socket or a SSL stream (see \ref sslStreamOpen).
+ * @param[in] file \ref FsFile
+ * @param[in,out] offset File offset to start reading from, which is advanced by the number of bytes sent.
+ * @param[in] count Number of bytes to send.
+ * @param[in] buffer_size Size of each of the two transfer buffers (0 for 256 KiB).
+ * @note When the data doesn't fit in a single buffer, the file is read by a helper thread while the previous buffer is sent, so that fs and network transfers overlap.
+ * @return Number of bytes sent, which is less than count when the end of the file was reached, or -1 on error (errno==EIO indicates a fs error which can be retrieved with \ref socketGetLastResult).
+ */
+ssize_t socketSendFsFile(int sockfd, FsFile *file, s64 *offset, size_t count, size_t buffer_size);
+
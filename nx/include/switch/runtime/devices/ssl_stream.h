@@ -0,0 +1,30 @@
+/**
+ * @file ssl_stream.h
+ * @brief Buffered SSL connection streams usable as file descriptors.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../../types.h"
+#include "../../services/ssl.h"
+
+/// Default size of the read-ahead and write buffers, which is the maximum TLS record size.
+#define SSL_STREAM_DEFAULT_BUFFER_SIZE 0x4000
+
+/**
+ * @brief Creates a file descriptor for an \ref SslConnection, which can then be used with read(), write(), poll() and select().
+ * @param c \ref SslConnection, which must remain valid until the fd is closed.
+ * @param[in] read_buf_size Size of the read-ahead buffer (0 for \ref SSL_STREAM_DEFAULT_BUFFER_SIZE). Smaller reads are served from it, larger reads bypass it.
+ * @param[in] write_buf_size Size of the write buffer (0 for \ref SSL_STREAM_DEFAULT_BUFFER_SIZE). Smaller writes are coalesced into it until it fills up, the data is flushed or a read is issued.
+ * @note Closing the fd flushes the pending data but doesn't close the \ref SslConnection.
+ * @return The fd on success, -1 on error (with errno set).
+ */
+int sslStreamOpen(SslConnection *c, u32 read_buf_size, u32 write_buf_size);
+
+/// Sends the data pending in the write buffer of an SSL stream fd. Returns 0 on success, -1 on error (with errno set).
+int sslStreamFlush(int fd);
+
+/// Retrieves the \ref SslConnection of an SSL stream fd, or NULL if the fd is not an SSL stream (with errno set).
+SslConnection *sslStreamGetConnection(int fd);
+
+/// Fetch the last ssl Switch result code of an SSL stream operation (thread-local).
+Result sslStreamGetLastResult(void);
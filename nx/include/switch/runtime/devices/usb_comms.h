@@ -8,6 +8,9 @@
 #pragma once
 #include "../../types.h"
 
+/// Maximum number of buffers used by a usbComms stream, which is the number of transfers that can be kept in flight.
+#define USB_COMMS_STREAM_MAX_BUFFERS 8
+
 typedef struct {
     u8 bInterfaceClass;
     u8 bInterfaceSubClass;
@@ -68,3 +71,59 @@ Result usbCommsWriteAsync(void *buffer, size_t size, u32 *urbId, u32 interface);
 Result usbCommsGetWriteResult(u32 urbId, u32 *transferredSize, u32 interface);
 
 ///@}
+
+///@name Streaming API
+/// Keeps several transfers in flight per endpoint using a ring of page-aligned buffers, so that the bus never idles between transfers.
+/// While a stream is active, the synchronous and asynchronous APIs can't be used in the same direction on the same interface.
+///@{
+
+/**
+ * @brief Starts a read stream: every buffer is immediately posted for a host->device transfer.
+ * @param[in] num_buffers Number of buffers, between 2 and \ref USB_COMMS_STREAM_MAX_BUFFERS.
+ * @param[in] buffer_size Size of each buffer (and of each transfer), must be page-aligned.
+ * @param[in] interface Interface index.
+ */
+Result usbCommsReadStreamStart(u32 num_buffers, u32 buffer_size, u32 interface);
+
+/**
+ * @brief Waits for the next filled buffer of a read stream, in posting order. The data can be used in place until \ref usbCommsReadStreamReleaseBuffer is called.
+ * @param[out] buffer Output pointer to the data.
+ * @param[out] size Amount of data which was read.
+ * @param[in] timeout Timeout in nanoseconds.
+ * @param[in] interface Interface index.
+ */
+Result usbCommsReadStreamGetBuffer(const void **buffer, u32 *size, u64 timeout, u32 interface);
+
+/// Releases the buffer returned by \ref usbCommsReadStreamGetBuffer, posting it again for a new transfer.
+Result usbCommsReadStreamReleaseBuffer(u32 interface);
+
+/// Stops a read stream, cancelling the pending transfers. Data which was already received by them is lost.
+void usbCommsReadStreamStop(u32 interface);
+
+/**
+ * @brief Starts a write stream.
+ * @param[in] num_buffers Number of buffers, between 2 and \ref USB_COMMS_STREAM_MAX_BUFFERS.
+ * @param[in] buffer_size Size of each buffer, must be page-aligned.
+ * @param[in] interface Interface index.
+ */
+Result usbCommsWriteStreamStart(u32 num_buffers, u32 buffer_size, u32 interface);
+
+/**
+ * @brief Gets the next buffer to fill for a write stream, waiting for the oldest transfer to complete when all buffers are in flight.
+ * @param[out] buffer Output pointer to the buffer, which must then be passed to \ref usbCommsWriteStreamSubmit.
+ * @param[in] timeout Timeout in nanoseconds.
+ * @param[in] interface Interface index.
+ * @note A failure of the recycled transfer (including a short write) is reported here.
+ */
+Result usbCommsWriteStreamGetBuffer(void **buffer, u64 timeout, u32 interface);
+
+/// Posts the buffer returned by \ref usbCommsWriteStreamGetBuffer for a device->host transfer of the specified size.
+Result usbCommsWriteStreamSubmit(u32 size, u32 interface);
+
+/// Waits for all submitted transfers of a write stream to complete.
+Result usbCommsWriteStreamFlush(u64 timeout, u32 interface);
+
+/// Stops a write stream, cancelling the pending transfers. Use \ref usbCommsWriteStreamFlush beforehand to make sure all the data was sent.
+void usbCommsWriteStreamStop(u32 interface);
+
+///@}
@@ -0,0 +1,144 @@
+/**
+ * @file input_sampler.h
+ * @brief Background HID sampler producing timestamped input events [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../services/hid.h"
+#include "../kernel/thread.h"
+#include "../kernel/levent.h"
+
+/// Maximum number of six-axis sensors that can be sampled by an \ref InputSampler.
+#define INPUT_SAMPLER_MAX_SIX_AXIS_SENSORS 4
+
+/// Input event type.
+typedef enum {
+    InputEventType_NpadButtonDown, ///< One or more npad buttons were pressed.
+    InputEventType_NpadButtonUp,   ///< One or more npad buttons were released.
+    InputEventType_NpadStick,      ///< An npad analog stick moved.
+    InputEventType_TouchBegin,     ///< A finger started touching the touch screen.
+    InputEventType_TouchMove,      ///< A finger moved on the touch screen.
+    InputEventType_TouchEnd,       ///< A finger stopped touching the touch screen.
+    InputEventType_KeyDown,        ///< A keyboard key was pressed.
+    InputEventType_KeyUp,          ///< A keyboard key was released.
+    InputEventType_SixAxis,        ///< A new six-axis sensor sample is available.
+} InputEventType;
+
+/// Input event.
+typedef struct {
+    u64 tick;                     ///< System tick (see \ref armGetSystemTick) of the poll which observed the state. hid states carry no absolute timestamp, so all events from one poll share it: use sampling_number to order events from the same source.
+    u64 sampling_number;          ///< SamplingNumber of the state which generated the event.
+    InputEventType type : 8;      ///< \ref InputEventType
+    u8 source;                    ///< \ref HidNpadIdType for npad events, sensor index in \ref InputSamplerConfig for six-axis events, otherwise 0.
+    u8 _padding[6];
+    union {
+        u64 buttons;              ///< Bitfield of \ref HidNpadButton which changed state (NpadButtonDown/NpadButtonUp).
+
+        struct {
+            u32 index;            ///< Stick index (0=left, 1=right).
+            s32 x;
+            s32 y;
+        } stick;                  ///< NpadStick.
+
+        struct {
+            u32 finger_id;
+            u32 x;
+            u32 y;
+        } touch;                  ///< TouchBegin/TouchMove/TouchEnd.
+
+        struct {
+            u32 key;              ///< \ref HidKeyboardKey
+            u32 _padding;
+            u64 modifiers;        ///< Bitfield of \ref HidKeyboardModifier.
+        } key;                    ///< KeyDown/KeyUp.
+
+        struct {
+            HidVector acceleration;
+            HidVector angular_velocity;
+        } six_axis;               ///< SixAxis.
+    };
+} InputEvent;
+
+/// Input sampler configuration.
+typedef struct {
+    u64 npad_id_mask;             ///< Bitfield of controller IDs to sample (same format as \ref padInitializeWithMask).
+    bool touch_screen;            ///< Whether to sample the touch screen.
+    bool keyboard;                ///< Whether to sample the keyboard.
+    u32 num_six_axis_sensors;     ///< Number of six-axis sensors to sample.
+    HidSixAxisSensorHandle six_axis_sensors[INPUT_SAMPLER_MAX_SIX_AXIS_SENSORS]; ///< Six-axis sensors to sample (which must have been started).
+    s32 stick_threshold;          ///< Minimum change on either axis for a stick movement to generate an event.
+    u64 period_ns;                ///< Polling period in nanoseconds (0 to use the default of 1ms).
+    u32 queue_size;               ///< Event queue capacity, must be a power of two.
+    int prio;                     ///< Sampler thread priority.
+    int cpuid;                    ///< Sampler thread core, or -2 for the default core.
+} InputSamplerConfig;
+
+/// Per-npad sampler state.
+typedef struct {
+    HidStateCursor cursor;
+    u32 style;
+    u64 buttons;
+    HidAnalogStickState sticks[2];
+} InputSamplerNpad;
+
+/// hid states read by one poll of the sampler thread (implementation detail).
+typedef union {
+    HidNpadCommonState npad[17];
+    HidTouchScreenState touch_screen[17];
+    HidKeyboardState keyboard[17];
+    HidSixAxisSensorState six_axis[17];
+} InputSamplerScratch;
+
+/// Input sampler object.
+typedef struct {
+    Thread thread;
+    LEvent exit_event;
+    InputSamplerConfig config;
+
+    InputEvent* events;
+    u32 read_pos;
+    u32 write_pos;
+    u32 dropped_count;
+
+    InputSamplerNpad npads[9];
+    HidStateCursor touch_cursor;
+    HidTouchScreenState touch_state;
+    HidStateCursor keyboard_cursor;
+    HidKeyboardState keyboard_state;
+    HidStateCursor six_axis_cursors[INPUT_SAMPLER_MAX_SIX_AXIS_SENSORS];
+    InputSamplerScratch* scratch; ///< Kept off the sampler thread's stack, since the touch screen states alone take ~11KB.
+} InputSampler;
+
+/**
+ * @brief Creates an input sampler and starts its sampling thread.
+ * @param[out] s \ref InputSampler
+ * @param[in] config \ref InputSamplerConfig
+ * @note The relevant hid input sources must have been initialized beforehand (for example with \ref padConfigureInput).
+ * @return Result code.
+ */
+Result inputSamplerCreate(InputSampler* s, const InputSamplerConfig* config);
+
+/**
+ * @brief Stops the sampling thread and frees the resources used by an input sampler.
+ * @param[in] s \ref InputSampler
+ */
+void inputSamplerClose(InputSampler* s);
+
+/**
+ * @brief Retrieves pending input events, oldest first.
+ * @param[in] s \ref InputSampler
+ * @param[out] events Output array of \ref InputEvent.
+ * @param[in] count Size of the events array in entries.
+ * @note This must only be called from a single thread at a time; it never blocks.
+ * @return Total output entries.
+ */
+size_t inputSamplerPopEvents(InputSampler* s, InputEvent* events, size_t count);
+
+/**
+ * @brief Retrieves the number of events which were discarded because the queue was full.
+ * @param[in] s \ref InputSampler
+ */
+static inline u32 inputSamplerGetDroppedCount(InputSampler* s) {
+    return __atomic_load_n(&s->dropped_count, __ATOMIC_RELAXED);
+}
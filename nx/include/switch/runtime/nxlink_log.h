@@ -0,0 +1,127 @@
+/**
+ * @file nxlink_log.h
+ * @brief Buffered binary log channel over nxlink, with optional LZ4 block compression.
+ * @copyright libnx Authors
+ * @note The stream format and the codec functions only depend on the C library: nxlink_log_codec.c can be built
+ *       on the host together with this header (and types.h) to decode the data received by nxlink.
+ */
+#pragma once
+#include "../types.h"
+
+#define NXLINK_LOG_STREAM_MAGIC 0x474C584E ///< "NXLG"
+#define NXLINK_LOG_BLOCK_MAGIC  0x424C584E ///< "NXLB"
+#define NXLINK_LOG_VERSION      1
+
+/// Log level.
+typedef enum {
+    NxlinkLogLevel_Debug   = 0,
+    NxlinkLogLevel_Info    = 1, ///< Used for redirected stdout.
+    NxlinkLogLevel_Warning = 2,
+    NxlinkLogLevel_Error   = 3, ///< Used for redirected stderr.
+} NxlinkLogLevel;
+
+/// Header sent once at the start of the stream.
+typedef struct {
+    u32 magic;          ///< \ref NXLINK_LOG_STREAM_MAGIC
+    u32 version;        ///< \ref NXLINK_LOG_VERSION
+    u64 tick_frequency; ///< Frequency of the record timestamps, in Hz.
+} NxlinkLogStreamHeader;
+
+/// Block header, followed by data_size bytes of data. The decoded data is a sequence of records.
+typedef struct {
+    u32 magic;          ///< \ref NXLINK_LOG_BLOCK_MAGIC
+    u32 flags;          ///< Bitfield of \ref NxlinkLogBlockFlag.
+    u32 raw_size;       ///< Size of the decoded data.
+    u32 data_size;      ///< Size of the data following the header.
+} NxlinkLogBlockHeader;
+
+/// Block flags.
+typedef enum {
+    NxlinkLogBlockFlag_Compressed = BIT(0), ///< The data is an LZ4 block.
+} NxlinkLogBlockFlag;
+
+/// Record header, followed by size bytes of message text (not NUL-terminated).
+typedef struct {
+    u64 tick;           ///< System tick at which the message was logged.
+    u64 thread_id;      ///< Id of the logging thread.
+    u32 size;           ///< Message size.
+    u8 level;           ///< \ref NxlinkLogLevel
+    u8 padding[3];
+} NxlinkLogRecordHeader;
+
+/// Log channel configuration.
+typedef struct {
+    bool redirect_stdout;  ///< Whether to log stdout (as \ref NxlinkLogLevel_Info).
+    bool redirect_stderr;  ///< Whether to log stderr (as \ref NxlinkLogLevel_Error).
+    bool compress;         ///< Whether to compress the blocks.
+    u32 buffer_size;       ///< Size of each of the two record buffers (0 for 64 KiB). Also the maximum block size.
+    u64 flush_interval;    ///< Maximum time in nanoseconds records are kept buffered (0 for 100ms).
+    int prio;              ///< Flusher thread priority.
+    int cpuid;             ///< Flusher thread core, or -2 for the default core.
+} NxlinkLogConfig;
+
+/**
+ * @brief Connects to the nxlink host and starts the log channel.
+ * @param[in] config \ref NxlinkLogConfig
+ * @note Records are sent as binary blocks by a background thread, the stock nxlink host tool just outputs them: redirect its output to a file and decode it.
+ * @return Result code.
+ */
+Result nxlinkLogInitialize(const NxlinkLogConfig *config);
+
+/// Flushes the pending records, stops the log channel and restores stdout/stderr.
+void nxlinkLogExit(void);
+
+/**
+ * @brief Logs a message.
+ * @param[in] level \ref NxlinkLogLevel
+ * @param[in] msg Message text.
+ * @param[in] size Message size. Messages larger than the buffer size minus the record header are truncated.
+ * @note This only blocks when both buffers are full.
+ */
+void nxlinkLogWrite(NxlinkLogLevel level, const char *msg, size_t size);
+
+/// Logs a formatted message.
+void nxlinkLogPrintf(NxlinkLogLevel level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/// Sends the buffered records and waits for them to be sent.
+void nxlinkLogFlush(void);
+
+/**
+ * @brief Compresses data as an LZ4 block.
+ * @param[in] src Input data.
+ * @param[in] src_size Input size.
+ * @param[out] dst Output buffer.
+ * @param[in] dst_capacity Output buffer size.
+ * @return Compressed size, or 0 if the output doesn't fit in the buffer.
+ */
+size_t nxlinkLogCompress(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+
+/**
+ * @brief Decompresses an LZ4 block.
+ * @param[in] src Input data.
+ * @param[in] src_size Input size.
+ * @param[out] dst Output buffer.
+ * @param[in] dst_capacity Output buffer size.
+ * @return Decompressed size, or -1 if the data is invalid or doesn't fit in the buffer.
+ */
+ssize_t nxlinkLogDecompress(const void *src, size_t src_size, void *dst, size_t dst_capacity);
+
+/**
+ * @brief Decodes the data of a block.
+ * @param[in] hdr \ref NxlinkLogBlockHeader
+ * @param[in] data Block data (hdr->data_size bytes).
+ * @param[out] out Output buffer, which must be at least hdr->raw_size bytes.
+ * @param[in] out_size Output buffer size.
+ * @return Decoded size, or -1 on error.
+ */
+ssize_t nxlinkLogDecodeBlock(const NxlinkLogBlockHeader *hdr, const void *data, void *out, size_t out_size);
+
+/**
+ * @brief Iterates over the records of a decoded block.
+ * @param[in] data Decoded block data.
+ * @param[in] size Decoded block size.
+ * @param[in,out] offset Offset of the next record, which should be 0 initially.
+ * @param[out] msg Output pointer to the message text.
+ * @return Pointer to the record header, or NULL when there are no more (valid) records.
+ */
+const NxlinkLogRecordHeader *nxlinkLogNextRecord(const void *data, size_t size, size_t *offset, const char **msg);
@@ -0,0 +1,61 @@
+/**
+ * @file plugin.h
+ * @brief Runtime plugin loader, loading NROs through ldr:ro.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Plugin loading flags.
+typedef enum {
+    PluginFlag_Lazy   = 0,      ///< Resolve function symbols on their first call (default).
+    PluginFlag_Now    = BIT(0), ///< Resolve all symbols while loading the plugin.
+    PluginFlag_Global = BIT(1), ///< Make the symbols of the plugin available to the plugins loaded afterwards.
+} PluginFlag;
+
+/// Plugin object.
+typedef struct Plugin Plugin;
+
+/**
+ * @brief Initializes the plugin loader.
+ * @note The main module only exports the symbols of its dynamic symbol table to plugins, it needs to be linked with -rdynamic (or an equivalent dynamic list) for plugins to use them.
+ * @return Result code.
+ */
+Result pluginInitialize(void);
+
+/// Unloads all plugins and registered NRRs, and exits the plugin loader.
+void pluginExit(void);
+
+/**
+ * @brief Registers a NRR file, which must list the hashes of the plugins to load.
+ * @param[in] path Path to the NRR file.
+ * @return Result code.
+ */
+Result pluginRegisterNrr(const char* path);
+
+/**
+ * @brief Loads a plugin.
+ * @param[out] out Output plugin.
+ * @param[in] path Path to the NRO file.
+ * @param[in] flags Bitfield of \ref PluginFlag.
+ * @note Loading a plugin which is already loaded (same build id) returns it with an incremented reference count.
+ * @note Undefined symbols are looked up in the main module, then in the global plugins in loading order, then in the plugin itself. DT_NEEDED entries are ignored: dependencies must be loaded beforehand with \ref PluginFlag_Global.
+ * @note Relocations: RELATIVE, RELR, ABS64, GLOB_DAT and JUMP_SLOT are supported, TLS relocations aren't.
+ * @return Result code.
+ */
+Result pluginOpen(Plugin** out, const char* path, u32 flags);
+
+/**
+ * @brief Looks up a symbol.
+ * @param[in] p Plugin, or NULL to search the main module and the global plugins.
+ * @param[in] name Symbol name.
+ * @return Address of the symbol, or NULL if it wasn't found.
+ */
+void* pluginGetSymbol(Plugin* p, const char* name);
+
+/**
+ * @brief Releases a reference to a plugin, which is unloaded when no references remain.
+ * @param[in] p Plugin.
+ * @return Result code.
+ */
+Result pluginClose(Plugin* p);
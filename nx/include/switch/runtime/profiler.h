@@ -0,0 +1,114 @@
+/**
+ * @file profiler.h
+ * @brief In-process sampling profiler [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdio.h>
+#include "../types.h"
+#include "../kernel/thread.h"
+#include "../kernel/levent.h"
+
+#define PROFILER_MAX_THREADS 16 ///< Maximum number of threads sampled by a \ref Profiler.
+#define PROFILER_MAX_DEPTH   16 ///< Maximum number of frames recorded per sample.
+
+/// Unique call stack, along with the number of times it was sampled.
+typedef struct {
+    u32 count;
+    u32 depth;
+    u64 frames[PROFILER_MAX_DEPTH]; ///< Return addresses, innermost (the sampled PC) first.
+} ProfilerStack;
+
+/// Profiler configuration.
+typedef struct {
+    u64 period_ns;      ///< Sampling period in nanoseconds (0 to use the default of 1ms).
+    u32 max_stacks;     ///< Capacity of the stack table, must be a power of two (0 to use the default of 4096).
+    int prio;           ///< Sampler thread priority, which should be higher than the priority of the sampled threads.
+    int cpuid;          ///< Sampler thread core, or -2 for the default core.
+} ProfilerConfig;
+
+/// Profiler object.
+typedef struct {
+    Thread thread;
+    LEvent exit_event;
+    ProfilerConfig config;
+    Mutex mutex;                             ///< Protects the target list.
+    Thread* targets[PROFILER_MAX_THREADS];
+    u32 num_targets;
+    bool running;
+
+    ProfilerStack* stacks;                   ///< Open-addressing hash table of unique call stacks.
+    u64 num_samples;                         ///< Total number of samples taken.
+    u64 dropped_samples;                     ///< Samples which didn't fit in the stack table.
+} Profiler;
+
+/**
+ * @brief Creates a profiler.
+ * @param[out] p \ref Profiler
+ * @param[in] config \ref ProfilerConfig
+ * @return Result code.
+ */
+Result profilerCreate(Profiler* p, const ProfilerConfig* config);
+
+/**
+ * @brief Stops the profiler if needed, and frees its resources.
+ * @param[in] p \ref Profiler
+ */
+void profilerClose(Profiler* p);
+
+/**
+ * @brief Adds a thread to the set of sampled threads.
+ * @param[in] p \ref Profiler
+ * @param[in] t Thread to sample (for example \ref threadGetSelf), which must not be the caller of \ref profilerStop.
+ * @note Call stacks are recovered by walking frame pointers; code built with -fomit-frame-pointer only reports its PC.
+ * @return Result code.
+ */
+Result profilerAddThread(Profiler* p, Thread* t);
+
+/**
+ * @brief Removes a thread from the set of sampled threads.
+ * @param[in] p \ref Profiler
+ * @param[in] t Thread.
+ */
+void profilerRemoveThread(Profiler* p, Thread* t);
+
+/**
+ * @brief Starts sampling.
+ * @param[in] p \ref Profiler
+ * @note Each sample briefly pauses the target thread with \ref threadPause. The sampler never allocates memory or takes
+ *       any lock a target could hold while paused.
+ * @return Result code.
+ */
+Result profilerStart(Profiler* p);
+
+/**
+ * @brief Stops sampling.
+ * @param[in] p \ref Profiler
+ */
+void profilerStop(Profiler* p);
+
+/**
+ * @brief Clears the collected samples.
+ * @param[in] p \ref Profiler
+ * @note The profiler must be stopped.
+ */
+void profilerReset(Profiler* p);
+
+/**
+ * @brief Writes the collected samples in collapsed-stack format (one "outer;...;inner count" line per unique stack).
+ * @param[in] p \ref Profiler
+ * @param[in] f Output file, for example a file on sdmc or stdout redirected with nxlink.
+ * @note Addresses are symbolized against the main module's dynamic symbol table when possible (link with -rdynamic
+ *       to export all symbols), otherwise they are written as offsets from the module base.
+ * @note The profiler must be stopped.
+ */
+void profilerWriteCollapsed(Profiler* p, FILE* f);
+
+/**
+ * @brief Writes a flat histogram of the sampled functions, sorted by decreasing sample count.
+ * @param[in] p \ref Profiler
+ * @param[in] f Output file.
+ * @note The profiler must be stopped.
+ * @return Result code.
+ */
+Result profilerWriteHistogram(Profiler* p, FILE* f);
@@ -1,5 +1,11 @@
 #pragma once
 #include "../types.h"
+#include "../kernel/wait.h"
+
+struct addrinfo;
+
+/// Asynchronous resolver request (opaque).
+typedef struct ResolverRequest ResolverRequest;
 
 /// Fetches the last resolver Switch result code of the current thread.
 Result resolverGetLastResult(void);
@@ -10,13 +16,13 @@ u32 resolverGetCancelHandle(void);
 /// Retrieves whether service discovery is enabled for resolver commands on the current thread.
 bool resolverGetEnableServiceDiscovery(void);
 
-/// [5.0.0+] Retrieves whether the DNS cache is used to resolve queries on the current thread (not implemented).
+/// Retrieves whether the DNS cache is used to resolve queries on the current thread. Only the client-side cache (see \ref resolverCacheInitialize) is implemented.
 bool resolverGetEnableDnsCache(void);
 
 /// Enables or disables service discovery for the current thread.
 void resolverSetEnableServiceDiscovery(bool enable);
 
-/// [5.0.0+] Enables or disables the usage of the DNS cache on the current thread (not implemented).
+/// Enables or disables the usage of the DNS cache on the current thread. Only the client-side cache (see \ref resolverCacheInitialize) is implemented.
 void resolverSetEnableDnsCache(bool enable);
 
 /// Cancels a previous resolver command (handle obtained with \ref resolverGetCancelHandle prior to calling the command).
@@ -27,3 +33,63 @@ Result resolverRemoveHostnameFromCache(const char* hostname);
 
 /// [5.0.0+] Removes an IP address from the DNS cache (not implemented).
 Result resolverRemoveIpAddressFromCache(u32 ip);
+
+/**
+ * @brief Enables a client-side cache for getaddrinfo results, including negative answers (unknown hosts).
+ * @param[in] num_entries Maximum number of cached results. The entries closest to expiring get replaced first.
+ * @param[in] positive_ttl Lifetime of successful results in nanoseconds.
+ * @param[in] negative_ttl Lifetime of negative results in nanoseconds (0 to not cache them).
+ * @note The cache is used by threads for which \ref resolverGetEnableDnsCache returns true.
+ */
+Result resolverCacheInitialize(u32 num_entries, u64 positive_ttl, u64 negative_ttl);
+
+/// Removes every entry from the client-side cache.
+void resolverCacheFlush(void);
+
+/// Disables the client-side cache and frees its entries.
+void resolverCacheExit(void);
+
+/**
+ * @brief Starts the worker threads servicing asynchronous resolver requests.
+ * @param[in] num_workers Number of worker threads, which is the number of queries resolved concurrently.
+ * @param[in] prio Worker thread priority.
+ * @param[in] cpuid Worker thread core, or -2 for the default core.
+ */
+Result resolverAsyncInitialize(u32 num_workers, int prio, int cpuid);
+
+/// Stops the worker threads. Requests which were still queued fail with ECANCELED.
+void resolverAsyncExit(void);
+
+/**
+ * @brief Submits an asynchronous getaddrinfo request.
+ * @param[out] out Output request, which must be freed with \ref resolverRequestClose.
+ * @param[in] node Same as getaddrinfo.
+ * @param[in] service Same as getaddrinfo.
+ * @param[in] hints Same as getaddrinfo, only ai_flags, ai_family, ai_socktype and ai_protocol are used.
+ * @note The service discovery and DNS cache settings of the current thread are used.
+ * @note Requests answered by the client-side cache complete immediately.
+ */
+Result resolverGetAddrInfoAsync(ResolverRequest** out, const char* node, const char* service, const struct addrinfo* hints);
+
+/// Creates a waiter which is signaled once the request completes.
+Waiter resolverRequestGetWaiter(ResolverRequest* req);
+
+/// Retrieves whether a request completed.
+bool resolverRequestIsDone(ResolverRequest* req);
+
+/// Waits for a request to complete.
+Result resolverRequestWait(ResolverRequest* req, u64 timeout);
+
+/**
+ * @brief Retrieves the result of a completed request, with the same semantics as getaddrinfo.
+ * @param[in] req Request.
+ * @param[out] res Output list, which must be freed with freeaddrinfo.
+ * @note errno and \ref resolverGetLastResult are updated with the request's values. Incomplete requests fail with EINPROGRESS.
+ */
+int resolverRequestGetResult(ResolverRequest* req, struct addrinfo** res);
+
+/// Cancels a request. Requests which are being resolved are cancelled with \ref resolverCancel, and fail with ECANCELED.
+void resolverRequestCancel(ResolverRequest* req);
+
+/// Cancels a request if needed, waits for it to complete, and frees it.
+void resolverRequestClose(ResolverRequest* req);
@@ -0,0 +1,48 @@
+/**
+ * @file startup.h
+ * @brief Startup timeline.
+ * @note RELR relocations of large programs can be applied by additional threads on the other cores
+ *       by defining `u32 __nx_dynamic_reloc_threads = N;` in the program (N is capped to 3).
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Maximum number of marks recorded with \ref startupMark.
+#define STARTUP_MAX_MARKS 16
+
+/// Startup phase.
+typedef enum {
+    StartupPhase_Entry,           ///< Entry of the runtime linker, before relocations.
+    StartupPhase_RelocationsDone, ///< Relocations have been applied.
+    StartupPhase_InitDone,        ///< libnx initialization (including constructors) is done, main is about to be called.
+    StartupPhase_Count,
+} StartupPhase;
+
+/// Custom timeline mark.
+typedef struct {
+    const char* label;            ///< Label passed to \ref startupMark.
+    u64 tick;                     ///< System tick at which the mark was recorded.
+} StartupMark;
+
+/// Startup timeline.
+typedef struct {
+    u64 phase_ticks[StartupPhase_Count]; ///< System tick (see \ref armGetSystemTick) at which each \ref StartupPhase was reached, 0 if it wasn't recorded.
+    u64 num_relocations;          ///< Number of relocations applied to the program.
+    u32 num_reloc_threads;        ///< Number of threads which applied the RELR relocations, including the main thread.
+    u32 num_marks;                ///< Number of recorded marks.
+    StartupMark marks[STARTUP_MAX_MARKS]; ///< Custom marks, in recording order.
+} StartupTimeline;
+
+/**
+ * @brief Records a custom mark in the startup timeline.
+ * @param[in] label Label, which must remain valid.
+ * @note Marks past \ref STARTUP_MAX_MARKS are ignored.
+ */
+void startupMark(const char* label);
+
+/// Gets the startup timeline.
+const StartupTimeline* startupGetTimeline(void);
+
+/// Gets the duration of the relocation step in nanoseconds.
+u64 startupGetRelocationTime(void);
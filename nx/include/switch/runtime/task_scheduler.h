@@ -0,0 +1,125 @@
+/**
+ * @file task_scheduler.h
+ * @brief Work-stealing task scheduler [4.0.0+]
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+#include "../kernel/thread.h"
+#include "../kernel/mutex.h"
+
+/// Maximum number of worker threads in a \ref TaskScheduler.
+#define TASK_SCHEDULER_MAX_WORKERS 4
+
+typedef struct TaskScheduler TaskScheduler;
+typedef struct Task Task;
+
+/// Task entrypoint.
+typedef void (*TaskFunc)(void* arg);
+
+/// Parallel-for body, called with a half-open [begin, end) subrange.
+typedef void (*TaskRangeFunc)(void* arg, u64 begin, u64 end);
+
+/// Group of tasks which can be waited on as a whole.
+typedef struct {
+    u32 pending; ///< Number of spawned tasks which haven't completed yet.
+} TaskGroup;
+
+/// Task structure. Its storage is owned by the caller and must remain valid until the task's group has been waited on.
+struct Task {
+    TaskFunc func;
+    void* arg;
+    TaskGroup* group;
+    Task* next;
+};
+
+/// Task scheduler configuration.
+typedef struct {
+    u32 num_workers;   ///< Number of worker threads (0 to use one per available core, up to \ref TASK_SCHEDULER_MAX_WORKERS).
+    u32 core_mask;     ///< Bitmask of cores to pin workers to, in round-robin fashion (0 to use the cores available to the process).
+    int prio;          ///< Worker thread priority.
+    size_t stack_size; ///< Worker stack size (0 to use the default of 64KB).
+    u32 deque_size;    ///< Per-worker deque capacity, must be a power of two (0 to use the default of 256).
+} TaskSchedulerConfig;
+
+/// Worker state.
+typedef struct {
+    s64 top;           ///< Steal end of the deque, modified by thieves.
+    u8 _padding[0x38];
+    s64 bottom;        ///< Owner end of the deque, only modified by the worker itself.
+    Task** buffer;
+    TaskScheduler* sched;
+    Thread thread;
+    u32 rng;
+} TaskWorker;
+
+/// Task scheduler object.
+struct TaskScheduler {
+    TaskWorker workers[TASK_SCHEDULER_MAX_WORKERS];
+    u32 num_workers;
+    u32 deque_mask;
+
+    Mutex inject_mutex;  ///< Protects the queue of tasks spawned from outside the workers.
+    Task* inject_head;
+    Task* inject_tail;
+    u32 inject_count;
+
+    u32 park_seq;        ///< Incremented whenever new work is available or a group completes, parked workers and group waiters wait on it.
+    u32 num_parked;
+    bool exiting;
+};
+
+/**
+ * @brief Creates a task scheduler and starts its worker threads.
+ * @param[out] s \ref TaskScheduler
+ * @param[in] config \ref TaskSchedulerConfig
+ * @return Result code.
+ */
+Result taskSchedulerCreate(TaskScheduler* s, const TaskSchedulerConfig* config);
+
+/**
+ * @brief Stops the worker threads and frees the resources used by a task scheduler.
+ * @param[in] s \ref TaskScheduler
+ * @note All task groups must have been waited on beforehand; tasks which haven't started are discarded.
+ */
+void taskSchedulerClose(TaskScheduler* s);
+
+/**
+ * @brief Initializes a task group.
+ * @param[out] g \ref TaskGroup
+ */
+NX_CONSTEXPR void taskGroupInit(TaskGroup* g) {
+    g->pending = 0;
+}
+
+/**
+ * @brief Spawns a task.
+ * @param[in] s \ref TaskScheduler
+ * @param[in] g \ref TaskGroup the task belongs to.
+ * @param[out] task Task storage, which must remain valid until the group is waited on.
+ * @param[in] func Task entrypoint.
+ * @param[in] arg Argument passed to the entrypoint.
+ * @note When called from a worker thread, the task is pushed to that worker's own deque (from which idle workers steal).
+ *       If the deque is full, the task is run immediately instead.
+ */
+void taskSchedulerSpawn(TaskScheduler* s, TaskGroup* g, Task* task, TaskFunc func, void* arg);
+
+/**
+ * @brief Waits for all the tasks in a group to complete.
+ * @param[in] s \ref TaskScheduler
+ * @param[in] g \ref TaskGroup
+ * @note The calling thread runs pending tasks while it waits, which makes it safe to call from within a task.
+ */
+void taskGroupWait(TaskScheduler* s, TaskGroup* g);
+
+/**
+ * @brief Runs a function over a range, in parallel.
+ * @param[in] s \ref TaskScheduler
+ * @param[in] begin Start of the range.
+ * @param[in] end End of the range (exclusive).
+ * @param[in] grain Number of elements processed by each call to \p func (0 is treated as 1).
+ * @param[in] func Function to call for each subrange.
+ * @param[in] arg Argument passed to \p func.
+ * @note The calling thread participates, and this only returns once the whole range has been processed.
+ */
+void taskSchedulerParallelFor(TaskScheduler* s, u64 begin, u64 end, u64 grain, TaskRangeFunc func, void* arg);
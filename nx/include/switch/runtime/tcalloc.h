@@ -0,0 +1,47 @@
+/**
+ * @file tcalloc.h
+ * @brief Thread-caching small-object allocator.
+ * @note libnx's own internal allocations can be routed through this allocator with \ref TCALLOC_USE_FOR_LIBNX.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Largest allocation size served from the size-class caches; bigger requests go straight to malloc.
+#define TCALLOC_MAX_SMALL_SIZE 2048
+
+/// Routes libnx's own internal allocations through this allocator. Must be used once, at file scope, in the program.
+/// Besides setting the flag, this references the allocator so that it gets linked in.
+#define TCALLOC_USE_FOR_LIBNX() \
+    bool __nx_alloc_use_tcalloc = true; \
+    void* (* const __nx_alloc_tcalloc_ref)(size_t) = tcallocAlloc
+
+/**
+ * @brief Allocates memory.
+ * @param[in] size Size of the allocation.
+ * @note Small allocations are served from a per-thread cache, refilled in batches from central per-size-class slabs,
+ *       so that the newlib heap lock is only taken when a slab needs to be created.
+ * @return Pointer to the allocated memory, or NULL on failure.
+ */
+void* tcallocAlloc(size_t size);
+
+/**
+ * @brief Allocates aligned memory.
+ * @param[in] alignment Alignment, must be a power of two.
+ * @param[in] size Size of the allocation.
+ * @return Pointer to the allocated memory, or NULL on failure.
+ */
+void* tcallocAlignedAlloc(size_t alignment, size_t size);
+
+/**
+ * @brief Frees memory allocated with \ref tcallocAlloc or \ref tcallocAlignedAlloc.
+ * @param[in] p Pointer to the memory (may be NULL).
+ * @note Memory can be freed from any thread, not just the one which allocated it.
+ */
+void tcallocFree(void* p);
+
+/**
+ * @brief Returns the blocks held in the current thread's cache to the shared slabs.
+ * @note This is done automatically when a thread created with \ref threadCreate exits.
+ */
+void tcallocFlushThreadCache(void);
@@ -0,0 +1,106 @@
+/**
+ * @file trace.h
+ * @brief Lightweight trace event recording, exportable to the Chrome/Perfetto trace format.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include "../types.h"
+
+/// Trace event type.
+typedef enum {
+    TraceEventType_Begin,   ///< Start of a duration event.
+    TraceEventType_End,     ///< End of a duration event.
+    TraceEventType_Instant, ///< Instant event.
+    TraceEventType_Counter, ///< Counter value.
+} TraceEventType;
+
+/// Recorded trace event.
+typedef struct {
+    u64 tick;               ///< System tick (see \ref armGetSystemTick) at which the event was recorded.
+    const char* name;       ///< Event name, which must have static storage duration.
+    u64 value;              ///< Counter value, or argument for the other event types.
+    u32 type;               ///< \ref TraceEventType
+    u32 padding;
+} TraceEvent;
+
+/// Callback used to export traces (for example a wrapper around \ref usbCommsWrite). Returns false on failure.
+typedef bool (*TraceWriteFunc)(const void* data, size_t size, void* user);
+
+/// Whether events are currently being recorded. Use \ref traceSetEnabled to change it.
+extern bool __nx_trace_enabled;
+
+/**
+ * @brief Initializes tracing.
+ * @param[in] events_per_thread Capacity of each thread's ring buffer, must be a power of two. Older events get overwritten.
+ * @note Each thread gets its own buffer the first time it records an event, so recording is lock-free.
+ * @note Buffers of exited threads are kept for exporting until a new thread starts recording and reuses them.
+ * @return Result code.
+ */
+Result traceInitialize(u32 events_per_thread);
+
+/**
+ * @brief Frees all trace buffers.
+ * @note No thread may record events during this call. Events recorded afterwards are discarded.
+ */
+void traceExit(void);
+
+/**
+ * @brief Enables or disables the recording of trace events.
+ * @param[in] enable Whether to record events.
+ */
+void traceSetEnabled(bool enable);
+
+/**
+ * @brief Discards all recorded events.
+ * @note Tracing should be disabled while doing this.
+ */
+void traceClear(void);
+
+/**
+ * @brief Records a trace event on the current thread's buffer. Usually called through the helpers below.
+ * @param[in] type \ref TraceEventType
+ * @param[in] name Event name, which must have static storage duration.
+ * @param[in] value Counter value or event argument.
+ */
+void traceRecord(TraceEventType type, const char* name, u64 value);
+
+/**
+ * @brief Sends a synchronous IPC request wrapped in an "ipc" duration event. Used by \ref serviceDispatch while tracing is enabled.
+ * @param[in] session IPC session handle.
+ * @param[in] request_id Command ID, recorded as the event argument.
+ * @return Result code.
+ */
+Result traceSendSyncRequest(Handle session, u32 request_id);
+
+/// Records the start of a duration event.
+static inline void traceBegin(const char* name, u64 arg) {
+    if (__builtin_expect(__nx_trace_enabled, 0))
+        traceRecord(TraceEventType_Begin, name, arg);
+}
+
+/// Records the end of a duration event.
+static inline void traceEnd(const char* name, u64 arg) {
+    if (__builtin_expect(__nx_trace_enabled, 0))
+        traceRecord(TraceEventType_End, name, arg);
+}
+
+/// Records an instant event.
+static inline void traceInstant(const char* name, u64 arg) {
+    if (__builtin_expect(__nx_trace_enabled, 0))
+        traceRecord(TraceEventType_Instant, name, arg);
+}
+
+/// Records a counter value.
+static inline void traceCounter(const char* name, u64 value) {
+    if (__builtin_expect(__nx_trace_enabled, 0))
+        traceRecord(TraceEventType_Counter, name, value);
+}
+
+/**
+ * @brief Exports the recorded events as Chrome trace JSON (loadable by chrome://tracing and Perfetto).
+ * @param[in] func Write callback.
+ * @param[in] user Argument passed to the callback.
+ * @note Tracing should be disabled while doing this, otherwise events being overwritten may be exported torn.
+ * @return Result code.
+ */
+Result traceExportChromeJson(TraceWriteFunc func, void* user);
@@ -0,0 +1,15 @@
+/**
+ * @file trace_file.h
+ * @brief Trace export to stdio files.
+ * @copyright libnx Authors
+ */
+#pragma once
+#include <stdio.h>
+#include "trace.h"
+
+/**
+ * @brief Writes the recorded events as Chrome trace JSON to a file (for example on sdmc).
+ * @param[in] f Output file.
+ * @return Result code.
+ */
+Result traceWriteChromeJson(FILE* f);
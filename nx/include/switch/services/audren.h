@@ -47,6 +47,7 @@ typedef struct {
     int num_sinks;
     int num_mix_objs;
     int num_mix_buffers;
+    int num_perf_frames; ///< Number of performance metrics frames retained by the renderer (0 to disable performance metrics).
 } AudioRendererConfig;
 
 /*
@@ -277,6 +278,65 @@ typedef struct {
     u32 _padding1[3];
 } AudioRendererPerformanceBufferInfoOut;
 
+/*
+Performance buffer layout (repeated for each recorded frame):
+
+AudioRendererPerformanceFrameHeader
+AudioRendererPerformanceEntry * entry_count
+AudioRendererPerformanceDetail * detail_count
+*/
+
+#define AUDREN_PERFORMANCE_FRAME_MAGIC      0x46524550 // PERF
+#define AUDREN_PERFORMANCE_MAX_DETAIL_COUNT 100
+
+typedef enum {
+    AudioRendererPerformanceEntryType_Invalid,
+    AudioRendererPerformanceEntryType_Voice,
+    AudioRendererPerformanceEntryType_SubMix,
+    AudioRendererPerformanceEntryType_FinalMix,
+    AudioRendererPerformanceEntryType_Sink,
+} AudioRendererPerformanceEntryType;
+
+typedef enum {
+    AudioRendererPerformanceDetailType_Unknown,
+    AudioRendererPerformanceDetailType_PcmInt16,
+    AudioRendererPerformanceDetailType_Adpcm,
+    AudioRendererPerformanceDetailType_VolumeRamp,
+    AudioRendererPerformanceDetailType_BiquadFilter,
+    AudioRendererPerformanceDetailType_Mix,
+    AudioRendererPerformanceDetailType_Delay,
+    AudioRendererPerformanceDetailType_Aux,
+    AudioRendererPerformanceDetailType_Reverb,
+    AudioRendererPerformanceDetailType_Reverb3d,
+    AudioRendererPerformanceDetailType_PcmFloat,
+} AudioRendererPerformanceDetailType;
+
+typedef struct {
+    u32 magic;                 ///< \ref AUDREN_PERFORMANCE_FRAME_MAGIC
+    u32 entry_count;
+    u32 detail_count;
+    u32 next_offset;
+    u32 total_processing_time; ///< In microseconds.
+    u32 voice_drop_count;
+} AudioRendererPerformanceFrameHeader;
+
+typedef struct {
+    u32 node_id;
+    u32 start_time;      ///< In microseconds, relative to the start of the frame.
+    u32 processing_time; ///< In microseconds.
+    AudioRendererPerformanceEntryType entry_type : 8;
+    u8 _padding1[3];
+} AudioRendererPerformanceEntry;
+
+typedef struct {
+    u32 node_id;
+    u32 start_time;      ///< In microseconds, relative to the start of the frame.
+    u32 processing_time; ///< In microseconds.
+    AudioRendererPerformanceDetailType detail_type : 8;
+    AudioRendererPerformanceEntryType entry_type : 8;
+    u8 _padding1[2];
+} AudioRendererPerformanceDetail;
+
 static inline u32 audrenGetRevision(void)
 {
     extern u32 g_audrenRevision;
@@ -303,6 +363,23 @@ NX_CONSTEXPR size_t audrenGetInputParamSize(const AudioRendererConfig* config)
     return size;
 }
 
+NX_CONSTEXPR size_t audrenGetPerformanceFrameSize(const AudioRendererConfig* config)
+{
+    size_t size = 0;
+    size += sizeof(AudioRendererPerformanceFrameHeader);
+    size += sizeof(AudioRendererPerformanceEntry) * (config->num_voices + config->num_effects + config->num_mix_objs + config->num_sinks);
+    size += sizeof(AudioRendererPerformanceDetail) * AUDREN_PERFORMANCE_MAX_DETAIL_COUNT;
+    return size;
+}
+
+NX_CONSTEXPR size_t audrenGetPerformanceBufferSize(const AudioRendererConfig* config)
+{
+    if (config->num_perf_frames <= 0)
+        return 0;
+    // Room for an extra (terminating) header after the last frame
+    return audrenGetPerformanceFrameSize(config) * config->num_perf_frames + sizeof(AudioRendererPerformanceFrameHeader);
+}
+
 NX_CONSTEXPR size_t audrenGetOutputParamSize(const AudioRendererConfig* config)
 {
     size_t size = 0;
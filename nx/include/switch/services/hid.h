@@ -895,6 +895,13 @@ typedef struct HidCommonLifoHeader {
     u64 count;                                  ///< Count
 } HidCommonLifoHeader;
 
+/// HidStateCursor, used with the hidGet*StatesSince functions to only read states which weren't previously returned. Zero-initialize before first use.
+/// When more states are unread than fit in the output array, the oldest ones are returned and the rest are left for the next call.
+typedef struct HidStateCursor {
+    u64 next_sampling_number;                   ///< SamplingNumber of the oldest state which wasn't returned yet.
+    u64 dropped_count;                          ///< Total number of states which were overwritten in the lifo before they could be read.
+} HidStateCursor;
+
 // Begin HidDebugPad
 
 /// HidDebugPadState
@@ -1795,6 +1802,15 @@ void hidInitializeTouchScreen(void);
  */
 size_t hidGetTouchScreenStates(HidTouchScreenState *states, size_t count);
 
+/**
+ * @brief Gets the \ref HidTouchScreenState which are newer than the specified cursor, and advances the cursor.
+ * @param[in,out] cursor \ref HidStateCursor
+ * @param[out] states Output array of \ref HidTouchScreenState, ordered newest first.
+ * @param[in] count Size of the states array in entries.
+ * @return Total output entries.
+ */
+size_t hidGetTouchScreenStatesSince(HidStateCursor *cursor, HidTouchScreenState *states, size_t count);
+
 ///@}
 
 ///@name Mouse
@@ -1811,6 +1827,15 @@ void hidInitializeMouse(void);
  */
 size_t hidGetMouseStates(HidMouseState *states, size_t count);
 
+/**
+ * @brief Gets the \ref HidMouseState which are newer than the specified cursor, and advances the cursor.
+ * @param[in,out] cursor \ref HidStateCursor
+ * @param[out] states Output array of \ref HidMouseState, ordered newest first.
+ * @param[in] count Size of the states array in entries.
+ * @return Total output entries.
+ */
+size_t hidGetMouseStatesSince(HidStateCursor *cursor, HidMouseState *states, size_t count);
+
 ///@}
 
 ///@name Keyboard
@@ -1827,6 +1852,15 @@ void hidInitializeKeyboard(void);
  */
 size_t hidGetKeyboardStates(HidKeyboardState *states, size_t count);
 
+/**
+ * @brief Gets the \ref HidKeyboardState which are newer than the specified cursor, and advances the cursor.
+ * @param[in,out] cursor \ref HidStateCursor
+ * @param[out] states Output array of \ref HidKeyboardState, ordered newest first.
+ * @param[in] count Size of the states array in entries.
+ * @return Total output entries.
+ */
+size_t hidGetKeyboardStatesSince(HidStateCursor *cursor, HidKeyboardState *states, size_t count);
+
 /**
  * @brief Gets the state of a key in a \ref HidKeyboardState.
  * @param[in] state \ref HidKeyboardState.
@@ -2079,6 +2113,18 @@ size_t hidGetNpadStatesSystemExt(HidNpadIdType id, HidNpadSystemExtState *states
  */
 size_t hidGetNpadStatesSystem(HidNpadIdType id, HidNpadSystemState *states, size_t count);
 
+/**
+ * @brief Gets the \ref HidNpadCommonState which are newer than the specified cursor from the lifo used by the specified style, and advances the cursor.
+ * @note This returns the raw lifo contents: the style-specific adjustments done by the hidGetNpadStates* functions (for example with ::HidNpadStyleTag_NpadSystem) are not applied, and ::HidNpadStyleTag_NpadGc trigger state is not loaded.
+ * @param[in] id \ref HidNpadIdType
+ * @param[in] style \ref HidNpadStyleTag, a single style.
+ * @param[in,out] cursor \ref HidStateCursor
+ * @param[out] states Output array of \ref HidNpadCommonState, ordered newest first.
+ * @param[in] count Size of the states array in entries.
+ * @return Total output entries.
+ */
+size_t hidGetNpadStatesSince(HidNpadIdType id, HidNpadStyleTag style, HidStateCursor *cursor, HidNpadCommonState *states, size_t count);
+
 /**
  * @brief Gets \ref HidSixAxisSensorState for the specified handle.
  * @param[in] handle \ref HidSixAxisSensorHandle
@@ -2088,6 +2134,16 @@ size_t hidGetNpadStatesSystem(HidNpadIdType id, HidNpadSystemState *states, size
  */
 size_t hidGetSixAxisSensorStates(HidSixAxisSensorHandle handle, HidSixAxisSensorState *states, size_t count);
 
+/**
+ * @brief Gets the \ref HidSixAxisSensorState which are newer than the specified cursor, and advances the cursor.
+ * @param[in] handle \ref HidSixAxisSensorHandle
+ * @param[in,out] cursor \ref HidStateCursor
+ * @param[out] states Output array of \ref HidSixAxisSensorState, ordered newest first.
+ * @param[in] count Size of the states array in entries.
+ * @return Total output entries.
+ */
+size_t hidGetSixAxisSensorStatesSince(HidSixAxisSensorHandle handle, HidStateCursor *cursor, HidSixAxisSensorState *states, size_t count);
+
 ///@}
 
 ///@name Gesture
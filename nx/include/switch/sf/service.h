@@ -9,6 +9,7 @@
 #include <assert.h>
 #include "hipc.h"
 #include "cmif.h"
+#include "../runtime/trace.h"
 
 /// Service object structure
 typedef struct Service {
@@ -459,7 +460,8 @@ NX_INLINE Result serviceDispatchImpl(
     if (in_data_size)
         __builtin_memcpy(in, in_data, in_data_size);
 
-    Result rc = svcSendSyncRequest(disp.target_session == INVALID_HANDLE ? s->session : disp.target_session);
+    Handle session = disp.target_session == INVALID_HANDLE ? s->session : disp.target_session;
+    Result rc = __builtin_expect(__nx_trace_enabled, 0) ? traceSendSyncRequest(session, request_id) : svcSendSyncRequest(session);
     if (R_SUCCEEDED(rc)) {
         void* out = NULL;
         rc = serviceParseResponse(&srv,
@@ -0,0 +1,530 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "audio/adpcm.h"
+#include "../runtime/alloc.h"
+
+typedef double AdpcmVec[3];
+
+static inline double _adpcmAbs(double x)
+{
+    return x < 0.0 ? -x : x;
+}
+
+static inline s16 _adpcmClamp16(s64 x)
+{
+    if (x > 0x7FFF)
+        return 0x7FFF;
+    if (x < -0x8000)
+        return -0x8000;
+    return x;
+}
+
+static inline s16 _adpcmQuantizeCoef(double x)
+{
+    double d = x * 2048.0;
+    if (d >= 32767.0)
+        return 0x7FFF;
+    if (d <= -32768.0)
+        return -0x8000;
+    return (s16)(d > 0.0 ? d + 0.5 : d - 0.5);
+}
+
+//-----------------------------------------------------------------------------
+// Coefficient analysis
+//-----------------------------------------------------------------------------
+
+// pcm points to 14 samples, preceded by at least 2 history samples
+static void _adpcmInnerProduct(AdpcmVec out, const s16* pcm)
+{
+    for (int i = 0; i <= 2; i ++) {
+        double acc = 0.0;
+        for (int x = 0; x < ADPCM_SAMPLES_PER_FRAME; x ++)
+            acc -= (double)pcm[x-i] * pcm[x];
+        out[i] = acc;
+    }
+}
+
+static void _adpcmOuterProduct(AdpcmVec mtx[3], const s16* pcm)
+{
+    for (int x = 1; x <= 2; x ++) {
+        for (int y = 1; y <= 2; y ++) {
+            double acc = 0.0;
+            for (int z = 0; z < ADPCM_SAMPLES_PER_FRAME; z ++)
+                acc += (double)pcm[z-x] * pcm[z-y];
+            mtx[x][y] = acc;
+        }
+    }
+}
+
+// LU decomposition with partial pivoting of the 2x2 autocorrelation matrix.
+// Returns false if the matrix is singular or badly conditioned.
+static bool _adpcmDecompose(AdpcmVec mtx[3], int* pivots)
+{
+    double recips[3];
+
+    for (int x = 1; x <= 2; x ++) {
+        double a = _adpcmAbs(mtx[x][1]), b = _adpcmAbs(mtx[x][2]);
+        double val = a > b ? a : b;
+        if (val < 2.2204460492503131e-16)
+            return false;
+        recips[x] = 1.0 / val;
+    }
+
+    int max_index = 0;
+    for (int i = 1; i <= 2; i ++) {
+        for (int x = 1; x < i; x ++) {
+            double tmp = mtx[x][i];
+            for (int y = 1; y < x; y ++)
+                tmp -= mtx[x][y] * mtx[y][i];
+            mtx[x][i] = tmp;
+        }
+
+        double val = 0.0;
+        for (int x = i; x <= 2; x ++) {
+            double tmp = mtx[x][i];
+            for (int y = 1; y < i; y ++)
+                tmp -= mtx[x][y] * mtx[y][i];
+            mtx[x][i] = tmp;
+
+            tmp = _adpcmAbs(tmp) * recips[x];
+            if (tmp >= val) {
+                val = tmp;
+                max_index = x;
+            }
+        }
+
+        if (max_index != i) {
+            for (int y = 1; y <= 2; y ++) {
+                double tmp = mtx[max_index][y];
+                mtx[max_index][y] = mtx[i][y];
+                mtx[i][y] = tmp;
+            }
+            recips[max_index] = recips[i];
+        }
+
+        pivots[i] = max_index;
+
+        if (mtx[i][i] == 0.0)
+            return false;
+
+        if (i != 2) {
+            double tmp = 1.0 / mtx[i][i];
+            for (int x = i+1; x <= 2; x ++)
+                mtx[x][i] *= tmp;
+        }
+    }
+
+    double min = 1.0e10, max = 0.0;
+    for (int i = 1; i <= 2; i ++) {
+        double tmp = _adpcmAbs(mtx[i][i]);
+        if (tmp < min)
+            min = tmp;
+        if (tmp > max)
+            max = tmp;
+    }
+
+    return min / max >= 1.0e-10;
+}
+
+// Solves the decomposed system for the predictor
+static void _adpcmSolve(AdpcmVec mtx[3], const int* pivots, AdpcmVec vec)
+{
+    for (int i = 1, x = 0; i <= 2; i ++) {
+        int index = pivots[i];
+        double tmp = vec[index];
+        vec[index] = vec[i];
+        if (x != 0) {
+            for (int y = x; y <= i-1; y ++)
+                tmp -= vec[y] * mtx[i][y];
+        } else if (tmp != 0.0)
+            x = i;
+        vec[i] = tmp;
+    }
+
+    for (int i = 2; i > 0; i --) {
+        double tmp = vec[i];
+        for (int y = i+1; y <= 2; y ++)
+            tmp -= vec[y] * mtx[i][y];
+        vec[i] = tmp / mtx[i][i];
+    }
+
+    vec[0] = 1.0;
+}
+
+// Converts predictor coefficients to reflection coefficients. Returns false if unstable.
+static bool _adpcmToReflection(AdpcmVec vec)
+{
+    double v2 = vec[2];
+    double tmp = 1.0 - v2*v2;
+    if (tmp == 0.0)
+        return false;
+
+    vec[0] = (vec[0] - v2*v2) / tmp;
+    vec[1] = (vec[1] - vec[1]*v2) / tmp;
+    return _adpcmAbs(vec[1]) <= 1.0;
+}
+
+// Converts reflection coefficients back to (stable) predictor coefficients
+static void _adpcmFromReflection(AdpcmVec in, AdpcmVec out)
+{
+    for (int z = 1; z <= 2; z ++) {
+        if (in[z] >= 1.0)
+            in[z] = 0.9999999999;
+        else if (in[z] <= -1.0)
+            in[z] = -0.9999999999;
+    }
+    out[0] = 1.0;
+    out[1] = in[2]*in[1] + in[1];
+    out[2] = in[2];
+}
+
+// Computes the autocorrelation vector of the prediction filter
+static void _adpcmToAutocorrelation(const AdpcmVec src, AdpcmVec dst)
+{
+    AdpcmVec mtx[3];
+
+    mtx[2][0] = 1.0;
+    for (int i = 1; i <= 2; i ++)
+        mtx[2][i] = -src[i];
+
+    for (int i = 2; i > 0; i --) {
+        double val = 1.0 - mtx[i][i]*mtx[i][i];
+        for (int y = 1; y <= i; y ++)
+            mtx[i-1][y] = (mtx[i][i]*mtx[i][y] + mtx[i][y]) / val;
+    }
+
+    dst[0] = 1.0;
+    for (int i = 1; i <= 2; i ++) {
+        dst[i] = 0.0;
+        for (int y = 1; y <= i; y ++)
+            dst[i] += mtx[i][y] * dst[i-y];
+    }
+}
+
+// Levinson-Durbin recursion from an autocorrelation vector to a predictor
+static void _adpcmFromAutocorrelation(const AdpcmVec src, AdpcmVec dst)
+{
+    AdpcmVec refl;
+    double val = src[0];
+
+    dst[0] = 1.0;
+    for (int i = 1; i <= 2; i ++) {
+        double v2 = 0.0;
+        for (int y = 1; y < i; y ++)
+            v2 += dst[y] * src[i-y];
+
+        dst[i] = val > 0.0 ? -(v2 + src[i]) / val : 0.0;
+        refl[i] = dst[i];
+
+        for (int y = 1; y < i; y ++)
+            dst[y] += dst[i] * dst[i-y];
+
+        val *= 1.0 - dst[i]*dst[i];
+    }
+
+    _adpcmFromReflection(refl, dst);
+}
+
+// Prediction error of a given predictor against a block's autocorrelation
+static double _adpcmDistance(const AdpcmVec pred, const AdpcmVec record)
+{
+    double val = (record[2]*record[1] - record[1]) / (1.0 - record[2]*record[2]);
+    double val1 = pred[0]*pred[0] + pred[1]*pred[1] + pred[2]*pred[2];
+    double val2 = pred[0]*pred[1] + pred[1]*pred[2];
+    double val3 = pred[0]*pred[2];
+    return val1 + 2.0*val*val2 + 2.0*(-record[1]*val - record[2])*val3;
+}
+
+// Refines the first num_best predictors by clustering the records around them
+static void _adpcmRefine(AdpcmVec* best, int num_best, const AdpcmVec* records, u32 num_records)
+{
+    AdpcmVec sums[8];
+    u32 counts[8];
+
+    for (int pass = 0; pass < 2; pass ++) {
+        memset(sums, 0, sizeof(sums));
+        memset(counts, 0, sizeof(counts));
+
+        for (u32 z = 0; z < num_records; z ++) {
+            int index = 0;
+            double value = 1.0e30;
+            for (int i = 0; i < num_best; i ++) {
+                double tmp = _adpcmDistance(best[i], records[z]);
+                if (tmp < value) {
+                    value = tmp;
+                    index = i;
+                }
+            }
+
+            AdpcmVec autocorr;
+            _adpcmToAutocorrelation(records[z], autocorr);
+            counts[index] ++;
+            for (int i = 0; i <= 2; i ++)
+                sums[index][i] += autocorr[i];
+        }
+
+        for (int i = 0; i < num_best; i ++) {
+            if (counts[i])
+                for (int y = 0; y <= 2; y ++)
+                    sums[i][y] /= counts[i];
+            _adpcmFromAutocorrelation(sums[i], best[i]);
+        }
+    }
+}
+
+Result adpcmComputeParameters(AudioRendererAdpcmParameters* out_params, const s16* pcm, u32 num_samples, u32 stride)
+{
+    if (!out_params || (num_samples && !pcm) || !stride)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32 num_frames = (num_samples + ADPCM_SAMPLES_PER_FRAME - 1) / ADPCM_SAMPLES_PER_FRAME;
+    AdpcmVec* records = (AdpcmVec*)__libnx_alloc(sizeof(AdpcmVec) * (num_frames ? num_frames : 1));
+    if (!records)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    // Compute a stable predictor for each frame-sized block of input
+    s16 block[2+ADPCM_SAMPLES_PER_FRAME] = {0};
+    u32 num_records = 0;
+    for (u32 pos = 0; pos < num_samples; pos += ADPCM_SAMPLES_PER_FRAME) {
+        block[0] = block[ADPCM_SAMPLES_PER_FRAME];
+        block[1] = block[ADPCM_SAMPLES_PER_FRAME+1];
+        for (u32 i = 0; i < ADPCM_SAMPLES_PER_FRAME; i ++)
+            block[2+i] = pos+i < num_samples ? pcm[(size_t)(pos+i)*stride] : 0;
+
+        AdpcmVec vec, mtx[3];
+        int pivots[3];
+        _adpcmInnerProduct(vec, &block[2]);
+        if (_adpcmAbs(vec[0]) <= 10.0)
+            continue;
+
+        _adpcmOuterProduct(mtx, &block[2]);
+        if (!_adpcmDecompose(mtx, pivots))
+            continue;
+
+        _adpcmSolve(mtx, pivots, vec);
+        if (!_adpcmToReflection(vec))
+            continue;
+
+        _adpcmFromReflection(vec, records[num_records++]);
+    }
+
+    // Average all predictors into the initial guess
+    AdpcmVec best[8];
+    AdpcmVec avg = { 1.0, 0.0, 0.0 };
+    for (u32 z = 0; z < num_records; z ++) {
+        AdpcmVec autocorr;
+        _adpcmToAutocorrelation(records[z], autocorr);
+        for (int y = 1; y <= 2; y ++)
+            avg[y] += autocorr[y];
+    }
+    if (num_records)
+        for (int y = 1; y <= 2; y ++)
+            avg[y] /= num_records;
+    _adpcmFromAutocorrelation(avg, best[0]);
+
+    // Split the set of predictors in two and refine, three times (1 -> 2 -> 4 -> 8)
+    for (int num_best = 1; num_best < 8; num_best *= 2) {
+        for (int i = 0; i < num_best; i ++) {
+            best[num_best+i][0] = best[i][0];
+            best[num_best+i][1] = best[i][1] - 0.01;
+            best[num_best+i][2] = best[i][2];
+        }
+        _adpcmRefine(best, num_best*2, records, num_records);
+    }
+
+    __libnx_free(records);
+
+    for (int i = 0; i < 8; i ++) {
+        out_params->coefficients[i*2+0] = (u16)_adpcmQuantizeCoef(-best[i][1]);
+        out_params->coefficients[i*2+1] = (u16)_adpcmQuantizeCoef(-best[i][2]);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Encoding/decoding
+//-----------------------------------------------------------------------------
+
+// pcm[0..1] contains the history, pcm[2..2+count] the samples to encode.
+// On return, pcm[2..2+count] contains the samples as the decoder will reconstruct them.
+static u8 _adpcmEncodeFrame(u8* out, s32* pcm, u32 count, const s16* coefs)
+{
+    s32 residuals[ADPCM_SAMPLES_PER_FRAME][8];
+    s32 max_dist[8];
+    s32 decoded[8][2+ADPCM_SAMPLES_PER_FRAME];
+    s32 nibbles[8][ADPCM_SAMPLES_PER_FRAME];
+    s32 scales[8];
+    u64 errors[8];
+
+    // Evaluate the unquantized prediction error of all 8 predictors at once.
+    // The predictor index is the innermost dimension so that the loop can be vectorized.
+    for (u32 s = 0; s < count; s ++)
+        for (int i = 0; i < 8; i ++)
+            residuals[s][i] = pcm[s+2] - (s32)(((s64)pcm[s]*coefs[i*2+1] + (s64)pcm[s+1]*coefs[i*2+0]) / 2048);
+
+    for (int i = 0; i < 8; i ++)
+        max_dist[i] = 0;
+    for (u32 s = 0; s < count; s ++) {
+        for (int i = 0; i < 8; i ++) {
+            s32 r = residuals[s][i];
+            r = r > 0x7FFF ? 0x7FFF : r < -0x8000 ? -0x8000 : r;
+            s32 a = r < 0 ? -r : r;
+            s32 m = max_dist[i] < 0 ? -max_dist[i] : max_dist[i];
+            if (a > m)
+                max_dist[i] = r;
+        }
+    }
+
+    // Quantize the residual using each predictor, searching for the smallest usable scale
+    for (int i = 0; i < 8; i ++) {
+        s32 c0 = coefs[i*2+0], c1 = coefs[i*2+1];
+        s32 dist = max_dist[i];
+        s32 scale;
+        for (scale = 0; scale <= 12 && (dist > 7 || dist < -8); scale ++)
+            dist /= 2;
+        scale = scale <= 1 ? -1 : scale - 2;
+
+        s32 overflow;
+        do {
+            scale ++;
+            overflow = 0;
+            errors[i] = 0;
+            decoded[i][0] = pcm[0];
+            decoded[i][1] = pcm[1];
+
+            for (u32 s = 0; s < count; s ++) {
+                s64 pred = (s64)decoded[i][s]*c1 + (s64)decoded[i][s+1]*c0;
+                s64 diff = ((s64)pcm[s+2] << 11) - pred;
+                double scaled = (double)diff / (1 << scale) / 2048;
+                s32 nib = diff > 0 ? (s32)(scaled + 0.4999999f) : (s32)(scaled - 0.4999999f);
+
+                if (nib < -8) {
+                    if (overflow < -8 - nib)
+                        overflow = -8 - nib;
+                    nib = -8;
+                } else if (nib > 7) {
+                    if (overflow < nib - 7)
+                        overflow = nib - 7;
+                    nib = 7;
+                }
+
+                nibbles[i][s] = nib;
+                s32 sample = _adpcmClamp16((pred + ((s64)(nib * (1 << scale)) << 11) + 1024) >> 11);
+                decoded[i][s+2] = sample;
+
+                s32 err = pcm[s+2] - sample;
+                errors[i] += (u64)((s64)err*err);
+            }
+
+            for (s32 x = overflow + 8; x > 256; x >>= 1)
+                if (++scale >= 12)
+                    scale = 11;
+        } while (scale < 12 && overflow > 1);
+
+        scales[i] = scale;
+    }
+
+    int best = 0;
+    for (int i = 1; i < 8; i ++)
+        if (errors[i] < errors[best])
+            best = i;
+
+    for (u32 s = 0; s < count; s ++)
+        pcm[s+2] = decoded[best][s+2];
+    for (u32 s = count; s < ADPCM_SAMPLES_PER_FRAME; s ++)
+        nibbles[best][s] = 0;
+
+    out[0] = (best << 4) | (scales[best] & 0xF);
+    for (int y = 0; y < ADPCM_SAMPLES_PER_FRAME/2; y ++)
+        out[1+y] = ((nibbles[best][y*2] & 0xF) << 4) | (nibbles[best][y*2+1] & 0xF);
+
+    return out[0];
+}
+
+Result adpcmEncode(void* out, size_t out_size, const s16* pcm, u32 num_samples, u32 stride, const AudioRendererAdpcmParameters* params, AudioRendererAdpcmContext* ctx, AudioRendererAdpcmContext* out_start_ctx)
+{
+    if (!out || (num_samples && !pcm) || !stride || !params || !ctx)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (out_size < adpcmGetEncodedSize(num_samples))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    s16 coefs[16];
+    for (int i = 0; i < 16; i ++)
+        coefs[i] = (s16)params->coefficients[i];
+
+    u8* out_u8 = (u8*)out;
+    s32 frame[2+ADPCM_SAMPLES_PER_FRAME];
+    frame[0] = ctx->history1;
+    frame[1] = ctx->history0;
+
+    if (out_start_ctx)
+        *out_start_ctx = *ctx;
+
+    for (u32 pos = 0; pos < num_samples; pos += ADPCM_SAMPLES_PER_FRAME) {
+        u32 count = num_samples - pos;
+        if (count > ADPCM_SAMPLES_PER_FRAME)
+            count = ADPCM_SAMPLES_PER_FRAME;
+
+        for (u32 s = 0; s < count; s ++)
+            frame[2+s] = pcm[(size_t)(pos+s)*stride];
+
+        u8 header = _adpcmEncodeFrame(out_u8, frame, count, coefs);
+        if (pos == 0 && out_start_ctx)
+            out_start_ctx->index = header;
+
+        // The decoder keeps decoding through the zero padding of a partial frame
+        for (u32 s = count; s < ADPCM_SAMPLES_PER_FRAME; s ++) {
+            s64 pred = (s64)frame[s]*coefs[(header>>4)*2+1] + (s64)frame[s+1]*coefs[(header>>4)*2+0];
+            frame[s+2] = _adpcmClamp16((pred + 1024) >> 11);
+        }
+
+        ctx->index = header;
+        frame[0] = frame[ADPCM_SAMPLES_PER_FRAME];
+        frame[1] = frame[ADPCM_SAMPLES_PER_FRAME+1];
+        out_u8 += ADPCM_BYTES_PER_FRAME;
+    }
+
+    ctx->history0 = frame[1];
+    ctx->history1 = frame[0];
+    return 0;
+}
+
+Result adpcmDecode(s16* pcm, u32 num_samples, const void* in, size_t in_size, const AudioRendererAdpcmParameters* params, AudioRendererAdpcmContext* ctx)
+{
+    if ((num_samples && (!pcm || !in)) || !params || !ctx)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (in_size < adpcmGetEncodedSize(num_samples))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    const u8* in_u8 = (const u8*)in;
+    s32 hist0 = ctx->history0, hist1 = ctx->history1;
+
+    for (u32 pos = 0; pos < num_samples; pos += ADPCM_SAMPLES_PER_FRAME) {
+        u8 header = *in_u8++;
+        s32 c0 = (s16)params->coefficients[(header>>4)*2+0];
+        s32 c1 = (s16)params->coefficients[(header>>4)*2+1];
+        s32 scale = 1 << (header & 0xF);
+
+        for (u32 s = 0; s < ADPCM_SAMPLES_PER_FRAME; s ++) {
+            u8 byte = in_u8[s/2];
+            s32 nib = (s & 1) ? (s32)(byte & 0xF) : (s32)(byte >> 4);
+            if (nib >= 8)
+                nib -= 16;
+
+            s32 sample = _adpcmClamp16((((s64)(nib * scale) << 11) + 1024 + (s64)c0*hist0 + (s64)c1*hist1) >> 11);
+            hist1 = hist0;
+            hist0 = sample;
+            if (pos+s < num_samples)
+                pcm[pos+s] = sample;
+        }
+
+        ctx->index = header;
+        in_u8 += ADPCM_BYTES_PER_FRAME-1;
+    }
+
+    ctx->history0 = hist0;
+    ctx->history1 = hist1;
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "driver_internal.h"
+#include "runtime/trace.h"
 
 static inline void _audrvInitConfig(AudioDriver* d, int num_final_mix_channels)
 {
@@ -78,6 +79,7 @@ Result audrvCreate(AudioDriver* d, const AudioRendererConfig* config, int num_fi
     d->etc->voices = (AudioDriverEtcVoice*)(d->etc->mempools+d->etc->mempool_count);
     d->etc->mixes = (AudioDriverEtcMix*)(d->etc->voices+config->num_voices);
     d->etc->sinks = (AudioDriverEtcSink*)(d->etc->mixes+config->num_mix_objs);
+    d->etc->perf_frames = (AudioDriverPerformanceFrame*)(d->etc->sinks+config->num_sinks);
 
     d->etc->out_buf_size = audrenGetOutputParamSize(config);
     d->etc->out_buf = __libnx_aligned_alloc(AUDREN_OUTPUT_PARAM_ALIGNMENT, d->etc->out_buf_size);
@@ -89,9 +91,19 @@ Result audrvCreate(AudioDriver* d, const AudioRendererConfig* config, int num_fi
     if (!d->etc->in_buf)
         goto _error2;
 
+    d->etc->perf_buf_size = audrenGetPerformanceBufferSize(config);
+    if (d->etc->perf_buf_size) {
+        d->etc->perf_buf = __libnx_aligned_alloc(AUDREN_OUTPUT_PARAM_ALIGNMENT, d->etc->perf_buf_size);
+        if (!d->etc->perf_buf)
+            goto _error3;
+    }
+
     _audrvInitConfig(d, num_final_mix_channels);
+    d->is_dirty = true;
     return 0;
 
+_error3:
+    __libnx_free(d->etc->in_buf);
 _error2:
     __libnx_free(d->etc->out_buf);
 _error1:
@@ -101,43 +113,144 @@ _error0:
     return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
 }
 
-Result audrvUpdate(AudioDriver* d)
+static void _audrvPerformanceParse(AudioDriver* d, size_t written_sz)
 {
-    for (int i = d->etc->first_used_voice, j = 0; i >= 0; i = d->etc->voices[i].next_used_voice, j++)
-        d->in_voices[i].sorting_order = j;
+    const u8* pos = (const u8*)d->etc->perf_buf;
+    const u8* end = pos + (written_sz < d->etc->perf_buf_size ? written_sz : d->etc->perf_buf_size);
+    int count = 0;
+
+    // Frames are laid out back to back, each one followed by its entries and details
+    while (count < d->config.num_perf_frames && pos + sizeof(AudioRendererPerformanceFrameHeader) <= end) {
+        const AudioRendererPerformanceFrameHeader* hdr = (const AudioRendererPerformanceFrameHeader*)pos;
+        if (hdr->magic != AUDREN_PERFORMANCE_FRAME_MAGIC)
+            break;
 
-    Result rc = audrenRequestUpdateAudioRenderer(d->etc->in_buf, d->etc->in_buf_size, d->etc->out_buf, d->etc->out_buf_size, NULL, 0);
+        size_t frame_sz = sizeof(*hdr);
+        frame_sz += sizeof(AudioRendererPerformanceEntry) * hdr->entry_count;
+        frame_sz += sizeof(AudioRendererPerformanceDetail) * hdr->detail_count;
+        if (pos + frame_sz > end)
+            break;
+
+        AudioDriverPerformanceFrame* frame = &d->etc->perf_frames[count++];
+        frame->total_processing_time = hdr->total_processing_time;
+        frame->voice_drop_count = hdr->voice_drop_count;
+        frame->num_entries = hdr->entry_count;
+        frame->num_details = hdr->detail_count;
+        frame->entries = (const AudioRendererPerformanceEntry*)(hdr+1);
+        frame->details = (const AudioRendererPerformanceDetail*)(frame->entries+hdr->entry_count);
+
+        pos += frame_sz;
+    }
+
+    d->etc->perf_frame_count = count;
+}
+
+static Result _audrvUpdate(AudioDriver* d)
+{
+    if (d->etc->voice_list_changed) {
+        for (int i = d->etc->first_used_voice, j = 0; i >= 0; i = d->etc->voices[i].next_used_voice, j++)
+            d->in_voices[i].sorting_order = j;
+        d->etc->voice_list_changed = false;
+    }
+
+    Result rc = audrenRequestUpdateAudioRenderer(d->etc->in_buf, d->etc->in_buf_size, d->etc->out_buf, d->etc->out_buf_size, d->etc->perf_buf, d->etc->perf_buf_size);
     if (R_FAILED(rc))
         return rc;
 
+    d->is_dirty = false;
     AudioRendererUpdateDataHeader* out_hdr = (AudioRendererUpdateDataHeader*)d->etc->out_buf;
 
     AudioRendererMemPoolInfoOut* out_mempools = (AudioRendererMemPoolInfoOut*)(out_hdr+1);
     if (out_hdr->mempools_sz != d->etc->mempool_count*sizeof(AudioRendererMemPoolInfoOut))
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
 
-    for (int i = 0; i < d->etc->mempool_count; i ++)
-    {
-        // todo: this is supposed to be more complex
-        AudioRendererMemPoolState new_state = out_mempools[i].new_state;
-        if (new_state != AudioRendererMemPoolState_Invalid)
-            d->in_mempools[i].state = new_state;
+    // Mempool states only change in response to a request, so skip them if none are in flight
+    if (d->etc->mempools_pending) {
+        bool pending = false;
+        for (int i = 0; i < d->etc->mempool_count; i ++)
+        {
+            // todo: this is supposed to be more complex
+            AudioRendererMemPoolState new_state = out_mempools[i].new_state;
+            if (new_state != AudioRendererMemPoolState_Invalid)
+                d->in_mempools[i].state = new_state;
+            pending = pending || _audrvMemPoolIsPending(d, i);
+        }
+        d->etc->mempools_pending = pending;
     }
 
     AudioRendererVoiceInfoOut* out_voices = (AudioRendererVoiceInfoOut*)(out_mempools+d->etc->mempool_count);
     if (out_hdr->voices_sz != d->config.num_voices*sizeof(AudioRendererVoiceInfoOut))
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
 
-    for (int i = d->etc->first_used_voice; i >= 0; i = d->etc->voices[i].next_used_voice)
+    // Voices with no wavebufs and no pending state change have nothing to report
+    bool has_active_voices = false;
+    for (int i = d->etc->first_used_voice; i >= 0; i = d->etc->voices[i].next_used_voice) {
+        if (!d->etc->voices[i].first_wavebuf && !d->in_voices[i].is_new)
+            continue;
         _audrvVoiceUpdate(d, i, &out_voices[i]);
+        has_active_voices = has_active_voices || d->etc->voices[i].first_wavebuf != NULL;
+    }
+    d->etc->has_active_voices = has_active_voices;
+
+    if (d->etc->perf_buf) {
+        u8* out_perfbuf = (u8*)(out_voices+d->config.num_voices) + out_hdr->effects_sz + out_hdr->sinks_sz;
+        if (out_hdr->perfmgr_sz >= sizeof(AudioRendererPerformanceBufferInfoOut))
+            _audrvPerformanceParse(d, ((AudioRendererPerformanceBufferInfoOut*)out_perfbuf)->written_sz);
+    }
 
     return 0;
 }
 
+Result audrvUpdate(AudioDriver* d)
+{
+    traceBegin("audrvUpdate", 0);
+    Result rc = _audrvUpdate(d);
+    traceEnd("audrvUpdate", rc);
+    return rc;
+}
+
+bool audrvNeedsUpdate(AudioDriver* d)
+{
+    // Performance metrics keep being produced (and must be drained) regardless of state changes,
+    // so idle updates are never skipped while the performance buffer is enabled
+    return d->is_dirty || d->etc->has_active_voices || d->etc->mempools_pending || d->etc->perf_buf != NULL;
+}
+
 void audrvClose(AudioDriver* d)
 {
+    __libnx_free(d->etc->perf_buf);
     __libnx_free(d->etc->in_buf);
     __libnx_free(d->etc->out_buf);
     __libnx_free(d->etc);
     memset(d, 0, sizeof(AudioDriver));
 }
+
+int audrvPerformanceGetFrameCount(AudioDriver* d)
+{
+    return d->etc->perf_frame_count;
+}
+
+const AudioDriverPerformanceFrame* audrvPerformanceGetFrame(AudioDriver* d, int index)
+{
+    if (index < 0 || index >= d->etc->perf_frame_count)
+        return NULL;
+    return &d->etc->perf_frames[index];
+}
+
+u32 audrvPerformanceGetNodeProcessingTime(AudioDriver* d, u32 node_id)
+{
+    u32 total = 0;
+    for (int i = 0; i < d->etc->perf_frame_count; i ++) {
+        const AudioDriverPerformanceFrame* frame = &d->etc->perf_frames[i];
+        for (u32 j = 0; j < frame->num_entries; j ++)
+            if (frame->entries[j].node_id == node_id)
+                total += frame->entries[j].processing_time;
+    }
+    return total;
+}
+
+void audrvPerformanceSetDetailTarget(AudioDriver* d, u32 node_id)
+{
+    d->etc->in_perfbuf->detail_target = node_id;
+    d->is_dirty = true;
+}
@@ -43,6 +43,9 @@ struct AudioDriverEtc {
     int first_free_channel;
     int first_free_mix;
     int first_free_sink;
+    bool voice_list_changed;
+    bool mempools_pending;
+    bool has_active_voices;
     AudioDriverEtcMemPool* mempools;
     AudioDriverEtcVoice* voices;
     AudioDriverEtcMix* mixes;
@@ -53,6 +56,10 @@ struct AudioDriverEtc {
     size_t in_buf_size;
     void* out_buf;
     size_t out_buf_size;
+    void* perf_buf;
+    size_t perf_buf_size;
+    int perf_frame_count;
+    AudioDriverPerformanceFrame* perf_frames;
 };
 
 static inline size_t _audrvGetEtcSize(const AudioRendererConfig* config)
@@ -63,7 +70,20 @@ static inline size_t _audrvGetEtcSize(const AudioRendererConfig* config)
     size += sizeof(AudioDriverEtcVoice) * config->num_voices;
     size += sizeof(AudioDriverEtcMix) * config->num_mix_objs;
     size += sizeof(AudioDriverEtcSink) * config->num_sinks;
+    size += sizeof(AudioDriverPerformanceFrame) * config->num_perf_frames;
     return size;
 }
 
+static inline bool _audrvMemPoolIsPending(AudioDriver* d, int id)
+{
+    AudioRendererMemPoolState state = d->in_mempools[id].state;
+    return state == AudioRendererMemPoolState_RequestAttach || state == AudioRendererMemPoolState_RequestDetach;
+}
+
+static inline void _audrvMemPoolMarkDirty(AudioDriver* d)
+{
+    d->is_dirty = true;
+    d->etc->mempools_pending = true;
+}
+
 void _audrvVoiceUpdate(AudioDriver* d, int id, AudioRendererVoiceInfoOut* out_voice);
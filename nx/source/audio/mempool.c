@@ -15,6 +15,7 @@ int audrvMemPoolAdd(AudioDriver* d, void* buffer, size_t size)
     d->in_mempools[id].address = buffer;
     d->in_mempools[id].size = size;
     d->in_mempools[id].state = AudioRendererMemPoolState_New;
+    _audrvMemPoolMarkDirty(d);
 
     return id;
 }
@@ -31,6 +32,7 @@ bool audrvMemPoolRemove(AudioDriver* d, int id)
     d->in_mempools[id].address = NULL;
     d->in_mempools[id].size = 0;
     d->in_mempools[id].state = AudioRendererMemPoolState_Released;
+    d->is_dirty = true;
 
     return true;
 }
@@ -45,10 +47,12 @@ bool audrvMemPoolAttach(AudioDriver* d, int id)
         case AudioRendererMemPoolState_RequestAttach:
         case AudioRendererMemPoolState_Detached:
             d->in_mempools[id].state = AudioRendererMemPoolState_RequestAttach;
+            _audrvMemPoolMarkDirty(d);
             return true;
         case AudioRendererMemPoolState_RequestDetach:
         case AudioRendererMemPoolState_Attached:
             d->in_mempools[id].state = AudioRendererMemPoolState_Attached;
+            _audrvMemPoolMarkDirty(d);
             return true;
         default:
             return false;
@@ -66,10 +70,12 @@ bool audrvMemPoolDetach(AudioDriver* d, int id)
         case AudioRendererMemPoolState_RequestAttach:
         case AudioRendererMemPoolState_Detached:
             d->in_mempools[id].state = AudioRendererMemPoolState_Detached;
+            _audrvMemPoolMarkDirty(d);
             return true;
         case AudioRendererMemPoolState_RequestDetach:
         case AudioRendererMemPoolState_Attached:
             d->in_mempools[id].state = AudioRendererMemPoolState_RequestDetach;
+            _audrvMemPoolMarkDirty(d);
             return true;
         default:
             return false;
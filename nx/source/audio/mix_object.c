@@ -22,6 +22,7 @@ int audrvMixAdd(AudioDriver* d, int sample_rate, int num_channels)
     d->in_mixes[id].node_id = AUDREN_NODEID(2,id,0);
     d->in_mixes[id].dest_mix_id = AUDREN_UNUSED_MIX_ID;
     d->in_mixes[id].dest_splitter_id = AUDREN_UNUSED_SPLITTER_ID;
+    d->is_dirty = true;
 
     return id;
 }
@@ -37,4 +38,5 @@ void audrvMixRemove(AudioDriver* d, int id)
     d->etc->mixes[id].next_free = d->etc->first_free_mix;
     d->etc->first_free_mix = id;
     memset(&d->in_mixes[id], 0, sizeof(AudioRendererMixInfoIn));
+    d->is_dirty = true;
 }
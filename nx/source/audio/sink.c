@@ -16,6 +16,7 @@ int audrvDeviceSinkAdd(AudioDriver* d, const char* device_name, int num_channels
     strncpy(d->in_sinks[id].device_sink.name, device_name, sizeof(d->in_sinks[id].device_sink.name)-1);
     d->in_sinks[id].device_sink.input_count = num_channels;
     memcpy(d->in_sinks[id].device_sink.inputs, channel_ids, num_channels);
+    d->is_dirty = true;
 
     return id;
 }
@@ -30,4 +31,5 @@ void audrvSinkRemove(AudioDriver* d, int id)
     d->etc->sinks[id].next_free = d->etc->first_free_sink;
     d->etc->first_free_sink = id;
     memset(&d->in_sinks[id], 0, sizeof(AudioRendererSinkInfoIn));
+    d->is_dirty = true;
 }
@@ -37,6 +37,8 @@ bool audrvVoiceInit(AudioDriver* d, int id, int num_channels, PcmFormat format,
     d->etc->first_used_voice = id;
     if (next_voice >= 0)
         d->etc->voices[next_voice].prev_next_voice = &d->etc->voices[id].next_used_voice;
+    d->etc->voice_list_changed = true;
+    d->is_dirty = true;
 
     // Allocate the channels
     d->etc->free_channel_count -= num_channels;
@@ -83,6 +85,8 @@ void audrvVoiceDrop(AudioDriver* d, int id)
     *d->etc->voices[id].prev_next_voice = next_voice;
     if (next_voice >= 0)
         d->etc->voices[next_voice].prev_next_voice = d->etc->voices[id].prev_next_voice;
+    d->etc->voice_list_changed = true;
+    d->is_dirty = true;
 
     // Clear out state
     memset(&d->in_voices[id], 0, sizeof(AudioRendererVoiceInfoIn));
@@ -104,6 +108,7 @@ void audrvVoiceStop(AudioDriver* d, int id)
 
     // Reset internal state
     _audrvVoiceResetInternalState(d, id);
+    d->is_dirty = true;
 }
 
 bool audrvVoiceIsPaused(AudioDriver* d, int id)
@@ -164,6 +169,7 @@ bool audrvVoiceAddWaveBuf(AudioDriver* d, int id, AudioDriverWaveBuf* wavebuf)
     d->etc->voices[id].last_wavebuf = wavebuf;
 
     _audrvVoiceQueueWaveBufs(d, id);
+    d->is_dirty = true;
     return true;
 }
 
@@ -201,6 +207,7 @@ void audrvVoiceSetBiquadFilter(AudioDriver* d, int id, int biquad_id, float a0,
     d->in_voices[id].biquads[biquad_id].numerator[2] = _audrvIirParamClamp(b2 / a0);
     d->in_voices[id].biquads[biquad_id].denominator[0] = _audrvIirParamClamp(a1 / a0);
     d->in_voices[id].biquads[biquad_id].denominator[1] = _audrvIirParamClamp(a2 / a0);
+    d->is_dirty = true;
 }
 
 void _audrvVoiceUpdate(AudioDriver* d, int id, AudioRendererVoiceInfoOut* out_voice)
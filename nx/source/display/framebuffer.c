@@ -6,6 +6,7 @@
 #include "services/nv.h"
 #include "services/vi.h"
 #include "runtime/diag.h"
+#include "runtime/trace.h"
 #include "display/binder.h"
 #include "display/buffer_producer.h"
 #include "display/native_window.h"
@@ -221,13 +222,16 @@ void framebufferEnd(Framebuffer* fb)
     if (!fb->has_init)
         return;
 
-    void* buf = (u8*)fb->buf + fb->win->cur_slot*fb->fb_size;
+    s32 slot = fb->win->cur_slot;
+    traceBegin("framebufferEnd", slot);
+    void* buf = (u8*)fb->buf + slot*fb->fb_size;
     if (fb->buf_linear)
         _convertToBlocklinear(buf, fb->buf_linear, fb->stride, fb->win->height, 4);
 
     armDCacheFlush(buf, fb->fb_size);
 
-    Result rc = nwindowQueueBuffer(fb->win, fb->win->cur_slot, NULL);
+    Result rc = nwindowQueueBuffer(fb->win, slot, NULL);
     if (R_FAILED(rc))
         diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_BadGfxQueueBuffer));
+    traceEnd("framebufferEnd", slot);
 }
@@ -0,0 +1,41 @@
+#pragma once
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+
+// Computes the deadline (in ticks) corresponding to a timeout in nanoseconds, UINT64_MAX meaning no timeout.
+static inline u64 _arbGetDeadline(u64 timeout_ns)
+{
+    return timeout_ns != UINT64_MAX ? armGetSystemTick() + armNsToTicks(timeout_ns) : UINT64_MAX;
+}
+
+// Waits for the value at addr to be different from value, or for the deadline to pass.
+// Returns false on timeout; spurious wakeups are possible, so callers must re-check their condition.
+static inline bool _arbWaitIfEqual(u32* addr, u32 value, u64 deadline)
+{
+    s64 timeout = -1;
+    if (deadline != UINT64_MAX) {
+        s64 remaining = deadline - armGetSystemTick();
+        if (remaining <= 0)
+            return false;
+        timeout = armTicksToNs(remaining);
+    }
+
+    Result res = svcWaitForAddress(addr, ArbitrationType_WaitIfEqual, (s32)value, timeout);
+    if (R_FAILED(res)) {
+        if (R_VALUE(res) == KERNELRESULT(TimedOut))
+            return false;
+        if (R_VALUE(res) != KERNELRESULT(InvalidState))
+            svcBreak(BreakReason_Assert, 0, 0); // should not happen
+    }
+
+    return true;
+}
+
+// Wakes up to count threads waiting on addr (-1 for all of them).
+static inline void _arbSignal(u32* addr, s32 count)
+{
+    Result res = svcSignalToAddress(addr, SignalType_Signal, 0, count);
+    if (R_FAILED(res))
+        svcBreak(BreakReason_Assert, 0, 0); // should not happen
+}
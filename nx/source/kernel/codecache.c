@@ -0,0 +1,244 @@
+#include <string.h>
+#include "types.h"
+#include "result.h"
+#include "arm/cache.h"
+#include "kernel/codecache.h"
+#include "../runtime/alloc.h"
+
+// Free ranges are tracked outside of the JIT buffers, since with JitType_SetProcessMemoryPermission
+// the writable alias isn't accessible while the region is executable.
+
+static Result _codecacheRegionCreate(CodeCacheRegion* r, size_t size)
+{
+    memset(r, 0, sizeof(*r));
+
+    CodeCacheFreeNode* node = (CodeCacheFreeNode*)__libnx_alloc(sizeof(CodeCacheFreeNode));
+    if (!node)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    Result rc = jitCreate(&r->jit, size);
+    if (R_FAILED(rc)) {
+        __libnx_free(node);
+        return rc;
+    }
+
+    node->next = NULL;
+    node->offset = 0;
+    node->size = r->jit.size;
+    r->free_list = node;
+    return 0;
+}
+
+static void _codecacheRegionClose(CodeCacheRegion* r)
+{
+    jitClose(&r->jit);
+
+    while (r->free_list) {
+        CodeCacheFreeNode* next = r->free_list->next;
+        __libnx_free(r->free_list);
+        r->free_list = next;
+    }
+}
+
+static bool _codecacheRegionAlloc(CodeCacheRegion* r, size_t size, size_t* out_offset)
+{
+    // First fit.
+    for (CodeCacheFreeNode** link = &r->free_list; *link; link = &(*link)->next) {
+        CodeCacheFreeNode* n = *link;
+        if (n->size < size)
+            continue;
+
+        *out_offset = n->offset;
+        n->offset += size;
+        n->size -= size;
+        if (!n->size) {
+            *link = n->next;
+            __libnx_free(n);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+static void _codecacheRegionFree(CodeCacheRegion* r, size_t offset, size_t size)
+{
+    CodeCacheFreeNode* prev = NULL;
+    CodeCacheFreeNode* next = r->free_list;
+    while (next && next->offset < offset) {
+        prev = next;
+        next = next->next;
+    }
+
+    bool merge_prev = prev && prev->offset + prev->size == offset;
+    bool merge_next = next && offset + size == next->offset;
+
+    if (merge_prev && merge_next) {
+        prev->size += size + next->size;
+        prev->next = next->next;
+        __libnx_free(next);
+    }
+    else if (merge_prev)
+        prev->size += size;
+    else if (merge_next) {
+        next->offset = offset;
+        next->size += size;
+    }
+    else {
+        CodeCacheFreeNode* node = (CodeCacheFreeNode*)__libnx_alloc(sizeof(CodeCacheFreeNode));
+        if (!node)
+            return; // The range is lost, which only wastes space.
+
+        node->next = next;
+        node->offset = offset;
+        node->size = size;
+        if (prev)
+            prev->next = node;
+        else
+            r->free_list = node;
+    }
+}
+
+Result codecacheCreate(CodeCache* c, size_t region_size, u32 max_regions)
+{
+    if (!region_size || !max_regions)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    c->regions = (CodeCacheRegion*)__libnx_alloc(max_regions * sizeof(CodeCacheRegion));
+    if (!c->regions)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    rmutexInit(&c->mutex);
+    c->region_size = (region_size + 0xFFF) &~ 0xFFF;
+    c->max_regions = max_regions;
+    c->num_regions = 0;
+    c->batch_depth = 0;
+    return 0;
+}
+
+void codecacheClose(CodeCache* c)
+{
+    for (u32 i = 0; i < c->num_regions; i ++)
+        _codecacheRegionClose(&c->regions[i]);
+
+    __libnx_free(c->regions);
+    c->regions = NULL;
+    c->num_regions = 0;
+}
+
+Result codecacheAlloc(CodeCache* c, size_t size, CodeCacheBlock* out)
+{
+    size = (size + CODECACHE_ALIGN - 1) &~ (CODECACHE_ALIGN - 1);
+    if (!size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    Result rc = 0;
+    size_t offset = 0;
+    u32 i;
+    rmutexLock(&c->mutex);
+
+    for (i = 0; i < c->num_regions; i ++)
+        if (_codecacheRegionAlloc(&c->regions[i], size, &offset))
+            break;
+
+    if (i == c->num_regions) {
+        if (c->num_regions == c->max_regions)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        else
+            rc = _codecacheRegionCreate(&c->regions[i], size > c->region_size ? size : c->region_size);
+
+        if (R_SUCCEEDED(rc)) {
+            c->num_regions ++;
+            _codecacheRegionAlloc(&c->regions[i], size, &offset);
+        }
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        CodeCacheRegion* r = &c->regions[i];
+        out->rw_addr = (u8*)jitGetRwAddr(&r->jit) + offset;
+        out->rx_addr = (u8*)jitGetRxAddr(&r->jit) + offset;
+        out->size = size;
+        out->region = i;
+        out->offset = offset;
+    }
+
+    rmutexUnlock(&c->mutex);
+    return rc;
+}
+
+void codecacheFree(CodeCache* c, const CodeCacheBlock* b)
+{
+    rmutexLock(&c->mutex);
+    _codecacheRegionFree(&c->regions[b->region], b->offset, b->size);
+    rmutexUnlock(&c->mutex);
+}
+
+void codecacheBeginBatch(CodeCache* c)
+{
+    rmutexLock(&c->mutex);
+    c->batch_depth ++;
+}
+
+Result codecachePrepareWrite(CodeCache* c, const CodeCacheBlock* b, size_t offset, size_t size)
+{
+    if (!c->batch_depth || offset > b->size || size > b->size - offset)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (!size)
+        return 0;
+
+    Result rc = 0;
+    CodeCacheRegion* r = &c->regions[b->region];
+
+    // The CodeMemory aliases are always writable, so only the touched ranges need maintenance.
+    if (r->jit.type == JitType_SetProcessMemoryPermission && r->jit.is_executable)
+        rc = jitTransitionToWritable(&r->jit);
+
+    if (R_SUCCEEDED(rc)) {
+        size_t start = b->offset + offset;
+        size_t end = start + size;
+        if (!r->dirty_end) {
+            r->dirty_start = start;
+            r->dirty_end = end;
+        }
+        else {
+            if (start < r->dirty_start) r->dirty_start = start;
+            if (end > r->dirty_end) r->dirty_end = end;
+        }
+    }
+
+    return rc;
+}
+
+Result codecacheEndBatch(CodeCache* c)
+{
+    if (!c->batch_depth)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    Result rc = 0;
+
+    if (!--c->batch_depth) {
+        for (u32 i = 0; i < c->num_regions; i ++) {
+            CodeCacheRegion* r = &c->regions[i];
+            if (!r->dirty_end)
+                continue;
+
+            size_t size = r->dirty_end - r->dirty_start;
+            armDCacheFlush((u8*)jitGetRwAddr(&r->jit) + r->dirty_start, size);
+
+            Result rc2 = 0;
+            if (r->jit.type == JitType_SetProcessMemoryPermission)
+                rc2 = jitTransitionToExecutable(&r->jit);
+
+            if (R_SUCCEEDED(rc2)) {
+                armICacheInvalidate((u8*)jitGetRxAddr(&r->jit) + r->dirty_start, size);
+                r->dirty_start = 0;
+                r->dirty_end = 0;
+            }
+            else if (R_SUCCEEDED(rc))
+                rc = rc2;
+        }
+    }
+
+    rmutexUnlock(&c->mutex);
+    return rc;
+}
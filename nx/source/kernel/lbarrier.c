@@ -0,0 +1,21 @@
+#include "kernel/lbarrier.h"
+#include "arbiter.h"
+
+bool lbarrierWait(LBarrier* b) {
+    u32 generation = __atomic_load_n(&b->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == b->total) {
+        // Last thread to arrive: reset the barrier and release everyone from this generation.
+        // Threads can't arrive for the next generation until they observe the new generation value.
+        __atomic_store_n(&b->count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->generation, generation + 1, __ATOMIC_RELEASE);
+        if (b->total > 1)
+            _arbSignal(&b->generation, -1);
+        return true;
+    }
+
+    while (__atomic_load_n(&b->generation, __ATOMIC_ACQUIRE) == generation)
+        _arbWaitIfEqual(&b->generation, generation, UINT64_MAX);
+
+    return false;
+}
@@ -0,0 +1,28 @@
+#include "kernel/llatch.h"
+#include "arbiter.h"
+
+void llatchCountDown(LLatch* l, u32 n) {
+    if (__atomic_sub_fetch(&l->count, n, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&l->waiters, __ATOMIC_SEQ_CST))
+        _arbSignal(&l->count, -1);
+}
+
+bool llatchWait(LLatch* l, u64 timeout_ns) {
+    u32 val = __atomic_load_n(&l->count, __ATOMIC_ACQUIRE);
+    if (val == 0)
+        return true;
+
+    u64 deadline = _arbGetDeadline(timeout_ns);
+    bool success = true;
+
+    // See lsemaphoreWait for why registering as a waiter before re-checking the counter is race-free.
+    __atomic_fetch_add(&l->waiters, 1, __ATOMIC_SEQ_CST);
+    while ((val = __atomic_load_n(&l->count, __ATOMIC_SEQ_CST)) != 0) {
+        if (!_arbWaitIfEqual(&l->count, val, deadline)) {
+            success = __atomic_load_n(&l->count, __ATOMIC_ACQUIRE) == 0;
+            break;
+        }
+    }
+    __atomic_fetch_sub(&l->waiters, 1, __ATOMIC_RELAXED);
+
+    return success;
+}
@@ -0,0 +1,45 @@
+#include "kernel/lsemaphore.h"
+#include "arbiter.h"
+
+static bool _lsemaphoreTryDecrement(LSemaphore* s) {
+    s32 val = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+    while (val > 0) {
+        if (__atomic_compare_exchange_n(&s->count, &val, val - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+bool lsemaphoreWait(LSemaphore* s, u64 timeout_ns) {
+    // Fast path: a resource is available, no need to involve the kernel.
+    if (_lsemaphoreTryDecrement(s))
+        return true;
+
+    u64 deadline = _arbGetDeadline(timeout_ns);
+    bool success = false;
+
+    // Register ourselves as a waiter before checking the counter again, so that a concurrent
+    // signal either sees us (and wakes us up) or makes the counter non-zero before we sleep.
+    __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    for (;;) {
+        if (_lsemaphoreTryDecrement(s)) {
+            success = true;
+            break;
+        }
+        if (!_arbWaitIfEqual((u32*)&s->count, 0, deadline))
+            break;
+    }
+    __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_RELAXED);
+
+    return success;
+}
+
+bool lsemaphoreTryWait(LSemaphore* s) {
+    return _lsemaphoreTryDecrement(s);
+}
+
+void lsemaphoreSignal(LSemaphore* s) {
+    __atomic_fetch_add(&s->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->waiters, __ATOMIC_SEQ_CST))
+        _arbSignal((u32*)&s->count, 1);
+}
@@ -0,0 +1,96 @@
+#include <string.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/mpmcqueue.h"
+#include "queue.h"
+
+// Each cell holds a sequence number followed by the entry. A cell at position pos is free for
+// writing when its sequence number is pos, and holds a readable entry when it is pos+1.
+
+static bool _mpmcqueueBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick);
+
+static const WaitableMethods g_mpmcqueueVt = {
+    .beginWait = _mpmcqueueBeginWait,
+    .onTimeout = _queueOnTimeout,
+    .onSignal = _queueOnSignal,
+};
+
+static inline u32* _mpmcqueueGetCell(MpmcQueue* q, u32 pos)
+{
+    return (u32*)(q->buffer + (pos & q->mask) * q->cell_size);
+}
+
+static bool _mpmcqueueIsEmpty(Waitable* ww)
+{
+    MpmcQueue* q = (MpmcQueue*)ww;
+    u32 head = __atomic_load_n(&q->head, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(_mpmcqueueGetCell(q, head), __ATOMIC_SEQ_CST) != head + 1;
+}
+
+bool _mpmcqueueBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick)
+{
+    MpmcQueue* q = (MpmcQueue*)ww;
+    return _queueBeginWait(ww, &q->has_listeners, w, _mpmcqueueIsEmpty);
+}
+
+void mpmcqueueCreate(MpmcQueue* q, void* buffer, u32 elem_size, u32 capacity)
+{
+    _waitableInitialize(&q->waitable, &g_mpmcqueueVt);
+
+    q->has_listeners = false;
+    q->buffer = (u8*)buffer;
+    q->cell_size = mpmcqueueGetBufferSize(elem_size, 1);
+    q->elem_size = elem_size;
+    q->mask = capacity - 1;
+    q->head = 0;
+    q->tail = 0;
+
+    for (u32 i = 0; i < capacity; i ++)
+        *_mpmcqueueGetCell(q, i) = i;
+}
+
+bool mpmcqueuePush(MpmcQueue* q, const void* elem)
+{
+    u32 pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    u32* cell;
+
+    for (;;) {
+        cell = _mpmcqueueGetCell(q, pos);
+        s32 diff = (s32)(__atomic_load_n(cell, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0)
+            return false; // The cell still holds the entry from the previous lap: the queue is full.
+        else
+            pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    }
+
+    memcpy((u8*)cell + 8, elem, q->elem_size);
+    __atomic_store_n(cell, pos + 1, __ATOMIC_SEQ_CST);
+
+    _queueNotify(&q->waitable, &q->has_listeners);
+    return true;
+}
+
+bool mpmcqueuePop(MpmcQueue* q, void* elem)
+{
+    u32 pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    u32* cell;
+
+    for (;;) {
+        cell = _mpmcqueueGetCell(q, pos);
+        s32 diff = (s32)(__atomic_load_n(cell, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&q->head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0)
+            return false; // Empty.
+        else
+            pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+
+    memcpy(elem, (u8*)cell + 8, q->elem_size);
+    __atomic_store_n(cell, pos + q->mask + 1, __ATOMIC_RELEASE);
+    return true;
+}
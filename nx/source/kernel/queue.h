@@ -0,0 +1,43 @@
+#pragma once
+#include "wait.h"
+
+// Common Waitable logic for the lock-free queues, which are signalled while non-empty.
+// Producers only take the waitable mutex when has_listeners is set. The flag is set before checking
+// for entries in beginWait, so a concurrent push either sees it or is seen by the check.
+
+static inline bool _queueBeginWait(Waitable* ww, bool* has_listeners, WaiterNode* w, bool (* isEmpty)(Waitable*))
+{
+    mutexLock(&ww->mutex);
+
+    __atomic_store_n(has_listeners, true, __ATOMIC_SEQ_CST);
+    bool can_add = isEmpty(ww);
+    if (can_add)
+        _waiterNodeAdd(w);
+
+    mutexUnlock(&ww->mutex);
+    return can_add;
+}
+
+static inline void _queueNotify(Waitable* ww, bool* has_listeners)
+{
+    if (!__atomic_load_n(has_listeners, __ATOMIC_SEQ_CST))
+        return;
+
+    mutexLock(&ww->mutex);
+    if (ww->list.next != &ww->list)
+        _waitableSignalAllListeners(ww);
+    else // All the listeners are gone, go back to the fast path.
+        __atomic_store_n(has_listeners, false, __ATOMIC_RELAXED);
+    mutexUnlock(&ww->mutex);
+}
+
+static inline Result _queueOnSignal(Waitable* ww)
+{
+    return 0;
+}
+
+static inline Result _queueOnTimeout(Waitable* ww, u64 old_tick)
+{
+    // This is not supposed to happen.
+    return KERNELRESULT(Cancelled);
+}
@@ -3,17 +3,62 @@
 #include "kernel/rwlock.h"
 #include "../internal.h"
 
+// Layout of RwLock::state. Readers only touch the state word while no writer holds or
+// waits for the lock; the mutex/condvars are only used when a thread needs to block.
+#define RWLOCK_READERS_WAITING BIT(29) // Readers are blocked, waiting for the write lock to be released.
+#define RWLOCK_WRITE_PENDING   BIT(30) // Writers are blocked, new readers must wait (writer preference).
+#define RWLOCK_WRITE_LOCKED    BIT(31) // The write lock is held.
+#define RWLOCK_READER_MASK     (RWLOCK_READERS_WAITING-1) // Number of readers holding the lock.
+
 NX_INLINE u32 _GetCurrentThreadTag(void) {
     return getThreadVars()->handle;
 }
 
+NX_INLINE bool _rwlockCanRead(u32 state) {
+    return (state & (RWLOCK_WRITE_PENDING | RWLOCK_WRITE_LOCKED)) == 0;
+}
+
+NX_INLINE bool _rwlockCanWrite(u32 state) {
+    return (state & (RWLOCK_READER_MASK | RWLOCK_WRITE_LOCKED)) == 0;
+}
+
+static bool _rwlockTryAcquireRead(RwLock* r) {
+    u32 state = __atomic_load_n(&r->state, __ATOMIC_RELAXED);
+    while (_rwlockCanRead(state)) {
+        if (__atomic_compare_exchange_n(&r->state, &state, state + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+static void _rwlockWakeWaiters(RwLock* r, u32 state) {
+    // Called after the write lock was released, with the state prior to releasing.
+    if (state & RWLOCK_WRITE_PENDING) {
+        mutexLock(&r->mutex);
+        condvarWakeOne(&r->condvar_writer_wait);
+        mutexUnlock(&r->mutex);
+    } else if (state & RWLOCK_READERS_WAITING) {
+        mutexLock(&r->mutex);
+        __atomic_fetch_and(&r->state, ~RWLOCK_READERS_WAITING, __ATOMIC_RELAXED);
+        condvarWakeAll(&r->condvar_reader_wait);
+        mutexUnlock(&r->mutex);
+    }
+}
+
+static void _rwlockReleaseWrite(RwLock* r) {
+    // Relinquish control of the lock.
+    r->write_owner_tag = 0;
+    u32 state = __atomic_fetch_and(&r->state, ~RWLOCK_WRITE_LOCKED, __ATOMIC_ACQ_REL);
+    _rwlockWakeWaiters(r, state);
+}
+
 void rwlockInit(RwLock* r) {
     mutexInit(&r->mutex);
     condvarInit(&r->condvar_reader_wait);
     condvarInit(&r->condvar_writer_wait);
 
+    r->state = 0;
     r->read_lock_count = 0;
-    r->read_waiter_count = 0;
     r->write_lock_count = 0;
     r->write_waiter_count = 0;
     r->write_owner_tag = 0;
@@ -27,16 +72,21 @@ void rwlockReadLock(RwLock* r) {
         return;
     }
 
+    if (_rwlockTryAcquireRead(r)) {
+        return;
+    }
+
     mutexLock(&r->mutex);
 
-    while (r->write_waiter_count > 0) {
-        r->read_waiter_count++;
-        condvarWait(&r->condvar_reader_wait, &r->mutex);
-        r->read_waiter_count--;
+    while (!_rwlockTryAcquireRead(r)) {
+        // Flag ourselves before re-checking, so that a concurrent writer release either sees
+        // the flag and wakes us up, or happens before the re-check.
+        u32 state = __atomic_or_fetch(&r->state, RWLOCK_READERS_WAITING, __ATOMIC_ACQ_REL);
+        if (!_rwlockCanRead(state)) {
+            condvarWait(&r->condvar_reader_wait, &r->mutex);
+        }
     }
 
-    r->read_lock_count++;
-
     mutexUnlock(&r->mutex);
 }
 
@@ -48,17 +98,7 @@ bool rwlockTryReadLock(RwLock* r) {
         return true;
     }
 
-    if (!mutexTryLock(&r->mutex)) {
-        return false;
-    }
-
-    const bool got_lock = r->write_waiter_count == 0;
-    if (got_lock) {
-        r->read_lock_count++;
-    }
-
-    mutexUnlock(&r->mutex);
-    return got_lock;
+    return _rwlockTryAcquireRead(r);
 }
 
 void rwlockReadUnlock(RwLock* r) {
@@ -68,26 +108,17 @@ void rwlockReadUnlock(RwLock* r) {
         // Write lock is owned by this thread.
         r->read_lock_count--;
         if (r->read_lock_count == 0 && r->write_lock_count == 0) {
-            // Relinquish control of the lock.
-            r->write_owner_tag = 0;
-
-            if (r->write_waiter_count > 0) {
-                condvarWakeOne(&r->condvar_writer_wait);
-            } else if (r->read_waiter_count > 0) {
-                condvarWakeAll(&r->condvar_reader_wait);
-            }
-
-            // Corresponding mutexLock was called in WriteLock/WriteTryLock.
-            mutexUnlock(&r->mutex);
+            _rwlockReleaseWrite(r);
         }
     } else {
         // Write lock isn't owned by this thread.
-        mutexLock(&r->mutex);
-        r->read_lock_count--;
-        if (r->read_lock_count == 0 && r->write_waiter_count > 0) {
+        u32 state = __atomic_sub_fetch(&r->state, 1, __ATOMIC_ACQ_REL);
+        if ((state & RWLOCK_READER_MASK) == 0 && (state & RWLOCK_WRITE_PENDING)) {
+            // We were the last reader, and a writer is waiting for us.
+            mutexLock(&r->mutex);
             condvarWakeOne(&r->condvar_writer_wait);
+            mutexUnlock(&r->mutex);
         }
-        mutexUnlock(&r->mutex);
     }
 }
 
@@ -99,19 +130,32 @@ void rwlockWriteLock(RwLock* r) {
         return;
     }
 
-    mutexLock(&r->mutex);
+    if (!rwlockTryWriteLock(r)) {
+        mutexLock(&r->mutex);
 
-    while (r->read_lock_count > 0) {
         r->write_waiter_count++;
-        condvarWait(&r->condvar_writer_wait, &r->mutex);
+        u32 state = __atomic_or_fetch(&r->state, RWLOCK_WRITE_PENDING, __ATOMIC_ACQ_REL);
+        for (;;) {
+            if (_rwlockCanWrite(state)) {
+                // Keep new readers out as long as other writers are still queued.
+                u32 new_state = state | RWLOCK_WRITE_LOCKED;
+                if (r->write_waiter_count == 1)
+                    new_state &= ~RWLOCK_WRITE_PENDING;
+                if (__atomic_compare_exchange_n(&r->state, &state, new_state, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                    break;
+                continue;
+            }
+
+            condvarWait(&r->condvar_writer_wait, &r->mutex);
+            state = __atomic_load_n(&r->state, __ATOMIC_RELAXED);
+        }
         r->write_waiter_count--;
+
+        mutexUnlock(&r->mutex);
     }
 
     r->write_lock_count = 1;
     r->write_owner_tag = cur_tag;
-
-    // mutexUnlock(&r->mutex) is intentionally not called here.
-    // The mutex will be unlocked by a call to ReadUnlock or WriteUnlock.
 }
 
 bool rwlockTryWriteLock(RwLock* r) {
@@ -122,42 +166,24 @@ bool rwlockTryWriteLock(RwLock* r) {
         return true;
     }
 
-    if (!mutexTryLock(&r->mutex)) {
-        return false;
-    }
-
-    if (r->read_lock_count > 0) {
-        mutexUnlock(&r->mutex);
-        return false;
+    // Stale READERS_WAITING flags don't prevent acquiring the lock, they are dealt with on release.
+    u32 state = __atomic_load_n(&r->state, __ATOMIC_RELAXED);
+    while ((state &~ RWLOCK_READERS_WAITING) == 0) {
+        if (__atomic_compare_exchange_n(&r->state, &state, state | RWLOCK_WRITE_LOCKED, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            r->write_lock_count = 1;
+            r->write_owner_tag = cur_tag;
+            return true;
+        }
     }
 
-    r->write_lock_count = 1;
-    r->write_owner_tag = cur_tag;
-
-    // mutexUnlock(&r->mutex) is intentionally not called here.
-    // The mutex will be unlocked by a call to ReadUnlock or WriteUnlock.
-    return true;
+    return false;
 }
 
 void rwlockWriteUnlock(RwLock* r) {
-    // This function assumes the write lock is held.
-    // This means that r->mutex is locked, and r->write_owner_tag == cur_tag.
-    // if (r->write_owner_tag == cur_tag)
-    {
-        r->write_lock_count--;
-        if (r->write_lock_count == 0 && r->read_lock_count == 0) {
-            // Relinquish control of the lock.
-            r->write_owner_tag = 0;
-
-            if (r->write_waiter_count > 0) {
-                condvarWakeOne(&r->condvar_writer_wait);
-            } else if (r->read_waiter_count > 0) {
-                condvarWakeAll(&r->condvar_reader_wait);
-            }
-
-            // Corresponding mutexLock was called in WriteLock/WriteTryLock.
-            mutexUnlock(&r->mutex);
-        }
+    // This function assumes the write lock is held, i.e. r->write_owner_tag == cur_tag.
+    r->write_lock_count--;
+    if (r->write_lock_count == 0 && r->read_lock_count == 0) {
+        _rwlockReleaseWrite(r);
     }
 }
 
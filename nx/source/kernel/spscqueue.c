@@ -0,0 +1,61 @@
+#include <string.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "kernel/spscqueue.h"
+#include "queue.h"
+
+static bool _spscqueueBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick);
+
+static const WaitableMethods g_spscqueueVt = {
+    .beginWait = _spscqueueBeginWait,
+    .onTimeout = _queueOnTimeout,
+    .onSignal = _queueOnSignal,
+};
+
+static bool _spscqueueIsEmpty(Waitable* ww)
+{
+    SpscQueue* q = (SpscQueue*)ww;
+    return __atomic_load_n(&q->tail, __ATOMIC_SEQ_CST) == __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+}
+
+bool _spscqueueBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick)
+{
+    SpscQueue* q = (SpscQueue*)ww;
+    return _queueBeginWait(ww, &q->has_listeners, w, _spscqueueIsEmpty);
+}
+
+void spscqueueCreate(SpscQueue* q, void* buffer, u32 elem_size, u32 capacity)
+{
+    _waitableInitialize(&q->waitable, &g_spscqueueVt);
+
+    q->has_listeners = false;
+    q->buffer = (u8*)buffer;
+    q->elem_size = elem_size;
+    q->mask = capacity - 1;
+    q->head = 0;
+    q->tail = 0;
+}
+
+bool spscqueuePush(SpscQueue* q, const void* elem)
+{
+    u32 tail = q->tail;
+    if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) > q->mask)
+        return false;
+
+    memcpy(q->buffer + (tail & q->mask) * q->elem_size, elem, q->elem_size);
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    _queueNotify(&q->waitable, &q->has_listeners);
+    return true;
+}
+
+bool spscqueuePop(SpscQueue* q, void* elem)
+{
+    u32 head = q->head;
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    memcpy(elem, q->buffer + (head & q->mask) * q->elem_size, q->elem_size);
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
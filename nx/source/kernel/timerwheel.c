@@ -0,0 +1,275 @@
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/timerwheel.h"
+#include "wait.h"
+
+// Timers are placed in the lowest level whose slots can tell their expiration apart from the current time:
+// level N slots each cover 64^N units. When the current time reaches the start of a higher level slot, its
+// timers are cascaded down; timers in the current level 0 slot are due.
+
+#define TIMERWHEEL_SLOT_MASK (TIMERWHEEL_SLOTS - 1)
+
+static bool _timerwheelBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick);
+static Result _timerwheelOnTimeout(Waitable* ww, u64 old_tick);
+static Result _timerwheelOnSignal(Waitable* ww);
+
+static const WaitableMethods g_timerwheelVt = {
+    .beginWait = _timerwheelBeginWait,
+    .onTimeout = _timerwheelOnTimeout,
+    .onSignal = _timerwheelOnSignal,
+};
+
+static inline void _timerwheelListInit(TimerWheelNode* head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+static inline void _timerwheelListAppend(TimerWheelNode* head, TimerWheelNode* node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void _timerwheelRemove(TimerWheel* tw, TimerWheelEntry* e)
+{
+    TimerWheelNode* prev = e->node.prev;
+    TimerWheelNode* next = e->node.next;
+    prev->next = next;
+    next->prev = prev;
+
+    // If the list became empty, prev is its head: clear the corresponding occupancy bit.
+    TimerWheelNode* first_slot = &tw->slots[0][0];
+    if (prev == next && prev >= first_slot && prev < first_slot + TIMERWHEEL_LEVELS*TIMERWHEEL_SLOTS) {
+        u32 idx = prev - first_slot;
+        tw->occupied[idx / TIMERWHEEL_SLOTS] &= ~(1ULL << (idx % TIMERWHEEL_SLOTS));
+    }
+}
+
+static void _timerwheelInsert(TimerWheel* tw, TimerWheelEntry* e)
+{
+    u64 expires = e->expires > tw->current ? e->expires : tw->current;
+    u32 level, slot = 0;
+
+    for (level = 0; level < TIMERWHEEL_LEVELS; level ++) {
+        u32 shift = level * TIMERWHEEL_SLOT_BITS;
+        if ((expires >> shift) - (tw->current >> shift) < TIMERWHEEL_SLOTS) {
+            slot = (expires >> shift) & TIMERWHEEL_SLOT_MASK;
+            break;
+        }
+    }
+
+    if (level == TIMERWHEEL_LEVELS) {
+        // Too far in the future: park the timer in the furthest slot, it gets re-queued once it's reached.
+        level = TIMERWHEEL_LEVELS - 1;
+        slot = ((tw->current >> (level * TIMERWHEEL_SLOT_BITS)) + TIMERWHEEL_SLOTS - 1) & TIMERWHEEL_SLOT_MASK;
+    }
+
+    _timerwheelListAppend(&tw->slots[level][slot], &e->node);
+    tw->occupied[level] |= 1ULL << slot;
+}
+
+// Returns the next time (in wheel units) at which a slot is due or needs to be cascaded.
+static u64 _timerwheelNextSlotEvent(TimerWheel* tw)
+{
+    u64 next = UINT64_MAX;
+    for (u32 level = 0; level < TIMERWHEEL_LEVELS; level ++) {
+        u64 bits = tw->occupied[level];
+        if (!bits)
+            continue;
+
+        u32 shift = level * TIMERWHEEL_SLOT_BITS;
+        u64 base = tw->current >> shift;
+
+        // The current slot is due at level 0, and has already been cascaded at higher levels.
+        u32 first = level ? 1 : 0;
+        u32 start = (base + first) & TIMERWHEEL_SLOT_MASK;
+        u64 rotated = start ? (bits >> start) | (bits << (TIMERWHEEL_SLOTS - start)) : bits;
+
+        u64 t = (base + first + __builtin_ctzll(rotated)) << shift;
+        if (t < next)
+            next = t;
+    }
+
+    return next;
+}
+
+// Returns the next time (in wheel units) at which the wheel needs to be processed.
+static u64 _timerwheelNextEvent(TimerWheel* tw)
+{
+    if (tw->expired.next != &tw->expired)
+        return tw->current;
+    return _timerwheelNextSlotEvent(tw);
+}
+
+static void _timerwheelAdvance(TimerWheel* tw, u64 now)
+{
+    u64 t;
+    while ((t = _timerwheelNextSlotEvent(tw)) <= now) {
+        tw->current = t;
+
+        // Cascade the slots starting at this time, from the top down.
+        for (u32 level = TIMERWHEEL_LEVELS - 1; level > 0; level --) {
+            u32 shift = level * TIMERWHEEL_SLOT_BITS;
+            u32 slot = (t >> shift) & TIMERWHEEL_SLOT_MASK;
+            if ((t & ((1ULL << shift) - 1)) || !(tw->occupied[level] & (1ULL << slot)))
+                continue;
+
+            TimerWheelNode list;
+            TimerWheelNode* head = &tw->slots[level][slot];
+            list.next = head->next;
+            list.prev = head->prev;
+            list.next->prev = &list;
+            list.prev->next = &list;
+            _timerwheelListInit(head);
+            tw->occupied[level] &= ~(1ULL << slot);
+
+            while (list.next != &list) {
+                TimerWheelEntry* e = (TimerWheelEntry*)list.next;
+                list.next = e->node.next;
+                _timerwheelInsert(tw, e);
+            }
+        }
+
+        // Everything in the current level 0 slot is due.
+        u32 slot = t & TIMERWHEEL_SLOT_MASK;
+        if (tw->occupied[0] & (1ULL << slot)) {
+            TimerWheelNode* head = &tw->slots[0][slot];
+            while (head->next != head) {
+                TimerWheelEntry* e = (TimerWheelEntry*)head->next;
+                _timerwheelRemove(tw, e);
+                _timerwheelListAppend(&tw->expired, &e->node);
+            }
+        }
+    }
+
+    if (tw->current < now)
+        tw->current = now;
+}
+
+void timerwheelCreate(TimerWheel* tw, u64 granularity)
+{
+    _waitableInitialize(&tw->waitable, &g_timerwheelVt);
+
+    tw->granularity = armNsToTicks(granularity);
+    if (!tw->granularity)
+        tw->granularity = 1;
+    tw->current = armGetSystemTick() / tw->granularity;
+
+    for (u32 level = 0; level < TIMERWHEEL_LEVELS; level ++) {
+        tw->occupied[level] = 0;
+        for (u32 slot = 0; slot < TIMERWHEEL_SLOTS; slot ++)
+            _timerwheelListInit(&tw->slots[level][slot]);
+    }
+    _timerwheelListInit(&tw->expired);
+}
+
+void timerwheelEntryInit(TimerWheelEntry* e, TimerWheelCallback callback, void* arg)
+{
+    e->node.prev = NULL;
+    e->node.next = NULL;
+    e->callback = callback;
+    e->arg = arg;
+    e->expires = 0;
+    e->period = 0;
+    e->pending = false;
+}
+
+void timerwheelStart(TimerWheel* tw, TimerWheelEntry* e, u64 timeout, u64 period)
+{
+    u64 cur_tick = armGetSystemTick();
+    mutexLock(&tw->waitable.mutex);
+
+    if (e->pending)
+        _timerwheelRemove(tw, e);
+
+    // Round up, timers must never fire early.
+    e->expires = (cur_tick + armNsToTicks(timeout) + tw->granularity - 1) / tw->granularity;
+    e->period = period ? (armNsToTicks(period) + tw->granularity - 1) / tw->granularity : 0;
+    e->pending = true;
+
+    // Waiting threads need to recompute their timeout if this timer is now the earliest one.
+    u64 prev_next = _timerwheelNextEvent(tw);
+    _timerwheelInsert(tw, e);
+    if (e->expires < prev_next)
+        _waitableSignalAllListeners(&tw->waitable);
+
+    mutexUnlock(&tw->waitable.mutex);
+}
+
+void timerwheelCancel(TimerWheel* tw, TimerWheelEntry* e)
+{
+    mutexLock(&tw->waitable.mutex);
+
+    if (e->pending) {
+        _timerwheelRemove(tw, e);
+        e->pending = false;
+    }
+
+    mutexUnlock(&tw->waitable.mutex);
+}
+
+u32 timerwheelProcess(TimerWheel* tw)
+{
+    u32 count = 0;
+    mutexLock(&tw->waitable.mutex);
+
+    _timerwheelAdvance(tw, armGetSystemTick() / tw->granularity);
+
+    while (tw->expired.next != &tw->expired) {
+        TimerWheelEntry* e = (TimerWheelEntry*)tw->expired.next;
+        _timerwheelRemove(tw, e);
+        e->pending = false;
+
+        if (e->period) {
+            // Skip the periods that were missed.
+            u64 missed = tw->current > e->expires ? (tw->current - e->expires) / e->period : 0;
+            e->expires += (missed + 1) * e->period;
+            e->pending = true;
+            _timerwheelInsert(tw, e);
+        }
+
+        // Run the callback unlocked, so that it can start or cancel timers.
+        mutexUnlock(&tw->waitable.mutex);
+        e->callback(e, e->arg);
+        count++;
+        mutexLock(&tw->waitable.mutex);
+    }
+
+    mutexUnlock(&tw->waitable.mutex);
+    return count;
+}
+
+static bool _timerwheelBeginWait(Waitable* ww, WaiterNode* w, u64 cur_tick, u64* next_tick)
+{
+    TimerWheel* tw = (TimerWheel*)ww;
+    mutexLock(&tw->waitable.mutex);
+
+    u64 next = _timerwheelNextEvent(tw);
+    u64 now = cur_tick / tw->granularity;
+    bool do_wait = next > now;
+
+    if (do_wait) {
+        _waiterNodeAdd(w);
+        if (next != UINT64_MAX)
+            *next_tick = next * tw->granularity - cur_tick;
+    }
+
+    mutexUnlock(&tw->waitable.mutex);
+    return do_wait;
+}
+
+static Result _timerwheelOnTimeout(Waitable* ww, u64 old_tick)
+{
+    // Timers are due, the caller needs to run timerwheelProcess.
+    return 0;
+}
+
+static Result _timerwheelOnSignal(Waitable* ww)
+{
+    // A new earliest timer was started, so we need to retry the wait.
+    return KERNELRESULT(Cancelled);
+}
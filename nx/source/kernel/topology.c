@@ -0,0 +1,133 @@
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/topology.h"
+#include "runtime/env.h"
+
+#define TOPOLOGY_MIGRATION_ATTEMPTS 8
+
+Result topologyGetInfo(TopologyInfo* out)
+{
+    Result rc = svcGetInfo(&out->core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+    if (R_SUCCEEDED(rc))
+        rc = svcGetInfo(&out->priority_mask, InfoType_PriorityMask, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    out->core_mask &= (1ULL << TOPOLOGY_MAX_CORES) - 1;
+    out->num_cores = __builtin_popcountll(out->core_mask);
+    out->highest_priority = out->priority_mask ? __builtin_ctzll(out->priority_mask) : -1;
+    out->lowest_priority = out->priority_mask ? 63 - __builtin_clzll(out->priority_mask) : -1;
+
+    u64 affinity_mask;
+    rc = svcGetThreadCoreMask(&out->default_core, &affinity_mask, envGetMainThreadHandle());
+    if (R_FAILED(rc) || out->default_core < 0)
+        out->default_core = out->core_mask ? __builtin_ctzll(out->core_mask) : 0;
+
+    return 0;
+}
+
+static Result _topologyMoveToCore(u32 core)
+{
+    Result rc = svcSetThreadCoreMask(CUR_THREAD_HANDLE, core, 1ULL << core);
+    if (R_FAILED(rc))
+        return rc;
+
+    // The migration is normally done by the time the syscall returns, but make sure of it.
+    for (u32 i = 0; i < TOPOLOGY_MIGRATION_ATTEMPTS && svcGetCurrentProcessorNumber() != core; i ++)
+        svcSleepThread(YieldType_WithCoreMigration);
+
+    return svcGetCurrentProcessorNumber() == core ? 0 : MAKERESULT(Module_Libnx, LibnxError_IoError);
+}
+
+static Result _topologySampleCores(u64 core_mask, u64* out)
+{
+    s32 orig_core;
+    u64 orig_mask;
+    Result rc = svcGetThreadCoreMask(&orig_core, &orig_mask, CUR_THREAD_HANDLE);
+    if (R_FAILED(rc))
+        return rc;
+
+    for (u32 core = 0; core < TOPOLOGY_MAX_CORES && R_SUCCEEDED(rc); core ++) {
+        if (!(core_mask & (1ULL << core)))
+            continue;
+
+        rc = _topologyMoveToCore(core);
+        if (R_SUCCEEDED(rc))
+            rc = svcGetInfo(&out[core], InfoType_IdleTickCount, INVALID_HANDLE, core);
+    }
+
+    Result rc2 = svcSetThreadCoreMask(CUR_THREAD_HANDLE, orig_core, orig_mask);
+    return R_SUCCEEDED(rc) ? rc2 : rc;
+}
+
+Result topologyGetIdleTickCount(u32 core, u64* out)
+{
+    if (core >= TOPOLOGY_MAX_CORES)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u64 ticks[TOPOLOGY_MAX_CORES];
+    Result rc = _topologySampleCores(1ULL << core, ticks);
+    if (R_SUCCEEDED(rc))
+        *out = ticks[core];
+    return rc;
+}
+
+Result topologySampleLoad(TopologyLoadSample* out)
+{
+    u64 core_mask;
+    Result rc = svcGetInfo(&core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    out->core_mask = core_mask & ((1ULL << TOPOLOGY_MAX_CORES) - 1);
+    rc = _topologySampleCores(out->core_mask, out->idle_ticks);
+    out->tick = armGetSystemTick();
+    return rc;
+}
+
+float topologyGetCoreLoad(const TopologyLoadSample* prev, const TopologyLoadSample* cur, u32 core)
+{
+    if (core >= TOPOLOGY_MAX_CORES || !(prev->core_mask & cur->core_mask & (1ULL << core)))
+        return -1.0f;
+
+    u64 elapsed = cur->tick - prev->tick;
+    u64 idle = cur->idle_ticks[core] - prev->idle_ticks[core];
+    if (!elapsed)
+        return 0.0f;
+    if (idle > elapsed)
+        idle = elapsed;
+
+    return 1.0f - (float)idle / (float)elapsed;
+}
+
+Result topologyPinThreads(Thread* threads, u32 count, u64 core_mask)
+{
+    TopologyInfo info;
+    Result rc = topologyGetInfo(&info);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (core_mask)
+        core_mask &= info.core_mask;
+    else
+        core_mask = info.core_mask;
+    if (!core_mask)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    // Order the cores so that the main thread's core comes last.
+    u32 cores[TOPOLOGY_MAX_CORES];
+    u32 num_cores = 0;
+    for (u32 core = 0; core < TOPOLOGY_MAX_CORES; core ++)
+        if ((core_mask & (1ULL << core)) && core != info.default_core)
+            cores[num_cores++] = core;
+    if (core_mask & (1ULL << info.default_core))
+        cores[num_cores++] = info.default_core;
+
+    for (u32 i = 0; i < count && R_SUCCEEDED(rc); i ++) {
+        u32 core = cores[i % num_cores];
+        rc = svcSetThreadCoreMask(threads[i].handle, core, 1ULL << core);
+    }
+
+    return rc;
+}
@@ -3,6 +3,7 @@
 #include "kernel/svc.h"
 #include "kernel/mutex.h"
 #include "kernel/wait.h"
+#include "kernel/waitset.h"
 
 typedef struct WaiterNode WaiterNode;
 
@@ -11,6 +12,7 @@ struct WaiterNode {
     Waitable* parent;
     Handle thread;
     s32* idx_out;
+    WaitSet* wait_set; // Used instead of idx_out by persistent waiters (see waitset.c).
     s32 idx;
 };
 
@@ -28,6 +30,19 @@ static inline void _waitableInitialize(Waitable* ww, const WaitableMethods* vt)
     ww->list.prev = &ww->list;
 }
 
+// Flags a wait set entry as signalled, and wakes up the owner if it's blocked in waitsetWait.
+static inline void _waitsetNotifyOwner(WaitSet* ws, s32 id)
+{
+    __atomic_fetch_or(&ws->ready[id / 64], 1ULL << (id % 64), __ATOMIC_SEQ_CST);
+
+    mutexLock(&ws->mutex);
+    if (ws->owner_waiting) {
+        ws->owner_waiting = false;
+        svcCancelSynchronization(ws->owner);
+    }
+    mutexUnlock(&ws->mutex);
+}
+
 static inline void _waitableSignalAllListeners(Waitable* ww)
 {
     WaitableNode* node = &ww->list;
@@ -37,6 +52,12 @@ static inline void _waitableSignalAllListeners(Waitable* ww)
         node = node->next;
         WaiterNode* w = (WaiterNode*) node;
 
+        // Persistent waiters collect every signalled object, so just flag ours.
+        if (w->wait_set) {
+            _waitsetNotifyOwner(w->wait_set, w->idx);
+            continue;
+        }
+
         // Try to swap -1 => idx on the waiter thread.
         // If another waitable signals simultaneously only one will win the race and insert its own idx.
         s32 minus_one = -1;
@@ -57,14 +78,16 @@ static inline void _waiterNodeInitialize(
     w->thread = thread;
     w->idx = idx;
     w->idx_out = idx_out;
+    w->wait_set = NULL;
 }
 
 static inline void _waiterNodeAdd(WaiterNode* w)
 {
     // Add WaiterNode to the parent's linked list
     w->node.next = w->parent->list.next;
-    w->parent->list.next = &w->node;
     w->node.prev = &w->parent->list;
+    w->node.next->prev = &w->node;
+    w->parent->list.next = &w->node;
 }
 
 static inline void _waiterNodeRemove(WaiterNode* w)
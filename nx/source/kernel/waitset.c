@@ -0,0 +1,451 @@
+#include <string.h>
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/waitset.h"
+#include "wait.h"
+#include "../internal.h"
+#include "../runtime/alloc.h"
+
+#define WAITSET_HELPER_STACK_SIZE 0x2000
+
+struct WaitSetEntry {
+    WaiterNode node;
+    Waiter waiter;
+    u64 deadline;   // Absolute timeout tick requested by the waitable, or UINT64_MAX.
+    u32 tier;
+    bool in_use;
+    bool armed;     // The waiter node is in the waitable's listener list.
+    bool rearm;     // The entry is in the rearm list.
+};
+
+static inline bool _waitsetIsHandle(const WaitSetEntry* e)
+{
+    return e->waiter.type != WaiterType_Waitable;
+}
+
+static inline bool _waitsetIsReady(WaitSet* ws, s32 id)
+{
+    return __atomic_load_n(&ws->ready[id / 64], __ATOMIC_ACQUIRE) & (1ULL << (id % 64));
+}
+
+static inline void _waitsetClearReady(WaitSet* ws, s32 id)
+{
+    __atomic_fetch_and(&ws->ready[id / 64], ~(1ULL << (id % 64)), __ATOMIC_SEQ_CST);
+}
+
+static void _waitsetHelperThreadFunc(void* arg)
+{
+    WaitSetTier* tier = (WaitSetTier*)arg;
+    WaitSet* ws = tier->ws;
+    Handle handles[MAX_WAIT_OBJECTS];
+    s32 ids[MAX_WAIT_OBJECTS];
+
+    while (!__atomic_load_n(&ws->exiting, __ATOMIC_ACQUIRE)) {
+        // Wait on every handle which hasn't been reported to the owner yet.
+        // The owner cancels our wait whenever this set changes.
+        s32 count = 0;
+        mutexLock(&ws->mutex);
+        for (u32 i = 0; i < tier->count; i ++) {
+            if (!_waitsetIsReady(ws, tier->ids[i])) {
+                handles[count] = tier->handles[i];
+                ids[count++] = tier->ids[i];
+            }
+        }
+        mutexUnlock(&ws->mutex);
+
+        s32 idx;
+        Result rc = svcWaitSynchronization(&idx, handles, count, UINT64_MAX);
+        if (R_SUCCEEDED(rc))
+            _waitsetNotifyOwner(ws, ids[idx]);
+    }
+}
+
+static void _waitsetCancelHelper(WaitSet* ws, u32 tier_id)
+{
+    WaitSetTier* tier = &ws->tiers[tier_id];
+    tier->needs_cancel = false;
+    if (tier->started)
+        svcCancelSynchronization(tier->thread.handle);
+}
+
+static Result _waitsetStartHelper(WaitSet* ws, u32 tier_id)
+{
+    WaitSetTier* tier = &ws->tiers[tier_id];
+    s32 prio = 0x2C;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+    Result rc = threadCreate(&tier->thread, _waitsetHelperThreadFunc, tier, NULL, WAITSET_HELPER_STACK_SIZE, prio, -2);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&tier->thread);
+        if (R_FAILED(rc))
+            threadClose(&tier->thread);
+    }
+
+    if (R_SUCCEEDED(rc))
+        tier->started = true;
+    return rc;
+}
+
+static void _waitsetTierRemove(WaitSet* ws, WaitSetTier* tier, s32 id)
+{
+    for (u32 i = 0; i < tier->count; i ++) {
+        if (tier->ids[i] == id) {
+            tier->count--;
+            tier->ids[i] = tier->ids[tier->count];
+            tier->handles[i] = tier->handles[tier->count];
+            break;
+        }
+    }
+}
+
+static void _waitsetDisarm(WaitSet* ws, WaitSetEntry* e)
+{
+    if (e->armed) {
+        _waiterNodeRemove(&e->node);
+        e->armed = false;
+    }
+    if (e->deadline != UINT64_MAX) {
+        e->deadline = UINT64_MAX;
+        ws->num_timed--;
+    }
+}
+
+static void _waitsetQueueRearm(WaitSet* ws, s32 id)
+{
+    WaitSetEntry* e = &ws->entries[id];
+    _waitsetDisarm(ws, e);
+    if (!e->rearm) {
+        e->rearm = true;
+        ws->rearm_list[ws->rearm_count++] = id;
+    }
+}
+
+Result waitsetCreate(WaitSet* ws, u32 capacity)
+{
+    memset(ws, 0, sizeof(*ws));
+    if (!capacity)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexInit(&ws->mutex);
+    ws->owner = getThreadVars()->handle;
+    ws->capacity = capacity;
+    ws->num_tiers = (capacity + MAX_WAIT_OBJECTS - 1) / MAX_WAIT_OBJECTS;
+
+    ws->entries = (WaitSetEntry*)__libnx_alloc(sizeof(WaitSetEntry) * capacity);
+    ws->tiers = (WaitSetTier*)__libnx_alloc(sizeof(WaitSetTier) * ws->num_tiers);
+    ws->ready = (u64*)__libnx_alloc(sizeof(u64) * ((capacity + 63) / 64));
+    ws->rearm_list = (s32*)__libnx_alloc(sizeof(s32) * capacity);
+    if (!ws->entries || !ws->tiers || !ws->ready || !ws->rearm_list) {
+        waitsetClose(ws);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    memset(ws->entries, 0, sizeof(WaitSetEntry) * capacity);
+    memset(ws->tiers, 0, sizeof(WaitSetTier) * ws->num_tiers);
+    memset(ws->ready, 0, sizeof(u64) * ((capacity + 63) / 64));
+    for (u32 i = 0; i < ws->num_tiers; i ++)
+        ws->tiers[i].ws = ws;
+
+    return 0;
+}
+
+void waitsetClose(WaitSet* ws)
+{
+    if (ws->entries) {
+        for (u32 i = 0; i < ws->capacity; i ++)
+            if (ws->entries[i].in_use && ws->entries[i].armed)
+                _waiterNodeRemove(&ws->entries[i].node);
+    }
+
+    if (ws->tiers) {
+        __atomic_store_n(&ws->exiting, true, __ATOMIC_RELEASE);
+        for (u32 i = 0; i < ws->num_tiers; i ++) {
+            WaitSetTier* tier = &ws->tiers[i];
+            if (!tier->started)
+                continue;
+            svcCancelSynchronization(tier->thread.handle);
+            threadWaitForExit(&tier->thread);
+            threadClose(&tier->thread);
+        }
+    }
+
+    __libnx_free(ws->entries);
+    __libnx_free(ws->tiers);
+    __libnx_free(ws->ready);
+    __libnx_free(ws->rearm_list);
+    memset(ws, 0, sizeof(*ws));
+}
+
+Result waitsetAdd(WaitSet* ws, Waiter w, s32* out_id)
+{
+    s32 id;
+    for (id = 0; id < ws->capacity && ws->entries[id].in_use; id ++);
+    if (id == ws->capacity)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    WaitSetEntry* e = &ws->entries[id];
+    memset(e, 0, sizeof(*e));
+    e->waiter = w;
+    e->deadline = UINT64_MAX;
+    _waitsetClearReady(ws, id);
+
+    if (_waitsetIsHandle(e)) {
+        u32 tier_id;
+        for (tier_id = 0; tier_id < ws->num_tiers && ws->tiers[tier_id].count == MAX_WAIT_OBJECTS; tier_id ++);
+        WaitSetTier* tier = &ws->tiers[tier_id];
+
+        if (tier_id != 0 && !tier->started) {
+            Result rc = _waitsetStartHelper(ws, tier_id);
+            if (R_FAILED(rc))
+                return rc;
+        }
+
+        mutexLock(&ws->mutex);
+        tier->ids[tier->count] = id;
+        tier->handles[tier->count] = w.handle;
+        tier->count++;
+        mutexUnlock(&ws->mutex);
+
+        e->tier = tier_id;
+        if (tier_id != 0)
+            _waitsetCancelHelper(ws, tier_id);
+    } else {
+        // Waitables get registered by the next call to waitsetWait.
+        e->rearm = true;
+        ws->rearm_list[ws->rearm_count++] = id;
+    }
+
+    e->in_use = true;
+    *out_id = id;
+    return 0;
+}
+
+void waitsetRemove(WaitSet* ws, s32 id)
+{
+    WaitSetEntry* e = &ws->entries[id];
+    if (!e->in_use)
+        return;
+
+    if (_waitsetIsHandle(e)) {
+        mutexLock(&ws->mutex);
+        _waitsetTierRemove(ws, &ws->tiers[e->tier], id);
+        mutexUnlock(&ws->mutex);
+        if (e->tier != 0)
+            _waitsetCancelHelper(ws, e->tier);
+    } else {
+        _waitsetDisarm(ws, e);
+        if (e->rearm) {
+            for (u32 i = 0; i < ws->rearm_count; i ++) {
+                if (ws->rearm_list[i] == id) {
+                    ws->rearm_list[i] = ws->rearm_list[--ws->rearm_count];
+                    break;
+                }
+            }
+        }
+    }
+
+    _waitsetClearReady(ws, id);
+    e->in_use = false;
+}
+
+// Registers the waitables which were reported (or added) since the last wait.
+static void _waitsetRearm(WaitSet* ws, u64 cur_tick, s32* out_ids, s32 max_ids, s32* count)
+{
+    u32 i = 0;
+    while (i < ws->rearm_count && *count < max_ids) {
+        s32 id = ws->rearm_list[i];
+        WaitSetEntry* e = &ws->entries[id];
+        Waitable* ww = e->waiter.waitable;
+
+        _waiterNodeInitialize(&e->node, ww, ws->owner, id, NULL);
+        e->node.wait_set = ws;
+
+        u64 next_tick = UINT64_MAX;
+        if (ww->vt->beginWait(ww, &e->node, cur_tick, &next_tick)) {
+            e->armed = true;
+            if (next_tick != UINT64_MAX) {
+                e->deadline = cur_tick + next_tick;
+                ws->num_timed++;
+            }
+        } else // Already signalled.
+            out_ids[(*count)++] = id;
+
+        e->rearm = false;
+        ws->rearm_list[i] = ws->rearm_list[--ws->rearm_count];
+    }
+}
+
+// Reports the objects flagged by waitable signals and helper threads.
+static void _waitsetCollectReady(WaitSet* ws, s32* out_ids, s32 max_ids, s32* count)
+{
+    for (u32 word = 0; word < (ws->capacity + 63) / 64 && *count < max_ids; word ++) {
+        u64 bits = __atomic_load_n(&ws->ready[word], __ATOMIC_ACQUIRE);
+        while (bits && *count < max_ids) {
+            s32 id = word*64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+
+            WaitSetEntry* e = &ws->entries[id];
+            _waitsetClearReady(ws, id);
+            if (!e->in_use)
+                continue;
+
+            if (_waitsetIsHandle(e)) {
+                // Let the helper thread wait on the handle again.
+                ws->tiers[e->tier].needs_cancel = true;
+
+                if (e->waiter.type == WaiterType_HandleWithClear && R_FAILED(svcResetSignal(e->waiter.handle)))
+                    continue;
+                out_ids[(*count)++] = id;
+            } else if (e->armed) {
+                Waitable* ww = e->waiter.waitable;
+                Result rc = ww->vt->onSignal(ww);
+                _waitsetQueueRearm(ws, id);
+                if (R_SUCCEEDED(rc))
+                    out_ids[(*count)++] = id;
+            }
+        }
+    }
+}
+
+// Reports the waitables whose timeout expired, and returns the earliest pending timeout.
+static u64 _waitsetCheckTimeouts(WaitSet* ws, u64 cur_tick, s32* out_ids, s32 max_ids, s32* count)
+{
+    u64 next_deadline = UINT64_MAX;
+    if (!ws->num_timed)
+        return next_deadline;
+
+    for (s32 id = 0; id < ws->capacity; id ++) {
+        WaitSetEntry* e = &ws->entries[id];
+        if (!e->in_use || !e->armed || e->deadline == UINT64_MAX)
+            continue;
+
+        if ((s64)(e->deadline - cur_tick) <= 0 && *count < max_ids) {
+            Waitable* ww = e->waiter.waitable;
+            Result rc = ww->vt->onTimeout(ww, e->deadline);
+            _waitsetQueueRearm(ws, id);
+            if (R_SUCCEEDED(rc))
+                out_ids[(*count)++] = id;
+        } else if (e->deadline < next_deadline)
+            next_deadline = e->deadline;
+    }
+
+    return next_deadline;
+}
+
+static bool _waitsetAnyReady(WaitSet* ws)
+{
+    for (u32 word = 0; word < (ws->capacity + 63) / 64; word ++)
+        if (__atomic_load_n(&ws->ready[word], __ATOMIC_ACQUIRE))
+            return true;
+    return false;
+}
+
+// Waits on the owner's own tier of handles. Once one handle is signalled, the remaining ones are polled.
+static Result _waitsetWaitDirect(WaitSet* ws, u64 timeout, s32* out_ids, s32 max_ids, s32* count)
+{
+    WaitSetTier* tier = &ws->tiers[0];
+    Handle handles[MAX_WAIT_OBJECTS];
+    s32 ids[MAX_WAIT_OBJECTS];
+    s32 num_handles = tier->count;
+    Result rc;
+
+    memcpy(handles, tier->handles, sizeof(Handle) * num_handles);
+    memcpy(ids, tier->ids, sizeof(s32) * num_handles);
+
+    for (;;) {
+        s32 idx;
+        rc = svcWaitSynchronization(&idx, handles, num_handles, timeout);
+        if (R_FAILED(rc))
+            break;
+
+        s32 id = ids[idx];
+        if (ws->entries[id].waiter.type != WaiterType_HandleWithClear || R_SUCCEEDED(svcResetSignal(handles[idx])))
+            out_ids[(*count)++] = id;
+
+        num_handles--;
+        handles[idx] = handles[num_handles];
+        ids[idx] = ids[num_handles];
+        if (*count == max_ids || !num_handles)
+            break;
+        timeout = 0;
+    }
+
+    return *count ? 0 : rc;
+}
+
+Result waitsetWait(WaitSet* ws, s32* out_ids, s32 max_ids, s32* out_count, u64 timeout)
+{
+    u64 deadline = timeout != UINT64_MAX ? armGetSystemTick() + armNsToTicks(timeout) : UINT64_MAX;
+    s32 count = 0;
+    Result rc;
+
+    for (;;) {
+        u64 cur_tick = armGetSystemTick();
+
+        _waitsetRearm(ws, cur_tick, out_ids, max_ids, &count);
+        _waitsetCollectReady(ws, out_ids, max_ids, &count);
+        u64 wake_tick = _waitsetCheckTimeouts(ws, cur_tick, out_ids, max_ids, &count);
+
+        for (u32 i = 1; i < ws->num_tiers; i ++)
+            if (ws->tiers[i].needs_cancel)
+                _waitsetCancelHelper(ws, i);
+
+        if (count == max_ids)
+            break;
+
+        // Block only if nothing was reported so far, otherwise just poll the direct handles.
+        u64 this_timeout = 0;
+        if (!count) {
+            if (deadline < wake_tick)
+                wake_tick = deadline;
+            if (wake_tick != UINT64_MAX) {
+                s64 remaining = wake_tick - cur_tick;
+                this_timeout = remaining > 0 ? armTicksToNs(remaining) : 0;
+            } else
+                this_timeout = UINT64_MAX;
+        }
+
+        if (this_timeout) {
+            // Let listeners and helper threads cancel our wait, unless something got flagged in the meantime.
+            mutexLock(&ws->mutex);
+            bool ready = _waitsetAnyReady(ws);
+            ws->owner_waiting = !ready;
+            mutexUnlock(&ws->mutex);
+            if (ready)
+                continue;
+        }
+
+        rc = _waitsetWaitDirect(ws, this_timeout, out_ids, max_ids, &count);
+
+        if (this_timeout) {
+            mutexLock(&ws->mutex);
+            bool cancel_sent = !ws->owner_waiting;
+            ws->owner_waiting = false;
+            mutexUnlock(&ws->mutex);
+
+            // A cancellation which arrived after the wait returned is still pending, consume it.
+            if (cancel_sent && R_VALUE(rc) != KERNELRESULT(Cancelled)) {
+                s32 idx;
+                svcWaitSynchronization(&idx, NULL, 0, 1);
+            }
+        }
+
+        if (count)
+            break;
+
+        if (R_VALUE(rc) == KERNELRESULT(TimedOut)) {
+            // Either the user timeout expired, or a waitable's timeout did and gets handled on the next iteration.
+            if (deadline != UINT64_MAX && (s64)(deadline - armGetSystemTick()) <= 0) {
+                *out_count = 0;
+                return rc;
+            }
+        } else if (R_VALUE(rc) != KERNELRESULT(Cancelled)) {
+            *out_count = 0;
+            return rc;
+        }
+    }
+
+    *out_count = count;
+    return 0;
+}
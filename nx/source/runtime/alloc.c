@@ -1,15 +1,34 @@
 #include "alloc.h"
 #include <stdlib.h>
 
+// Programs can define this as true to route libnx's internal allocations through the thread-caching allocator (see TCALLOC_USE_FOR_LIBNX).
+__attribute__((weak)) bool __nx_alloc_use_tcalloc = false;
+
+// Referenced weakly so that tcalloc is only linked into programs which opt in.
+void* __attribute__((weak)) tcallocAlloc(size_t size);
+void* __attribute__((weak)) tcallocAlignedAlloc(size_t alignment, size_t size);
+void __attribute__((weak)) tcallocFree(void* p);
+
+static inline bool _allocUseTcalloc(void) {
+    return __nx_alloc_use_tcalloc && &tcallocAlloc;
+}
+
 void* __attribute__((weak)) __libnx_alloc(size_t size) {
+    if (_allocUseTcalloc())
+        return tcallocAlloc(size);
     return malloc(size);
 }
 
 void* __attribute__((weak)) __libnx_aligned_alloc(size_t alignment, size_t size) {
     size = (size + alignment - 1) &~ (alignment - 1);
+    if (_allocUseTcalloc())
+        return tcallocAlignedAlloc(alignment, size);
     return aligned_alloc(alignment, size);
 }
 
 void __attribute__((weak)) __libnx_free(void* p) {
-    free(p);
+    if (_allocUseTcalloc())
+        tcallocFree(p);
+    else
+        free(p);
 }
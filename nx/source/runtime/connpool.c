@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "result.h"
+#include "arm/counter.h"
+#include "services/nifm.h"
+#include "runtime/connpool.h"
+#include "runtime/devices/socket.h"
+#include "runtime/devices/ssl_stream.h"
+#include "alloc.h"
+
+struct ConnPoolHost {
+    ConnPoolHost *next;
+    ConnPoolConnection *idle; // Most recently used first.
+    u32 num_active;
+    u16 port;
+    bool use_ssl;
+    char hostname[];
+};
+
+Result connpoolCreate(ConnPool *p, const ConnPoolConfig *config) {
+    memset(p, 0, sizeof(*p));
+    mutexInit(&p->mutex);
+    condvarInit(&p->condvar);
+    p->config = *config;
+    return 0;
+}
+
+static void _connpoolDestroyConnection(ConnPoolConnection *c) {
+    if (c->is_ssl) {
+        if (c->fd != -1)
+            close(c->fd);
+        if (c->ssl_sockfd != -1)
+            close(c->ssl_sockfd);
+        sslConnectionClose(&c->ssl);
+    }
+    if (c->sockfd != -1)
+        close(c->sockfd);
+    __libnx_free(c);
+}
+
+void connpoolClose(ConnPool *p) {
+    mutexLock(&p->mutex);
+    while (p->hosts) {
+        ConnPoolHost *h = p->hosts;
+        p->hosts = h->next;
+        while (h->idle) {
+            ConnPoolConnection *c = h->idle;
+            h->idle = c->next;
+            _connpoolDestroyConnection(c);
+        }
+        __libnx_free(h);
+    }
+    p->num_idle = 0;
+    mutexUnlock(&p->mutex);
+}
+
+static ConnPoolHost *_connpoolGetHost(ConnPool *p, const char *hostname, u16 port, bool use_ssl) {
+    for (ConnPoolHost *h = p->hosts; h; h = h->next)
+        if (h->port == port && h->use_ssl == use_ssl && strcmp(h->hostname, hostname) == 0)
+            return h;
+
+    size_t len = strlen(hostname) + 1;
+    ConnPoolHost *h = __libnx_alloc(sizeof(ConnPoolHost) + len);
+    if (h) {
+        memset(h, 0, sizeof(*h));
+        h->port = port;
+        h->use_ssl = use_ssl;
+        memcpy(h->hostname, hostname, len);
+        h->next = p->hosts;
+        p->hosts = h;
+    }
+    return h;
+}
+
+// A healthy idle connection has nothing to read: readability means the peer closed it (or sent unsolicited data).
+static bool _connpoolIsStale(ConnPoolConnection *c) {
+    struct pollfd pfd = { .fd = c->fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) != 0;
+}
+
+static Result _connpoolConnect(ConnPool *p, ConnPoolHost *h, ConnPoolConnection **out) {
+    char service[8];
+    snprintf(service, sizeof(service), "%u", h->port);
+
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(h->hostname, service, &hints, &res) != 0)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    ConnPoolConnection *c = __libnx_alloc(sizeof(ConnPoolConnection));
+    if (!c) {
+        freeaddrinfo(res);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+    memset(c, 0, sizeof(*c));
+    c->host = h;
+    c->fd = -1;
+    c->sockfd = -1;
+    c->ssl_sockfd = -1;
+
+    for (struct addrinfo *ai = res; ai && c->sockfd == -1; ai = ai->ai_next) {
+        c->sockfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (c->sockfd != -1 && connect(c->sockfd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(c->sockfd);
+            c->sockfd = -1;
+        }
+    }
+    freeaddrinfo(res);
+
+    if (c->sockfd == -1) {
+        __libnx_free(c);
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    if (!h->use_ssl) {
+        c->fd = c->sockfd;
+        *out = c;
+        return 0;
+    }
+
+    Result rc = sslContextCreateConnection(p->config.ssl_context, &c->ssl);
+    if (R_FAILED(rc)) {
+        close(c->sockfd);
+        __libnx_free(c);
+        return rc;
+    }
+    c->is_ssl = true;
+
+    c->ssl_sockfd = socketSslConnectionSetSocketDescriptor(&c->ssl, c->sockfd);
+    if (c->ssl_sockfd == -1 && errno != ENOENT)
+        rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    if (R_SUCCEEDED(rc))
+        rc = sslConnectionSetHostName(&c->ssl, h->hostname, strlen(h->hostname) + 1);
+    if (R_SUCCEEDED(rc) && p->config.session_cache_mode != SslSessionCacheMode_None)
+        rc = sslConnectionSetSessionCacheMode(&c->ssl, p->config.session_cache_mode);
+    if (R_SUCCEEDED(rc))
+        rc = sslConnectionDoHandshake(&c->ssl, NULL, NULL, NULL, 0);
+    if (R_SUCCEEDED(rc)) {
+        c->fd = sslStreamOpen(&c->ssl, 0, 0);
+        if (c->fd == -1)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_FAILED(rc))
+        _connpoolDestroyConnection(c);
+    else
+        *out = c;
+    return rc;
+}
+
+Result connpoolAcquire(ConnPool *p, const char *hostname, u16 port, bool use_ssl, u64 timeout, ConnPoolConnection **out) {
+    if (use_ssl && !p->config.ssl_context)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u64 deadline = timeout == UINT64_MAX ? UINT64_MAX : armGetSystemTick() + armNsToTicks(timeout);
+    u64 idle_timeout = armNsToTicks(p->config.idle_timeout);
+    Result rc = 0;
+
+    mutexLock(&p->mutex);
+
+    ConnPoolHost *h = _connpoolGetHost(p, hostname, port, use_ssl);
+    if (!h) {
+        mutexUnlock(&p->mutex);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    for (;;) {
+        ConnPoolConnection *c = h->idle;
+        if (c) {
+            h->idle = c->next;
+            p->num_idle--;
+            h->num_active++;
+            mutexUnlock(&p->mutex);
+
+            if (armGetSystemTick() - c->last_used < idle_timeout && !_connpoolIsStale(c)) {
+                c->next = NULL;
+                c->use_count++;
+                *out = c;
+                return 0;
+            }
+
+            _connpoolDestroyConnection(c);
+            mutexLock(&p->mutex);
+            h->num_active--;
+            continue;
+        }
+
+        if (!p->config.max_connections_per_host || h->num_active < p->config.max_connections_per_host) {
+            h->num_active++;
+            mutexUnlock(&p->mutex);
+
+            rc = _connpoolConnect(p, h, &c);
+            if (R_SUCCEEDED(rc)) {
+                c->use_count = 1;
+                *out = c;
+                return 0;
+            }
+
+            mutexLock(&p->mutex);
+            h->num_active--;
+            condvarWakeAll(&p->condvar);
+            break;
+        }
+
+        u64 now = armGetSystemTick();
+        if (now >= deadline) {
+            rc = KERNELRESULT(TimedOut);
+            break;
+        }
+        condvarWaitTimeout(&p->condvar, &p->mutex, deadline == UINT64_MAX ? UINT64_MAX : armTicksToNs(deadline - now));
+    }
+
+    mutexUnlock(&p->mutex);
+    return rc;
+}
+
+void connpoolRelease(ConnPool *p, ConnPoolConnection *c, bool reusable) {
+    // Pending writes need to go out before the connection is reused, and an error means it's broken.
+    if (reusable && c->is_ssl && sslStreamFlush(c->fd) != 0)
+        reusable = false;
+
+    mutexLock(&p->mutex);
+
+    ConnPoolHost *h = c->host;
+    h->num_active--;
+    if (reusable && p->num_idle < p->config.max_idle_connections) {
+        c->last_used = armGetSystemTick();
+        c->next = h->idle;
+        h->idle = c;
+        p->num_idle++;
+        c = NULL;
+    }
+    condvarWakeAll(&p->condvar);
+
+    mutexUnlock(&p->mutex);
+
+    if (c)
+        _connpoolDestroyConnection(c);
+}
+
+void connpoolPrune(ConnPool *p) {
+    u64 idle_timeout = armNsToTicks(p->config.idle_timeout);
+    ConnPoolConnection *expired = NULL;
+    u64 now = armGetSystemTick();
+
+    mutexLock(&p->mutex);
+    for (ConnPoolHost *h = p->hosts; h; h = h->next) {
+        // The idle list is sorted by decreasing last use, so the expired connections are at its end.
+        ConnPoolConnection **link = &h->idle;
+        while (*link && now - (*link)->last_used < idle_timeout)
+            link = &(*link)->next;
+        while (*link) {
+            ConnPoolConnection *c = *link;
+            *link = c->next;
+            c->next = expired;
+            expired = c;
+            p->num_idle--;
+        }
+    }
+    mutexUnlock(&p->mutex);
+
+    while (expired) {
+        ConnPoolConnection *c = expired;
+        expired = c->next;
+        _connpoolDestroyConnection(c);
+    }
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <unistd.h>
 #include <alloca.h>
 #include <sys/iosupport.h>
 
@@ -14,6 +15,12 @@
 #include <sys/sysctl.h>
 
 #include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
+#include "services/fs.h"
 #include "services/bsd.h"
 #include "services/ssl.h"
 #include "services/nifm.h"
@@ -23,7 +30,15 @@
 
 __attribute__((weak)) size_t __nx_pollfd_sb_max_fds = 64;
 
+#define SOCKET_SENDFILE_DEFAULT_BUFFER_SIZE 0x40000
+#define SOCKET_SENDFILE_STACK_SIZE          0x4000
+
+#define SOCKET_STATS_MIN_BUF_SIZE           0x4000
+#define SOCKET_STATS_MAX_BUF_SIZE           0x200000
+
 int _convert_errno(int bsdErrno);
+// Only linked in (through ssl_stream.c) by programs which use sslStreamOpen.
+int __attribute__((weak)) _sslStreamPoll(struct pollfd *fds, struct pollfd *bsd_fds, nfds_t nfds, int timeout, int (*bsd_poll)(struct pollfd *, nfds_t, int));
 
 static int _socketOpen(struct _reent *r, void *fdptr, const char *path, int flags, int mode);
 static int _socketClose(struct _reent *r, void *fdptr);
@@ -31,6 +46,9 @@ static ssize_t _socketWrite(struct _reent *r, void *fdptr, const char *buf, size
 static ssize_t _socketRead(struct _reent *r, void *fdptr, char *buf, size_t count);
 
 static int _socketGetFd(int fd);
+static int _socketParseBsdResult(struct _reent *r, int ret);
+static void _socketStatsOnTransfer(int fd, bool is_send, ssize_t ret);
+static void _socketStatsOnClose(int fd);
 
 static const devoptab_t g_socketDevoptab = {
     .name = "soc",
@@ -76,6 +94,25 @@ static const SocketInitConfig g_defaultSocketInitConfig = {
     .bsd_service_type = BsdServiceType_User,
 };
 
+static SocketInitConfig g_socketConfig;
+
+typedef struct {
+    SocketStats stats;
+    u32 window_peak_tx_queued;  // Since the last socketAutotune call.
+    u32 window_peak_rx_queued;
+    bool window_tx_full;
+    bool window_rx_full;
+    bool valid;
+} SocketStatsEntry;
+
+static Mutex g_socketStatsMutex;
+static SocketStatsEntry *g_socketStats;
+static u32 g_socketStatsMaxSockets;
+static u32 g_socketStatsNumActive;
+static u32 g_socketStatsPeakActive;
+static SocketStats g_socketStatsClosedTcp; // Accumulated statistics of the closed sockets.
+static SocketStats g_socketStatsClosedUdp;
+
 const SocketInitConfig *socketGetDefaultInitConfig(void) {
     return &g_defaultSocketInitConfig;
 }
@@ -146,6 +183,7 @@ Result socketInitialize(const SocketInitConfig *config) {
         return MAKERESULT(Module_Libnx, LibnxError_TooManyDevOpTabs);
     }
     else {
+        g_socketConfig = *config;
         g_bsdResult = 0;
         g_bsdErrno = 0;
     }
@@ -284,6 +322,446 @@ int socketNifmRequestUnregisterSocketDescriptor(NifmRequest* r, int sockfd) {
     return 0;
 }
 
+static void _socketStatsMerge(SocketStats *acc, const SocketStats *s) {
+    acc->bytes_sent += s->bytes_sent;
+    acc->bytes_received += s->bytes_received;
+    if (acc->peak_tx_queued < s->peak_tx_queued) acc->peak_tx_queued = s->peak_tx_queued;
+    if (acc->peak_rx_queued < s->peak_rx_queued) acc->peak_rx_queued = s->peak_rx_queued;
+    if (acc->tx_buf_size < s->tx_buf_size) acc->tx_buf_size = s->tx_buf_size;
+    if (acc->rx_buf_size < s->rx_buf_size) acc->rx_buf_size = s->rx_buf_size;
+    acc->tx_full_count += s->tx_full_count;
+    acc->rx_full_count += s->rx_full_count;
+}
+
+static void _socketStatsGetBufSizes(int fd, SocketStats *s) {
+    int size = 0;
+    socklen_t optlen = sizeof(size);
+    if (bsdGetSockOpt(fd, SOL_SOCKET, SO_SNDBUF, &size, &optlen) != -1)
+        s->tx_buf_size = size;
+    optlen = sizeof(size);
+    if (bsdGetSockOpt(fd, SOL_SOCKET, SO_RCVBUF, &size, &optlen) != -1)
+        s->rx_buf_size = size;
+}
+
+NX_CONSTEXPR bool _socketStatsIsFull(u32 queued, u32 buf_size) {
+    return buf_size && queued >= buf_size - buf_size / 8;
+}
+
+static void _socketStatsOnTransfer(int fd, bool is_send, ssize_t ret) {
+    if (!g_socketStats || ret <= 0 || fd < 0 || (u32)fd >= g_socketStatsMaxSockets)
+        return;
+
+    // Don't clobber the result of the actual operation.
+    Result saved_result = g_bsdResult;
+    int saved_errno = g_bsdErrno;
+
+    u64 tick = armGetSystemTick();
+    int queued = 0;
+    if (bsdIoctl(fd, is_send ? FIONWRITE : FIONREAD, &queued) == -1)
+        queued = 0;
+    if (!is_send)
+        queued += ret; // What was queued before this receive.
+
+    mutexLock(&g_socketStatsMutex);
+
+    if (g_socketStats && (u32)fd < g_socketStatsMaxSockets) {
+        SocketStatsEntry *e = &g_socketStats[fd];
+        SocketStats *s = &e->stats;
+
+        if (!e->valid) {
+            int type = 0;
+            socklen_t optlen = sizeof(type);
+            if (bsdGetSockOpt(fd, SOL_SOCKET, SO_TYPE, &type, &optlen) != -1)
+                s->is_tcp = type == SOCK_STREAM;
+            _socketStatsGetBufSizes(fd, s);
+            s->first_tick = tick;
+            e->valid = true;
+            if (++g_socketStatsNumActive > g_socketStatsPeakActive)
+                g_socketStatsPeakActive = g_socketStatsNumActive;
+        }
+
+        s->last_tick = tick;
+        if (is_send) {
+            s->bytes_sent += ret;
+            if (s->peak_tx_queued < queued) s->peak_tx_queued = queued;
+            if (e->window_peak_tx_queued < queued) e->window_peak_tx_queued = queued;
+            if (_socketStatsIsFull(queued, s->tx_buf_size)) {
+                s->tx_full_count++;
+                e->window_tx_full = true;
+            }
+        }
+        else {
+            s->bytes_received += ret;
+            if (s->peak_rx_queued < queued) s->peak_rx_queued = queued;
+            if (e->window_peak_rx_queued < queued) e->window_peak_rx_queued = queued;
+            if (_socketStatsIsFull(queued, s->rx_buf_size)) {
+                s->rx_full_count++;
+                e->window_rx_full = true;
+            }
+        }
+    }
+
+    mutexUnlock(&g_socketStatsMutex);
+
+    g_bsdResult = saved_result;
+    g_bsdErrno = saved_errno;
+}
+
+static void _socketStatsOnClose(int fd) {
+    if (!g_socketStats)
+        return;
+
+    mutexLock(&g_socketStatsMutex);
+
+    if (g_socketStats && fd >= 0 && (u32)fd < g_socketStatsMaxSockets && g_socketStats[fd].valid) {
+        SocketStatsEntry *e = &g_socketStats[fd];
+        _socketStatsMerge(e->stats.is_tcp ? &g_socketStatsClosedTcp : &g_socketStatsClosedUdp, &e->stats);
+        memset(e, 0, sizeof(*e));
+        g_socketStatsNumActive--;
+    }
+
+    mutexUnlock(&g_socketStatsMutex);
+}
+
+Result socketStatsInitialize(u32 max_sockets) {
+    if (g_socketStats)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+    if (!max_sockets)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    SocketStatsEntry *entries = (SocketStatsEntry *)__libnx_alloc(max_sockets * sizeof(SocketStatsEntry));
+    if (!entries)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    memset(entries, 0, max_sockets * sizeof(SocketStatsEntry));
+
+    mutexLock(&g_socketStatsMutex);
+    g_socketStatsMaxSockets = max_sockets;
+    g_socketStatsNumActive = 0;
+    g_socketStatsPeakActive = 0;
+    memset(&g_socketStatsClosedTcp, 0, sizeof(g_socketStatsClosedTcp));
+    memset(&g_socketStatsClosedUdp, 0, sizeof(g_socketStatsClosedUdp));
+    g_socketStats = entries;
+    mutexUnlock(&g_socketStatsMutex);
+
+    return 0;
+}
+
+void socketStatsExit(void) {
+    mutexLock(&g_socketStatsMutex);
+    __libnx_free(g_socketStats);
+    g_socketStats = NULL;
+    g_socketStatsMaxSockets = 0;
+    mutexUnlock(&g_socketStatsMutex);
+}
+
+int socketGetStats(int sockfd, SocketStats *out) {
+    int fd = _socketGetFd(sockfd);
+    if (fd == -1)
+        return -1;
+
+    int ret = 0;
+    mutexLock(&g_socketStatsMutex);
+
+    if (!g_socketStats) {
+        errno = EINVAL;
+        ret = -1;
+    }
+    else if ((u32)fd >= g_socketStatsMaxSockets) {
+        errno = ENOENT;
+        ret = -1;
+    }
+    else {
+        *out = g_socketStats[fd].stats;
+        _socketStatsGetBufSizes(fd, out);
+    }
+
+    mutexUnlock(&g_socketStatsMutex);
+    return ret;
+}
+
+static u32 _socketStatsRecommendSize(u32 peak, bool full, u32 cur) {
+    // A buffer which got full limited the throughput, otherwise the peak occupancy is all that was needed.
+    u64 size = full ? (u64)cur * 2 : peak + peak / 4;
+    size = (size + 0xFFF) &~ 0xFFF;
+    if (size < SOCKET_STATS_MIN_BUF_SIZE) size = SOCKET_STATS_MIN_BUF_SIZE;
+    if (size > SOCKET_STATS_MAX_BUF_SIZE) size = SOCKET_STATS_MAX_BUF_SIZE;
+    return size;
+}
+
+void socketStatsGetRecommendedConfig(SocketInitConfig *out) {
+    *out = g_socketConfig.sb_efficiency ? g_socketConfig : g_defaultSocketInitConfig;
+
+    mutexLock(&g_socketStatsMutex);
+
+    SocketStats tcp = g_socketStatsClosedTcp;
+    SocketStats udp = g_socketStatsClosedUdp;
+    for (u32 i = 0; g_socketStats && i < g_socketStatsMaxSockets; i++) {
+        if (g_socketStats[i].valid)
+            _socketStatsMerge(g_socketStats[i].stats.is_tcp ? &tcp : &udp, &g_socketStats[i].stats);
+    }
+    u32 peak_active = g_socketStatsPeakActive;
+
+    mutexUnlock(&g_socketStatsMutex);
+
+    if (tcp.bytes_sent) {
+        u32 cur = out->tcp_tx_buf_max_size > tcp.tx_buf_size ? out->tcp_tx_buf_max_size : tcp.tx_buf_size;
+        out->tcp_tx_buf_max_size = _socketStatsRecommendSize(tcp.peak_tx_queued, tcp.tx_full_count != 0, cur);
+        if (out->tcp_tx_buf_size > out->tcp_tx_buf_max_size)
+            out->tcp_tx_buf_size = out->tcp_tx_buf_max_size;
+    }
+
+    if (tcp.bytes_received) {
+        u32 cur = out->tcp_rx_buf_max_size > tcp.rx_buf_size ? out->tcp_rx_buf_max_size : tcp.rx_buf_size;
+        out->tcp_rx_buf_max_size = _socketStatsRecommendSize(tcp.peak_rx_queued, tcp.rx_full_count != 0, cur);
+        if (out->tcp_rx_buf_size > out->tcp_rx_buf_max_size)
+            out->tcp_rx_buf_size = out->tcp_rx_buf_max_size;
+    }
+
+    // UDP buffers don't grow on their own, only enlarge the ones which dropped datagrams.
+    if (udp.tx_full_count)
+        out->udp_tx_buf_size = _socketStatsRecommendSize(udp.peak_tx_queued, true, out->udp_tx_buf_size);
+    if (udp.rx_full_count)
+        out->udp_rx_buf_size = _socketStatsRecommendSize(udp.peak_rx_queued, true, out->udp_rx_buf_size);
+
+    if (peak_active)
+        out->sb_efficiency = peak_active < 8 ? peak_active : 8;
+}
+
+static u32 _socketAutotuneSize(u32 cur, u32 peak, bool full, u32 min_size, u32 max_size, u32 available) {
+    u32 size = cur;
+    if (full) {
+        size = cur * 2 < max_size ? cur * 2 : max_size;
+        if (size > cur + available)
+            size = (cur + available) &~ 0xFFF;
+    }
+    else if (peak < cur / 4)
+        size = cur / 2 > min_size ? cur / 2 : min_size;
+
+    return size < cur && full ? cur : size;
+}
+
+int socketAutotune(int sockfd) {
+    int fd = _socketGetFd(sockfd);
+    if (fd == -1)
+        return -1;
+
+    int ret = 0;
+    mutexLock(&g_socketStatsMutex);
+
+    if (!g_socketStats || (u32)fd >= g_socketStatsMaxSockets) {
+        mutexUnlock(&g_socketStatsMutex);
+        errno = g_socketStats ? ENOENT : EINVAL;
+        return -1;
+    }
+
+    SocketStatsEntry *e = &g_socketStats[fd];
+    SocketStats *s = &e->stats;
+    if (!e->valid || !s->is_tcp) {
+        mutexUnlock(&g_socketStatsMutex);
+        return 0;
+    }
+
+    _socketStatsGetBufSizes(fd, s);
+
+    // The tuned buffers of all the sockets share the budget of sb_efficiency maximum-sized buffers.
+    const SocketInitConfig *config = &g_socketConfig;
+    u32 tx_max = config->tcp_tx_buf_max_size ? config->tcp_tx_buf_max_size : config->tcp_tx_buf_size;
+    u32 rx_max = config->tcp_rx_buf_max_size ? config->tcp_rx_buf_max_size : config->tcp_rx_buf_size;
+    u64 tx_used = 0, rx_used = 0;
+    for (u32 i = 0; i < g_socketStatsMaxSockets; i++) {
+        if (g_socketStats[i].valid && g_socketStats[i].stats.is_tcp) {
+            tx_used += g_socketStats[i].stats.tx_buf_size;
+            rx_used += g_socketStats[i].stats.rx_buf_size;
+        }
+    }
+    u64 tx_budget = (u64)config->sb_efficiency * tx_max;
+    u64 rx_budget = (u64)config->sb_efficiency * rx_max;
+    u32 tx_available = tx_budget > tx_used ? tx_budget - tx_used : 0;
+    u32 rx_available = rx_budget > rx_used ? rx_budget - rx_used : 0;
+
+    int tx_size = _socketAutotuneSize(s->tx_buf_size, e->window_peak_tx_queued, e->window_tx_full, config->tcp_tx_buf_size, tx_max, tx_available);
+    int rx_size = _socketAutotuneSize(s->rx_buf_size, e->window_peak_rx_queued, e->window_rx_full, config->tcp_rx_buf_size, rx_max, rx_available);
+
+    if (tx_size != s->tx_buf_size) {
+        ret = _socketParseBsdResult(NULL, bsdSetSockOpt(fd, SOL_SOCKET, SO_SNDBUF, &tx_size, sizeof(tx_size)));
+        if (ret != -1)
+            s->tx_buf_size = tx_size;
+    }
+
+    if (ret != -1 && rx_size != s->rx_buf_size) {
+        ret = _socketParseBsdResult(NULL, bsdSetSockOpt(fd, SOL_SOCKET, SO_RCVBUF, &rx_size, sizeof(rx_size)));
+        if (ret != -1)
+            s->rx_buf_size = rx_size;
+    }
+
+    e->window_peak_tx_queued = 0;
+    e->window_peak_rx_queued = 0;
+    e->window_tx_full = false;
+    e->window_rx_full = false;
+
+    mutexUnlock(&g_socketStatsMutex);
+    return ret;
+}
+
+typedef struct {
+    Mutex mutex;
+    CondVar cond;
+    FsFile *file;
+    s64 offset;
+    size_t remaining;
+    size_t buffer_size;
+    u8 *buffers[2];
+    size_t sizes[2];
+    bool filled[2];
+    bool cancel;
+    Result rc;
+} SocketSendFile;
+
+// Reads the file into the two buffers in turn. A filled buffer of size 0 marks the end of the data.
+static void _socketSendFileReader(void *arg) {
+    SocketSendFile *s = (SocketSendFile *)arg;
+
+    for (u32 i = 0;; i ^= 1) {
+        mutexLock(&s->mutex);
+        while (s->filled[i] && !s->cancel)
+            condvarWait(&s->cond, &s->mutex);
+        bool cancel = s->cancel;
+        size_t size = s->remaining < s->buffer_size ? s->remaining : s->buffer_size;
+        s64 offset = s->offset;
+        mutexUnlock(&s->mutex);
+
+        if (cancel)
+            break;
+
+        u64 bytes_read = 0;
+        Result rc = 0;
+        if (size)
+            rc = fsFileRead(s->file, offset, s->buffers[i], size, FsReadOption_None, &bytes_read);
+        if (R_FAILED(rc))
+            bytes_read = 0;
+
+        mutexLock(&s->mutex);
+        s->rc = rc;
+        s->sizes[i] = bytes_read;
+        s->filled[i] = true;
+        s->offset += bytes_read;
+        s->remaining -= bytes_read;
+        condvarWakeAll(&s->cond);
+        mutexUnlock(&s->mutex);
+
+        if (!bytes_read)
+            break;
+    }
+}
+
+ssize_t socketSendFsFile(int sockfd, FsFile *file, s64 *offset, size_t count, size_t buffer_size) {
+    if (!buffer_size)
+        buffer_size = SOCKET_SENDFILE_DEFAULT_BUFFER_SIZE;
+    if (!count)
+        return 0;
+
+    SocketSendFile s = {
+        .file = file,
+        .offset = *offset,
+        .remaining = count,
+        .buffer_size = count < buffer_size ? count : buffer_size,
+    };
+    mutexInit(&s.mutex);
+    condvarInit(&s.cond);
+
+    // Small transfers don't need the second buffer nor the helper thread.
+    bool pipelined = count > s.buffer_size;
+    u8 *buffers = (u8 *)__libnx_aligned_alloc(0x1000, s.buffer_size * (pipelined ? 2 : 1));
+    if (!buffers) {
+        errno = ENOMEM;
+        return -1;
+    }
+    s.buffers[0] = buffers;
+    s.buffers[1] = buffers + s.buffer_size;
+
+    Thread thread;
+    Result rc = 0;
+    if (!pipelined) {
+        u64 bytes_read = 0;
+        rc = fsFileRead(file, s.offset, s.buffers[0], count, FsReadOption_None, &bytes_read);
+        s.rc = rc;
+        s.sizes[0] = R_SUCCEEDED(rc) ? bytes_read : 0;
+        s.filled[0] = true;
+    }
+    else {
+        s32 prio = 0x2C;
+        svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+        rc = threadCreate(&thread, _socketSendFileReader, &s, NULL, SOCKET_SENDFILE_STACK_SIZE, prio, -2);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&thread);
+            if (R_FAILED(rc))
+                threadClose(&thread);
+        }
+        if (R_FAILED(rc)) {
+            __libnx_free(buffers);
+            g_bsdResult = rc;
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+
+    size_t total = 0;
+    int err = 0;
+    for (u32 i = 0;; i ^= 1) {
+        mutexLock(&s.mutex);
+        while (!s.filled[i])
+            condvarWait(&s.cond, &s.mutex);
+        size_t size = s.sizes[i];
+        rc = s.rc;
+        mutexUnlock(&s.mutex);
+
+        if (!size)
+            break;
+
+        // Send the buffer while the helper thread reads the next one.
+        for (size_t pos = 0; pos < size && !err;) {
+            ssize_t ret = write(sockfd, s.buffers[i] + pos, size - pos);
+            if (ret < 0)
+                err = errno;
+            else
+                pos += ret;
+            if (ret > 0)
+                total += ret;
+        }
+
+        mutexLock(&s.mutex);
+        s.filled[i] = false;
+        s.cancel = err != 0;
+        condvarWakeAll(&s.cond);
+        mutexUnlock(&s.mutex);
+
+        if (err || !pipelined)
+            break;
+    }
+
+    if (pipelined) {
+        threadWaitForExit(&thread);
+        threadClose(&thread);
+    }
+    __libnx_free(buffers);
+
+    *offset += total;
+
+    // Like sendfile, only report errors when nothing was sent.
+    if (total)
+        return total;
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    if (R_FAILED(rc)) {
+        g_bsdResult = rc;
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
 /***********************************************************************************************************************/
 
 static int _socketGetFd(int fd) {
@@ -299,6 +777,17 @@ static int _socketGetFd(int fd) {
     return *(int *)handle->fileStruct;
 }
 
+static bool _socketIsSslStream(int fd) {
+    __handle *handle = __get_handle(fd);
+    return handle != NULL && strcmp(devoptab_list[handle->device]->name, "ssl") == 0;
+}
+
+static int _socketParseBsdResult(struct _reent *r, int ret);
+
+static int _socketBsdPoll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    return _socketParseBsdResult(NULL, bsdPoll(fds, nfds, timeout));
+}
+
 static int _socketParseBsdResult(struct _reent *r, int ret) {
     int errno_;
     if(ret != -1)
@@ -348,6 +837,7 @@ static int _socketOpen(struct _reent *r, void *fdptr, const char *path, int flag
 
 static int _socketClose(struct _reent *r, void *fdptr) {
     int fd = *(int *)fdptr;
+    _socketStatsOnClose(fd);
     return _socketParseBsdResult(r, bsdClose(fd));
 }
 
@@ -356,6 +846,7 @@ static ssize_t _socketWrite(struct _reent *r, void *fdptr, const char *buf, size
     ssize_t ret = bsdWrite(fd, buf, count);
 
     _socketParseBsdResult(r, (int)ret);
+    _socketStatsOnTransfer(fd, true, ret);
     return ret;
 }
 
@@ -364,6 +855,7 @@ static ssize_t _socketRead(struct _reent *r, void *fdptr, char *buf, size_t coun
     ssize_t ret = bsdRead(fd, buf, count);
 
     _socketParseBsdResult(r, (int)ret);
+    _socketStatsOnTransfer(fd, false, ret);
     return ret;
 }
 
@@ -404,11 +896,7 @@ int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struc
         if((readfds && FD_ISSET(i, readfds))
         || (writefds && FD_ISSET(i, writefds))
         || (exceptfds && FD_ISSET(i, exceptfds))) {
-            pollinfo[j].fd      = _socketGetFd(i);
-            if(pollinfo[j].fd == -1) {
-                rc = -1;
-                goto cleanup;
-            }
+            pollinfo[j].fd      = i; // Translated by poll, which also handles SSL streams.
             pollinfo[j].events  = 0;
             pollinfo[j].revents = 0;
 
@@ -422,9 +910,9 @@ int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struc
     }
 
     if(timeout)
-        rc = _socketParseBsdResult(NULL, bsdPoll(pollinfo, numfds, timeout->tv_sec*1000 + timeout->tv_usec/1000));
+        rc = poll(pollinfo, numfds, timeout->tv_sec*1000 + timeout->tv_usec/1000);
     else
-        rc = _socketParseBsdResult(NULL, bsdPoll(pollinfo, numfds, -1));
+        rc = poll(pollinfo, numfds, -1);
 
     if(rc < 0)
         goto cleanup;
@@ -488,11 +976,16 @@ int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
         return -1;
     }
 
+    nfds_t num_ssl_streams = 0;
     for(nfds_t i = 0; i < nfds; i++) {
         fds2[i].events = fds[i].events;
         fds2[i].revents = fds[i].revents;
         if(fds[i].fd < 0) {
             fds2[i].fd = -1;
+        } else if(_socketIsSslStream(fds[i].fd)) {
+            // SSL streams are polled separately by _sslStreamPoll.
+            fds2[i].fd = -1;
+            num_ssl_streams++;
         } else {
             fds2[i].fd = _socketGetFd(fds[i].fd);
             if(fds2[i].fd == -1) {
@@ -502,7 +995,9 @@ int poll(struct pollfd *fds, nfds_t nfds, int timeout) {
         }
     }
 
-    if(ret != -1)
+    if(ret != -1 && num_ssl_streams && &_sslStreamPoll)
+        ret = _sslStreamPoll(fds, fds2, nfds, timeout, _socketBsdPoll);
+    else if(ret != -1)
         ret = _socketParseBsdResult(NULL, bsdPoll(fds2, nfds, timeout));
     if(ret != -1) {
         for(nfds_t i = 0; i < nfds; i++) {
@@ -575,7 +1070,9 @@ ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
     if(sockfd == -1)
         return -1;
     ret = bsdRecv(sockfd, buf, len, flags);
-    return _socketParseBsdResult(NULL, (int)ret);
+    ret = _socketParseBsdResult(NULL, (int)ret);
+    _socketStatsOnTransfer(sockfd, false, ret);
+    return ret;
 }
 
 ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen) {
@@ -584,7 +1081,9 @@ ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *
     if(sockfd == -1)
         return -1;
     ret = bsdRecvFrom(sockfd, buf, len, flags, src_addr, addrlen);
-    return _socketParseBsdResult(NULL, (int)ret);
+    ret = _socketParseBsdResult(NULL, (int)ret);
+    _socketStatsOnTransfer(sockfd, false, ret);
+    return ret;
 }
 
 ssize_t send(int sockfd, const void* buf, size_t len, int flags) {
@@ -593,7 +1092,9 @@ ssize_t send(int sockfd, const void* buf, size_t len, int flags) {
     if(sockfd == -1)
         return -1;
     ret = bsdSend(sockfd, buf, len, flags);
-    return _socketParseBsdResult(NULL, (int)ret);
+    ret = _socketParseBsdResult(NULL, (int)ret);
+    _socketStatsOnTransfer(sockfd, true, ret);
+    return ret;
 }
 
 ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
@@ -602,7 +1103,9 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct
     if(sockfd == -1)
         return -1;
     ret = bsdSendTo(sockfd, buf, len, flags, dest_addr, addrlen);
-    return _socketParseBsdResult(NULL, (int)ret);
+    ret = _socketParseBsdResult(NULL, (int)ret);
+    _socketStatsOnTransfer(sockfd, true, ret);
+    return ret;
 }
 
 int accept(int sockfd, struct sockaddr *address, socklen_t *addrlen) {
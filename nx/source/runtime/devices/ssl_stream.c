@@ -0,0 +1,317 @@
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/iosupport.h>
+
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/mutex.h"
+#include "kernel/svc.h"
+#include "services/ssl.h"
+#include "runtime/devices/ssl_stream.h"
+#include "../alloc.h"
+
+// Maximum time spent waiting in one go when both sockets and SSL streams are polled, since they can't be waited on together.
+#define SSL_STREAM_POLL_SLICE_MS 10
+
+typedef struct {
+    SslConnection *c;
+
+    Mutex read_mutex;
+    u8 *read_buf;
+    u32 read_size, read_pos, read_len;
+
+    Mutex write_mutex;
+    u8 *write_buf;
+    u32 write_size, write_len;
+} SslStream;
+
+static int _sslStreamClose(struct _reent *r, void *fdptr);
+static ssize_t _sslStreamWrite(struct _reent *r, void *fdptr, const char *buf, size_t count);
+static ssize_t _sslStreamRead(struct _reent *r, void *fdptr, char *buf, size_t count);
+
+static const devoptab_t g_sslStreamDevoptab = {
+    .name = "ssl",
+    .structSize   = sizeof(SslStream *),
+    .close_r      = _sslStreamClose,
+    .write_r      = _sslStreamWrite,
+    .read_r       = _sslStreamRead,
+};
+
+static __thread Result g_sslStreamResult;
+static Mutex g_sslStreamDeviceMutex;
+
+Result sslStreamGetLastResult(void) {
+    return g_sslStreamResult;
+}
+
+static SslStream *_sslStreamGet(int fd) {
+    __handle *handle = __get_handle(fd);
+    if(handle == NULL) {
+        errno = EBADF;
+        return NULL;
+    }
+    if(strcmp(devoptab_list[handle->device]->name, "ssl") != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return *(SslStream **)handle->fileStruct;
+}
+
+static int _sslStreamParseResult(struct _reent *r, Result rc) {
+    g_sslStreamResult = rc;
+    if(R_SUCCEEDED(rc))
+        return 0;
+
+    if(r == NULL)
+        errno = EIO;
+    else
+        r->_errno = EIO;
+    return -1;
+}
+
+// Must be called with write_mutex held.
+static int _sslStreamWriteAll(struct _reent *r, SslStream *s, const void *buf, size_t count) {
+    const u8 *pos = (const u8 *)buf;
+    while(count) {
+        u32 out_size = 0;
+        u32 size = count > UINT32_MAX ? UINT32_MAX : count;
+        if(_sslStreamParseResult(r, sslConnectionWrite(s->c, pos, size, &out_size)) == -1)
+            return -1;
+        if(out_size == 0) {
+            if(r == NULL) errno = EPIPE; else r->_errno = EPIPE;
+            return -1;
+        }
+        pos += out_size;
+        count -= out_size;
+    }
+    return 0;
+}
+
+// Must be called with write_mutex held.
+static int _sslStreamFlush(struct _reent *r, SslStream *s) {
+    int ret = _sslStreamWriteAll(r, s, s->write_buf, s->write_len);
+    if(ret == 0)
+        s->write_len = 0;
+    return ret;
+}
+
+int sslStreamOpen(SslConnection *c, u32 read_buf_size, u32 write_buf_size) {
+    if(!read_buf_size)
+        read_buf_size = SSL_STREAM_DEFAULT_BUFFER_SIZE;
+    if(!write_buf_size)
+        write_buf_size = SSL_STREAM_DEFAULT_BUFFER_SIZE;
+
+    mutexLock(&g_sslStreamDeviceMutex);
+    int dev = FindDevice("ssl:");
+    if(dev == -1)
+        dev = AddDevice(&g_sslStreamDevoptab);
+    mutexUnlock(&g_sslStreamDeviceMutex);
+    if(dev == -1) {
+        errno = ENFILE;
+        return -1;
+    }
+
+    SslStream *s = (SslStream *)__libnx_alloc(sizeof(SslStream) + read_buf_size + write_buf_size);
+    if(s == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->c = c;
+    s->read_buf = (u8 *)(s + 1);
+    s->read_size = read_buf_size;
+    s->write_buf = s->read_buf + read_buf_size;
+    s->write_size = write_buf_size;
+
+    int fd = __alloc_handle(dev);
+    if(fd == -1) {
+        __libnx_free(s);
+        return -1;
+    }
+
+    *(SslStream **)__get_handle(fd)->fileStruct = s;
+    return fd;
+}
+
+int sslStreamFlush(int fd) {
+    SslStream *s = _sslStreamGet(fd);
+    if(s == NULL)
+        return -1;
+
+    mutexLock(&s->write_mutex);
+    int ret = _sslStreamFlush(NULL, s);
+    mutexUnlock(&s->write_mutex);
+    return ret;
+}
+
+SslConnection *sslStreamGetConnection(int fd) {
+    SslStream *s = _sslStreamGet(fd);
+    return s ? s->c : NULL;
+}
+
+static int _sslStreamClose(struct _reent *r, void *fdptr) {
+    SslStream *s = *(SslStream **)fdptr;
+
+    mutexLock(&s->write_mutex);
+    int ret = _sslStreamFlush(r, s);
+    mutexUnlock(&s->write_mutex);
+
+    __libnx_free(s);
+    return ret;
+}
+
+static ssize_t _sslStreamWrite(struct _reent *r, void *fdptr, const char *buf, size_t count) {
+    SslStream *s = *(SslStream **)fdptr;
+    ssize_t ret = count;
+
+    mutexLock(&s->write_mutex);
+
+    if(s->write_len + count > s->write_size && _sslStreamFlush(r, s) == -1)
+        ret = -1;
+    else if(count >= s->write_size) {
+        // Large writes go straight from the caller's buffer.
+        if(_sslStreamWriteAll(r, s, buf, count) == -1)
+            ret = -1;
+    } else {
+        memcpy(s->write_buf + s->write_len, buf, count);
+        s->write_len += count;
+    }
+
+    mutexUnlock(&s->write_mutex);
+    return ret;
+}
+
+static ssize_t _sslStreamRead(struct _reent *r, void *fdptr, char *buf, size_t count) {
+    SslStream *s = *(SslStream **)fdptr;
+    u32 out_size = 0;
+    ssize_t ret;
+
+    // Request/response protocols would deadlock if the request was still sitting in the write buffer.
+    mutexLock(&s->write_mutex);
+    ret = s->write_len ? _sslStreamFlush(r, s) : 0;
+    mutexUnlock(&s->write_mutex);
+    if(ret == -1)
+        return -1;
+
+    mutexLock(&s->read_mutex);
+
+    if(s->read_pos == s->read_len && count) {
+        if(count >= s->read_size) {
+            // Large reads go straight to the caller's buffer.
+            u32 size = count > UINT32_MAX ? UINT32_MAX : count;
+            ret = _sslStreamParseResult(r, sslConnectionRead(s->c, buf, size, &out_size));
+            mutexUnlock(&s->read_mutex);
+            return ret == -1 ? -1 : (ssize_t)out_size;
+        }
+
+        ret = _sslStreamParseResult(r, sslConnectionRead(s->c, s->read_buf, s->read_size, &out_size));
+        if(ret == -1) {
+            mutexUnlock(&s->read_mutex);
+            return -1;
+        }
+        s->read_pos = 0;
+        s->read_len = out_size > s->read_size ? s->read_size : out_size;
+    }
+
+    ret = s->read_len - s->read_pos;
+    if((size_t)ret > count)
+        ret = count;
+    memcpy(buf, s->read_buf + s->read_pos, ret);
+    s->read_pos += ret;
+
+    mutexUnlock(&s->read_mutex);
+    return ret;
+}
+
+static u32 _sslStreamPollEvents(short events) {
+    u32 out = 0;
+    if(events & POLLIN)
+        out |= SslPollEvent_Read;
+    if(events & POLLOUT)
+        out |= SslPollEvent_Write;
+    return out | SslPollEvent_Except;
+}
+
+static short _sslStreamPollRevents(u32 pollevent) {
+    short out = 0;
+    if(pollevent & SslPollEvent_Read)
+        out |= POLLIN;
+    if(pollevent & SslPollEvent_Write)
+        out |= POLLOUT;
+    if(pollevent & SslPollEvent_Except)
+        out |= POLLERR;
+    return out;
+}
+
+// Polls the SSL streams without blocking, or with the specified timeout if it's the only fd being polled.
+static int _sslStreamPollStreams(struct pollfd *fds, struct pollfd *bsd_fds, nfds_t nfds, nfds_t num_streams, int timeout) {
+    int ready = 0;
+    for(nfds_t i = 0; i < nfds; i++) {
+        if(fds[i].fd < 0 || bsd_fds[i].fd != -1)
+            continue;
+
+        SslStream *s = _sslStreamGet(fds[i].fd);
+        if(s == NULL)
+            continue;
+
+        short revents = 0;
+        if((fds[i].events & POLLIN) && __atomic_load_n(&s->read_pos, __ATOMIC_RELAXED) != __atomic_load_n(&s->read_len, __ATOMIC_RELAXED))
+            revents |= POLLIN;
+        if((fds[i].events & POLLOUT) && __atomic_load_n(&s->write_len, __ATOMIC_RELAXED) < s->write_size)
+            revents |= POLLOUT;
+
+        if(!revents) {
+            u32 out = 0;
+            Result rc = sslConnectionPoll(s->c, _sslStreamPollEvents(fds[i].events), &out, num_streams == 1 ? timeout : 0);
+            g_sslStreamResult = rc;
+            revents = R_SUCCEEDED(rc) ? _sslStreamPollRevents(out) & (fds[i].events | POLLERR) : 0;
+        }
+
+        bsd_fds[i].revents = revents;
+        if(revents)
+            ready++;
+    }
+    return ready;
+}
+
+// Called by poll() when SSL streams are involved: bsd_fds holds the bsd sockfds, and -1 for the SSL streams.
+int _sslStreamPoll(struct pollfd *fds, struct pollfd *bsd_fds, nfds_t nfds, int timeout, int (*bsd_poll)(struct pollfd *, nfds_t, int)) {
+    nfds_t num_streams = 0, num_sockets = 0;
+    for(nfds_t i = 0; i < nfds; i++) {
+        if(fds[i].fd < 0)
+            continue;
+        if(bsd_fds[i].fd == -1)
+            num_streams++;
+        else
+            num_sockets++;
+    }
+
+    u64 deadline = timeout < 0 ? UINT64_MAX : armGetSystemTick() + armNsToTicks(timeout * 1000000ULL);
+    int slice = 0;
+    for(;;) {
+        int ready = 0;
+        if(num_sockets) {
+            ready = bsd_poll(bsd_fds, nfds, slice);
+            if(ready == -1)
+                return -1;
+        }
+
+        // This is done after polling the sockets, since that clears the revents of the SSL streams.
+        ready += _sslStreamPollStreams(fds, bsd_fds, nfds, num_sockets ? 0 : num_streams, timeout);
+        if(ready || (!num_sockets && num_streams == 1))
+            return ready; // A lone stream was polled with the full timeout.
+
+        u64 now = armGetSystemTick();
+        if(now >= deadline)
+            return 0;
+
+        u64 remaining = armTicksToNs(deadline - now) / 1000000ULL;
+        slice = remaining < SSL_STREAM_POLL_SLICE_MS ? remaining : SSL_STREAM_POLL_SLICE_MS;
+        if(!slice)
+            slice = 1;
+        if(!num_sockets)
+            svcSleepThread(slice * 1000000ULL);
+    }
+}
@@ -10,6 +10,15 @@
 
 #define TOTAL_INTERFACES 4
 
+typedef struct {
+    u8 *buffers;
+    u32 num_buffers, buffer_size;
+    u32 head, tail; // Free-running: head is the oldest posted URB, tail the next buffer to post.
+    bool head_acquired;
+    u32 urb_ids[USB_COMMS_STREAM_MAX_BUFFERS];
+    u32 sizes[USB_COMMS_STREAM_MAX_BUFFERS];
+} usbCommsStream;
+
 typedef struct {
     RwLock lock, lock_in, lock_out;
     bool initialized;
@@ -18,6 +27,8 @@ typedef struct {
     UsbDsEndpoint *endpoint_in, *endpoint_out;
 
     u8 *endpoint_in_buffer, *endpoint_out_buffer;
+
+    usbCommsStream stream_in, stream_out;
 } usbCommsInterface;
 
 static bool g_usbCommsInitialized = false;
@@ -33,6 +44,7 @@ static Result _usbCommsInterfaceInit5x(u32 intf_ind, const UsbCommsInterfaceInfo
 static Result _usbCommsInterfaceInit(u32 intf_ind, const UsbCommsInterfaceInfo *info);
 
 static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, size_t size, size_t *transferredSize);
+static void _usbCommsStreamFree(usbCommsStream *stream);
 
 static void _usbCommsUpdateInterfaceDescriptor(struct usb_interface_descriptor *desc, const UsbCommsInterfaceInfo *info) {
     if (info != NULL) {
@@ -182,6 +194,9 @@ static void _usbCommsInterfaceFree(usbCommsInterface *interface)
     interface->endpoint_in_buffer = NULL;
     interface->endpoint_out_buffer = NULL;
 
+    _usbCommsStreamFree(&interface->stream_in);
+    _usbCommsStreamFree(&interface->stream_out);
+
     rwlockWriteUnlock(&interface->lock_out);
     rwlockWriteUnlock(&interface->lock_in);
 
@@ -408,6 +423,8 @@ static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t s
     size_t total_transferredSize=0;
     UsbDsReportData reportdata;
 
+    if (interface->stream_out.buffers) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+
     //Makes sure endpoints are ready for data-transfer / wait for init if needed.
     rc = usbDsWaitReady(UINT64_MAX);
     if (R_FAILED(rc)) return rc;
@@ -417,7 +434,6 @@ static Result _usbCommsRead(usbCommsInterface *interface, void* buffer, size_t s
         if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned copy the data into g_usbComms_endpoint_in_buffer and transfer that, otherwise use the bufptr directly.
         {
             transfer_buffer = interface->endpoint_out_buffer;
-            memset(interface->endpoint_out_buffer, 0, 0x1000);
 
             chunksize = 0x1000;
             chunksize-= ((u64)bufptr) & 0xfff;//After this transfer, bufptr will be page-aligned(if size is large enough for another transfer).
@@ -495,6 +511,8 @@ static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, s
     size_t total_transferredSize=0;
     UsbDsReportData reportdata;
 
+    if (interface->stream_in.buffers) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
     //Makes sure endpoints are ready for data-transfer / wait for init if needed.
     rc = usbDsWaitReady(UINT64_MAX);
     if (R_FAILED(rc)) return rc;
@@ -504,7 +522,6 @@ static Result _usbCommsWrite(usbCommsInterface *interface, const void* buffer, s
         if(((u64)bufptr) & 0xfff)//When bufptr isn't page-aligned copy the data into g_usbComms_endpoint_in_buffer and transfer that, otherwise use the bufptr directly.
         {
             transfer_buffer = interface->endpoint_in_buffer;
-            memset(interface->endpoint_in_buffer, 0, 0x1000);
 
             chunksize = 0x1000;
             chunksize-= ((u64)bufptr) & 0xfff;//After this transfer, bufptr will be page-aligned(if size is large enough for another transfer).
@@ -756,3 +773,293 @@ Result usbCommsGetWriteResult(u32 urbId, u32 *transferredSize, u32 interface)
 
     return rc;
 }
+
+static void _usbCommsStreamFree(usbCommsStream *stream)
+{
+    __libnx_free(stream->buffers);
+    memset(stream, 0, sizeof(*stream));
+}
+
+static usbCommsInterface *_usbCommsGetInterface(u32 interface)
+{
+    usbCommsInterface *inter;
+    bool initialized;
+
+    if (interface >= TOTAL_INTERFACES) return NULL;
+    inter = &g_usbCommsInterfaces[interface];
+
+    rwlockReadLock(&inter->lock);
+    initialized = inter->initialized;
+    rwlockReadUnlock(&inter->lock);
+
+    return initialized ? inter : NULL;
+}
+
+static Result _usbCommsStreamInit(usbCommsStream *stream, u32 num_buffers, u32 buffer_size)
+{
+    if (stream->buffers) return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+    if (num_buffers < 2 || num_buffers > USB_COMMS_STREAM_MAX_BUFFERS || !buffer_size || (buffer_size & 0xfff))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    //The buffers for PostBufferAsync commands must be 0x1000-byte aligned.
+    stream->buffers = __libnx_aligned_alloc(0x1000, (size_t)num_buffers * buffer_size);
+    if (stream->buffers == NULL) return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    stream->num_buffers = num_buffers;
+    stream->buffer_size = buffer_size;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->head_acquired = false;
+    return 0;
+}
+
+static Result _usbCommsStreamPost(usbCommsStream *stream, UsbDsEndpoint *endpoint, u32 size)
+{
+    u32 slot = stream->tail % stream->num_buffers;
+    Result rc = usbDsEndpoint_PostBufferAsync(endpoint, stream->buffers + slot*stream->buffer_size, size, &stream->urb_ids[slot]);
+    if (R_SUCCEEDED(rc)) {
+        stream->sizes[slot] = size;
+        stream->tail++;
+    }
+    return rc;
+}
+
+// Waits for the oldest posted URB to complete. The report data holds the last 8 URBs, which always include it since at most USB_COMMS_STREAM_MAX_BUFFERS are posted past it.
+// When completed is set, it receives whether the URB completed (even if the transfer itself failed).
+static Result _usbCommsStreamWaitHead(usbCommsStream *stream, UsbDsEndpoint *endpoint, u32 *transferredSize, u64 timeout, bool *completed)
+{
+    Result rc=0;
+    u32 slot = stream->head % stream->num_buffers;
+    UsbDsReportData reportdata;
+
+    if (completed) *completed = false;
+    for (;;) {
+        rc = usbDsEndpoint_GetReportData(endpoint, &reportdata);
+        if (R_FAILED(rc)) return rc;
+
+        u32 count = reportdata.report_count > 8 ? 8 : reportdata.report_count;
+        for (u32 i = 0; i < count; i++) {
+            UsbDsReportEntry *entry = &reportdata.report[i];
+            if (entry->id == stream->urb_ids[slot] && entry->urb_status >= 0x3) {
+                if (completed) *completed = true;
+                rc = usbDsParseReportData(&reportdata, entry->id, NULL, transferredSize);
+                if (R_SUCCEEDED(rc) && *transferredSize > stream->sizes[slot]) *transferredSize = stream->sizes[slot];
+                return rc;
+            }
+        }
+
+        //Other URBs may complete first, so the event needs to be cleared before checking the reports again.
+        rc = eventWait(&endpoint->CompletionEvent, timeout);
+        if (R_FAILED(rc)) return rc;
+        eventClear(&endpoint->CompletionEvent);
+    }
+}
+
+static void _usbCommsStreamCancel(usbCommsStream *stream, UsbDsEndpoint *endpoint)
+{
+    u32 tmp;
+    bool completed = true;
+
+    if (stream->head != stream->tail) {
+        usbDsEndpoint_Cancel(endpoint);
+        //Like the blocking transfers, wait for the cancelled URBs without a timeout: the hardware may write to the buffers until they complete.
+        while (stream->head != stream->tail) {
+            _usbCommsStreamWaitHead(stream, endpoint, &tmp, UINT64_MAX, &completed);
+            if (!completed) break;
+            stream->head++;
+        }
+    }
+
+    //If the ring couldn't be drained, leak the buffers rather than freeing memory which may still be in use.
+    if (!completed) stream->buffers = NULL;
+    _usbCommsStreamFree(stream);
+}
+
+Result usbCommsReadStreamStart(u32 num_buffers, u32 buffer_size, u32 interface)
+{
+    Result rc;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+
+    rwlockWriteLock(&inter->lock_out);
+
+    rc = _usbCommsStreamInit(&inter->stream_out, num_buffers, buffer_size);
+    if (R_SUCCEEDED(rc)) {
+        //Makes sure endpoints are ready for data-transfer / wait for init if needed.
+        rc = usbDsWaitReady(UINT64_MAX);
+        for (u32 i = 0; R_SUCCEEDED(rc) && i < num_buffers; i++)
+            rc = _usbCommsStreamPost(&inter->stream_out, inter->endpoint_out, buffer_size);
+        if (R_FAILED(rc))
+            _usbCommsStreamCancel(&inter->stream_out, inter->endpoint_out);
+    }
+
+    rwlockWriteUnlock(&inter->lock_out);
+
+    return rc;
+}
+
+Result usbCommsReadStreamGetBuffer(const void **buffer, u32 *size, u64 timeout, u32 interface)
+{
+    Result rc;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+
+    rwlockWriteLock(&inter->lock_out);
+
+    usbCommsStream *stream = &inter->stream_out;
+    if (!stream->buffers || stream->head == stream->tail) {
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+    } else {
+        rc = _usbCommsStreamWaitHead(stream, inter->endpoint_out, size, timeout, NULL);
+        if (R_SUCCEEDED(rc)) {
+            *buffer = stream->buffers + (stream->head % stream->num_buffers)*stream->buffer_size;
+            stream->head_acquired = true;
+        }
+    }
+
+    rwlockWriteUnlock(&inter->lock_out);
+
+    return rc;
+}
+
+Result usbCommsReadStreamReleaseBuffer(u32 interface)
+{
+    Result rc;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+
+    rwlockWriteLock(&inter->lock_out);
+
+    usbCommsStream *stream = &inter->stream_out;
+    if (!stream->buffers || !stream->head_acquired) {
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsRead);
+    } else {
+        stream->head_acquired = false;
+
+        //The released buffer is the one after the last posted one, so it gets posted again right away.
+        stream->head++;
+        rc = _usbCommsStreamPost(stream, inter->endpoint_out, stream->buffer_size);
+    }
+
+    rwlockWriteUnlock(&inter->lock_out);
+
+    return rc;
+}
+
+void usbCommsReadStreamStop(u32 interface)
+{
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return;
+
+    rwlockWriteLock(&inter->lock_out);
+    if (inter->stream_out.buffers)
+        _usbCommsStreamCancel(&inter->stream_out, inter->endpoint_out);
+    rwlockWriteUnlock(&inter->lock_out);
+}
+
+Result usbCommsWriteStreamStart(u32 num_buffers, u32 buffer_size, u32 interface)
+{
+    Result rc;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
+    rwlockWriteLock(&inter->lock_in);
+
+    rc = _usbCommsStreamInit(&inter->stream_in, num_buffers, buffer_size);
+    if (R_SUCCEEDED(rc)) {
+        //Makes sure endpoints are ready for data-transfer / wait for init if needed.
+        rc = usbDsWaitReady(UINT64_MAX);
+        if (R_FAILED(rc))
+            _usbCommsStreamFree(&inter->stream_in);
+    }
+
+    rwlockWriteUnlock(&inter->lock_in);
+
+    return rc;
+}
+
+Result usbCommsWriteStreamGetBuffer(void **buffer, u64 timeout, u32 interface)
+{
+    Result rc=0;
+    u32 tmp;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
+    rwlockWriteLock(&inter->lock_in);
+
+    usbCommsStream *stream = &inter->stream_in;
+    if (!stream->buffers) {
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+    } else {
+        //When every buffer is in flight, recycle the oldest one.
+        if (stream->tail - stream->head == stream->num_buffers) {
+            rc = _usbCommsStreamWaitHead(stream, inter->endpoint_in, &tmp, timeout, NULL);
+            if (R_SUCCEEDED(rc) && tmp < stream->sizes[stream->head % stream->num_buffers])
+                rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+            if (rc != KERNELRESULT(TimedOut))
+                stream->head++;
+        }
+        if (R_SUCCEEDED(rc))
+            *buffer = stream->buffers + (stream->tail % stream->num_buffers)*stream->buffer_size;
+    }
+
+    rwlockWriteUnlock(&inter->lock_in);
+
+    return rc;
+}
+
+Result usbCommsWriteStreamSubmit(u32 size, u32 interface)
+{
+    Result rc;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
+    rwlockWriteLock(&inter->lock_in);
+
+    usbCommsStream *stream = &inter->stream_in;
+    if (!stream->buffers || stream->tail - stream->head == stream->num_buffers || size > stream->buffer_size)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    else
+        rc = _usbCommsStreamPost(stream, inter->endpoint_in, size);
+
+    rwlockWriteUnlock(&inter->lock_in);
+
+    return rc;
+}
+
+Result usbCommsWriteStreamFlush(u64 timeout, u32 interface)
+{
+    Result rc=0;
+    u32 tmp;
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
+    rwlockWriteLock(&inter->lock_in);
+
+    usbCommsStream *stream = &inter->stream_in;
+    if (!stream->buffers)
+        rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+
+    while (R_SUCCEEDED(rc) && stream->head != stream->tail) {
+        rc = _usbCommsStreamWaitHead(stream, inter->endpoint_in, &tmp, timeout, NULL);
+        if (R_SUCCEEDED(rc) && tmp < stream->sizes[stream->head % stream->num_buffers])
+            rc = MAKERESULT(Module_Libnx, LibnxError_BadUsbCommsWrite);
+        if (rc != KERNELRESULT(TimedOut))
+            stream->head++;
+    }
+
+    rwlockWriteUnlock(&inter->lock_in);
+
+    return rc;
+}
+
+void usbCommsWriteStreamStop(u32 interface)
+{
+    usbCommsInterface *inter = _usbCommsGetInterface(interface);
+    if (!inter) return;
+
+    rwlockWriteLock(&inter->lock_in);
+    if (inter->stream_in.buffers)
+        _usbCommsStreamCancel(&inter->stream_in, inter->endpoint_in);
+    rwlockWriteUnlock(&inter->lock_in);
+}
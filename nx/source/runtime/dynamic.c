@@ -1,31 +1,32 @@
 #include "result.h"
+#include "arm/counter.h"
 #include "kernel/svc.h"
 #include "runtime/diag.h"
-#include <elf.h>
+#include "runtime/startup.h"
+#include "dynamic.h"
 #include <string.h>
 
-typedef struct Mod0Header {
-	u32 magic_mod0;
-	s32 dyn_offset;
-	s32 bss_start_offset;
-	s32 bss_end_offset;
-	s32 eh_frame_hdr_start_offset;
-	s32 eh_frame_hdr_end_offset;
-	s32 unused;
-
-	u32 magic_lny0;
-	s32 got_start_offset;
-	s32 got_end_offset;
-
-	u32 magic_lny1;
-	s32 relro_start_offset;
-	s32 relro_end_offset;
-} Mod0Header;
-
-NX_INLINE void* _dynResolveOffset(const Mod0Header* mod0, s32 offset)
-{
-	return (void*)((uintptr_t)mod0 + offset);
-}
+// Everything here runs before relocations are applied: globals must only be accessed directly (static or hidden).
+
+#define DYN_PARALLEL_MIN_RELR       0x2000 // Minimum number of RELR entries worth splitting across threads.
+#define DYN_MAX_RELOC_WORKERS       3
+#define DYN_RELOC_WORKER_STACK_SIZE 0x800
+
+typedef struct {
+	uintptr_t base;
+	const Elf64_Relr* relr;
+	size_t relrsz;
+	u64 count;
+} DynRelrChunk;
+
+// Number of additional threads applying RELR relocations, see startup.h.
+__attribute__((weak, visibility("hidden"))) u32 __nx_dynamic_reloc_threads = 0;
+
+static DynRelrChunk g_dynRelrChunks[DYN_MAX_RELOC_WORKERS + 1];
+static u8 g_dynRelocWorkerStacks[DYN_MAX_RELOC_WORKERS][DYN_RELOC_WORKER_STACK_SIZE] __attribute__((aligned(16)));
+
+void _startupSetPhaseTick(StartupPhase phase, u64 tick);
+void _startupSetRelocationStats(u64 num_relocations, u32 num_threads);
 
 static void _dynProcessRela(uintptr_t base, const Elf64_Rela* rela, size_t relasz)
 {
@@ -49,32 +50,107 @@ static void _dynProcessRela(uintptr_t base, const Elf64_Rela* rela, size_t relas
 	}
 }
 
-static void _dynProcessRelr(uintptr_t base, const Elf64_Relr* relr, size_t relrsz)
+u64 _dynProcessRelr(uintptr_t base, const Elf64_Relr* relr, size_t relrsz)
 {
 	u64* ptr = NULL;
+	u64 count = 0;
 	for (; relrsz--; relr++) {
-		if ((*relr & 1) == 0) {
-			ptr = (u64*)(base + *relr);
+		u64 entry = *relr;
+		if ((entry & 1) == 0) {
+			ptr = (u64*)(base + entry);
 			*ptr++ += base;
+			count++;
 		} else {
-			u64 bitmap = *relr >> 1;
+			u64 bitmap = entry >> 1;
+			// Start fetching the words covered by the next bitmap while this one is applied.
+			__builtin_prefetch(ptr + 63, 1);
+			count += __builtin_popcountll(bitmap);
 			while (bitmap) {
-				unsigned id = __builtin_ffsl(bitmap)-1;
-				bitmap &= ~(1UL << id);
+				unsigned id = __builtin_ctzll(bitmap);
+				bitmap &= bitmap - 1;
 				ptr[id] += base;
 			}
 			ptr += 63;
 		}
 	}
+	return count;
+}
+
+static void NX_NORETURN _dynRelrWorker(DynRelrChunk* chunk)
+{
+	chunk->count = _dynProcessRelr(chunk->base, chunk->relr, chunk->relrsz);
+	svcExitThread();
+}
+
+// Splits a RELR table into chunks which can be applied independently.
+static u32 _dynSplitRelr(uintptr_t base, const Elf64_Relr* relr, size_t relrsz, u32 max_chunks)
+{
+	u32 num_chunks = 0;
+	size_t pos = 0;
+	for (u32 i = 0; i < max_chunks && pos < relrsz; i++) {
+		size_t end = i == max_chunks - 1 ? relrsz : relrsz * (i + 1) / max_chunks;
+		if (end < pos)
+			end = pos;
+
+		// Bitmap entries are relative to the preceding entries, so chunks must start with an address entry.
+		while (end < relrsz && (relr[end] & 1))
+			end++;
+		if (end == pos)
+			continue;
+
+		DynRelrChunk* chunk = &g_dynRelrChunks[num_chunks++];
+		chunk->base = base;
+		chunk->relr = relr + pos;
+		chunk->relrsz = end - pos;
+		chunk->count = 0;
+		pos = end;
+	}
+	return num_chunks;
+}
+
+// Starts worker threads on the other cores for chunks 1..N, returns N.
+static u32 _dynStartRelrWorkers(u32 num_chunks, Handle* handles)
+{
+	u64 core_mask = 0;
+	s32 prio = 0;
+	if (R_FAILED(svcGetInfo(&core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0)))
+		return 0;
+	if (R_FAILED(svcGetThreadPriority(&prio, CUR_THREAD_HANDLE)))
+		return 0;
+	core_mask &= ~(1ULL << svcGetCurrentProcessorNumber());
+
+	u32 num_workers = 0;
+	for (u32 i = 1; i < num_chunks && core_mask; i++) {
+		int core = __builtin_ctzll(core_mask);
+		core_mask &= core_mask - 1;
+
+		Handle handle;
+		void* stack_top = g_dynRelocWorkerStacks[num_workers] + DYN_RELOC_WORKER_STACK_SIZE;
+		Result rc = svcCreateThread(&handle, (void*)_dynRelrWorker, &g_dynRelrChunks[i], stack_top, prio, core);
+		if (R_FAILED(rc))
+			break;
+
+		rc = svcStartThread(handle);
+		if (R_FAILED(rc)) {
+			svcCloseHandle(handle);
+			break;
+		}
+
+		handles[num_workers++] = handle;
+	}
+
+	return num_workers;
 }
 
 void __nx_dynamic(uintptr_t base, const Mod0Header* mod0)
 {
 	// Return early if MOD0 header has been invalidated
-	if (mod0->magic_mod0 != 0x30444f4d) { // MOD0
+	if (mod0->magic_mod0 != MOD0_MAGIC) {
 		return;
 	}
 
+	u64 entry_tick = armGetSystemTick();
+
 	// Clear the BSS area
 	u8* bss_start = _dynResolveOffset(mod0, mod0->bss_start_offset);
 	u8* bss_end = _dynResolveOffset(mod0, mod0->bss_end_offset);
@@ -82,6 +158,8 @@ void __nx_dynamic(uintptr_t base, const Mod0Header* mod0)
 		memset(bss_start, 0, bss_end - bss_start);
 	}
 
+	_startupSetPhaseTick(StartupPhase_Entry, entry_tick);
+
 	// Retrieve pointer to the ELF dynamic section
 	const Elf64_Dyn* dyn = _dynResolveOffset(mod0, mod0->dyn_offset);
 
@@ -110,16 +188,41 @@ void __nx_dynamic(uintptr_t base, const Mod0Header* mod0)
 		}
 	}
 
+	// Large RELR tables can be split across the other cores, while this thread applies the rest
+	u32 num_chunks = 0, num_workers = 0;
+	Handle worker_handles[DYN_MAX_RELOC_WORKERS];
+	if (relr && relrsz >= DYN_PARALLEL_MIN_RELR && __nx_dynamic_reloc_threads) {
+		u32 max_workers = __nx_dynamic_reloc_threads < DYN_MAX_RELOC_WORKERS ? __nx_dynamic_reloc_threads : DYN_MAX_RELOC_WORKERS;
+		num_chunks = _dynSplitRelr(base, relr, relrsz, max_workers + 1);
+		num_workers = _dynStartRelrWorkers(num_chunks, worker_handles);
+	}
+
+	u64 num_relocs = 0;
+
 	// Apply RELA relocations if present
 	if (rela && relasz) {
 		_dynProcessRela(base, rela, relasz);
+		num_relocs += relasz;
 	}
 
 	// Apply RELR relocations if present
-	if (relr && relrsz) {
-		_dynProcessRelr(base, relr, relrsz);
+	if (num_workers) {
+		num_relocs += _dynProcessRelr(base, g_dynRelrChunks[0].relr, g_dynRelrChunks[0].relrsz);
+		for (u32 i = num_workers + 1; i < num_chunks; i++)
+			num_relocs += _dynProcessRelr(base, g_dynRelrChunks[i].relr, g_dynRelrChunks[i].relrsz);
+
+		for (u32 i = 0; i < num_workers; i++) {
+			svcWaitSynchronizationSingle(worker_handles[i], UINT64_MAX);
+			svcCloseHandle(worker_handles[i]);
+			num_relocs += g_dynRelrChunks[i + 1].count;
+		}
+	} else if (relr && relrsz) {
+		num_relocs += _dynProcessRelr(base, relr, relrsz);
 	}
 
+	_startupSetPhaseTick(StartupPhase_RelocationsDone, armGetSystemTick());
+	_startupSetRelocationStats(num_relocs, num_workers + 1);
+
 	// Return early if LNY0/LNY1 extensions are not present
 	if (mod0->magic_lny0 != 0x30594e4c || mod0->magic_lny1 != 0x31594e4c) { // LNY0, LNY1
 		return;
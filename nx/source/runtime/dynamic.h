@@ -0,0 +1,30 @@
+#pragma once
+#include "types.h"
+#include <elf.h>
+
+typedef struct Mod0Header {
+	u32 magic_mod0;
+	s32 dyn_offset;
+	s32 bss_start_offset;
+	s32 bss_end_offset;
+	s32 eh_frame_hdr_start_offset;
+	s32 eh_frame_hdr_end_offset;
+	s32 unused;
+
+	u32 magic_lny0;
+	s32 got_start_offset;
+	s32 got_end_offset;
+
+	u32 magic_lny1;
+	s32 relro_start_offset;
+	s32 relro_end_offset;
+} Mod0Header;
+
+#define MOD0_MAGIC 0x30444f4d // MOD0
+
+NX_INLINE void* _dynResolveOffset(const Mod0Header* mod0, s32 offset)
+{
+	return (void*)((uintptr_t)mod0 + offset);
+}
+
+u64 _dynProcessRelr(uintptr_t base, const Elf64_Relr* relr, size_t relrsz);
@@ -1,4 +1,5 @@
 #include "types.h"
+#include "arm/counter.h"
 #include "runtime/env.h"
 #include "runtime/hosversion.h"
 #include "services/sm.h"
@@ -9,6 +10,7 @@
 #include "services/set.h"
 #include "runtime/diag.h"
 #include "runtime/devices/fs_dev.h"
+#include "runtime/startup.h"
 
 void NX_NORETURN __nx_exit(Result rc, LoaderReturnFn retaddr);
 
@@ -18,6 +20,7 @@ void argvSetup(void);
 void __libnx_init_thread(void);
 void __libnx_init_time(void);
 void __libnx_init_cwd(void);
+void _startupSetPhaseTick(StartupPhase phase, u64 tick);
 
 extern u32 __nx_applet_type;
 
@@ -185,6 +188,8 @@ void __attribute__((weak)) __libnx_init(void* ctx, Handle main_thread, void* sav
     // Call constructors.
     void __libc_init_array(void);
     __libc_init_array();
+
+    _startupSetPhaseTick(StartupPhase_InitDone, armGetSystemTick());
 }
 
 void __attribute__((weak)) NX_NORETURN __libnx_exit(int rc)
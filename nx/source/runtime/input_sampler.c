@@ -0,0 +1,271 @@
+#include <string.h>
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "runtime/input_sampler.h"
+#include "../runtime/alloc.h"
+
+#define INPUT_SAMPLER_DEFAULT_PERIOD_NS 1000000ULL
+#define INPUT_SAMPLER_STACK_SIZE        0x4000
+
+// Styles whose state can be read with hidGetNpadStatesSince, in order of preference
+#define INPUT_SAMPLER_NPAD_STYLES ( \
+    HidNpadStyleTag_NpadFullKey | HidNpadStyleTag_NpadHandheld | HidNpadStyleTag_NpadJoyDual | \
+    HidNpadStyleTag_NpadJoyLeft | HidNpadStyleTag_NpadJoyRight | HidNpadStyleTag_NpadGc | \
+    HidNpadStyleTag_NpadPalma | HidNpadStyleTag_NpadLark | HidNpadStyleTag_NpadHandheldLark | \
+    HidNpadStyleTag_NpadLucia | HidNpadStyleTag_NpadLager | HidNpadStyleTag_NpadSystemExt | \
+    HidNpadStyleTag_NpadSystem)
+
+static inline HidNpadIdType _inputSamplerNpadId(u32 index)
+{
+    return index < 8 ? HidNpadIdType_No1 + index : HidNpadIdType_Handheld;
+}
+
+// Single-producer: only called from the sampler thread
+static void _inputSamplerPush(InputSampler* s, const InputEvent* event)
+{
+    u32 write_pos = s->write_pos;
+    u32 read_pos = __atomic_load_n(&s->read_pos, __ATOMIC_ACQUIRE);
+    if (write_pos - read_pos > s->config.queue_size - 1) {
+        __atomic_fetch_add(&s->dropped_count, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    s->events[write_pos & (s->config.queue_size - 1)] = *event;
+    __atomic_store_n(&s->write_pos, write_pos + 1, __ATOMIC_RELEASE);
+}
+
+static inline void _inputSamplerPushButtons(InputSampler* s, InputEvent* event, InputEventType type, u64 buttons)
+{
+    if (!buttons)
+        return;
+    event->type = type;
+    event->buttons = buttons;
+    _inputSamplerPush(s, event);
+}
+
+static void _inputSamplerPollNpad(InputSampler* s, u32 index, u64 tick)
+{
+    InputSamplerNpad* npad = &s->npads[index];
+    HidNpadIdType id = _inputSamplerNpadId(index);
+    InputEvent event = { .tick = tick, .source = id };
+
+    u32 style_set = hidGetNpadStyleSet(id) & INPUT_SAMPLER_NPAD_STYLES;
+    u32 style = style_set ? BIT(__builtin_ctz(style_set)) : 0;
+    if (style != npad->style) {
+        // Controller changed (or got disconnected): release everything that was held
+        _inputSamplerPushButtons(s, &event, InputEventType_NpadButtonUp, npad->buttons);
+        memset(npad, 0, sizeof(*npad));
+        npad->style = style;
+    }
+    if (!style)
+        return;
+
+    HidNpadCommonState* states = s->scratch->npad;
+    size_t total = hidGetNpadStatesSince(id, style, &npad->cursor, states, 17);
+
+    // States are returned newest first
+    for (size_t i = total; i > 0; i --) {
+        const HidNpadCommonState* state = &states[i-1];
+        event.sampling_number = state->sampling_number;
+
+        u64 buttons = (state->attributes & HidNpadAttribute_IsConnected) ? state->buttons : 0;
+        _inputSamplerPushButtons(s, &event, InputEventType_NpadButtonDown, ~npad->buttons & buttons);
+        _inputSamplerPushButtons(s, &event, InputEventType_NpadButtonUp, npad->buttons & ~buttons);
+        npad->buttons = buttons;
+
+        const HidAnalogStickState* sticks[2] = { &state->analog_stick_l, &state->analog_stick_r };
+        for (u32 j = 0; j < 2; j ++) {
+            s32 dx = sticks[j]->x - npad->sticks[j].x;
+            s32 dy = sticks[j]->y - npad->sticks[j].y;
+            if (dx < 0) dx = -dx;
+            if (dy < 0) dy = -dy;
+            if (dx <= s->config.stick_threshold && dy <= s->config.stick_threshold)
+                continue;
+
+            npad->sticks[j] = *sticks[j];
+            event.type = InputEventType_NpadStick;
+            event.stick.index = j;
+            event.stick.x = sticks[j]->x;
+            event.stick.y = sticks[j]->y;
+            _inputSamplerPush(s, &event);
+        }
+    }
+}
+
+static const HidTouchState* _inputSamplerFindTouch(const HidTouchScreenState* state, u32 finger_id)
+{
+    for (s32 i = 0; i < state->count; i ++)
+        if (state->touches[i].finger_id == finger_id)
+            return &state->touches[i];
+    return NULL;
+}
+
+static void _inputSamplerPollTouchScreen(InputSampler* s, u64 tick)
+{
+    HidTouchScreenState* states = s->scratch->touch_screen;
+    size_t total = hidGetTouchScreenStatesSince(&s->touch_cursor, states, 17);
+    HidTouchScreenState* prev = &s->touch_state;
+    InputEvent event = { .tick = tick };
+
+    for (size_t i = total; i > 0; i --) {
+        const HidTouchScreenState* state = &states[i-1];
+        event.sampling_number = state->sampling_number;
+
+        for (s32 j = 0; j < prev->count; j ++) {
+            const HidTouchState* touch = &prev->touches[j];
+            if (_inputSamplerFindTouch(state, touch->finger_id))
+                continue;
+            event.type = InputEventType_TouchEnd;
+            event.touch.finger_id = touch->finger_id;
+            event.touch.x = touch->x;
+            event.touch.y = touch->y;
+            _inputSamplerPush(s, &event);
+        }
+
+        for (s32 j = 0; j < state->count; j ++) {
+            const HidTouchState* touch = &state->touches[j];
+            const HidTouchState* old = _inputSamplerFindTouch(prev, touch->finger_id);
+            if (old && old->x == touch->x && old->y == touch->y)
+                continue;
+            event.type = old ? InputEventType_TouchMove : InputEventType_TouchBegin;
+            event.touch.finger_id = touch->finger_id;
+            event.touch.x = touch->x;
+            event.touch.y = touch->y;
+            _inputSamplerPush(s, &event);
+        }
+
+        *prev = *state;
+    }
+}
+
+static void _inputSamplerPollKeyboard(InputSampler* s, u64 tick)
+{
+    HidKeyboardState* states = s->scratch->keyboard;
+    size_t total = hidGetKeyboardStatesSince(&s->keyboard_cursor, states, 17);
+    HidKeyboardState* prev = &s->keyboard_state;
+    InputEvent event = { .tick = tick };
+
+    for (size_t i = total; i > 0; i --) {
+        const HidKeyboardState* state = &states[i-1];
+        event.sampling_number = state->sampling_number;
+        event.key.modifiers = state->modifiers;
+
+        for (u32 j = 0; j < 4; j ++) {
+            u64 changed = prev->keys[j] ^ state->keys[j];
+            while (changed) {
+                u32 bit = __builtin_ctzll(changed);
+                changed &= changed - 1;
+                event.type = (state->keys[j] & BITL(bit)) ? InputEventType_KeyDown : InputEventType_KeyUp;
+                event.key.key = j*64 + bit;
+                _inputSamplerPush(s, &event);
+            }
+        }
+
+        *prev = *state;
+    }
+}
+
+static void _inputSamplerPollSixAxis(InputSampler* s, u32 index, u64 tick)
+{
+    HidSixAxisSensorState* states = s->scratch->six_axis;
+    size_t total = hidGetSixAxisSensorStatesSince(s->config.six_axis_sensors[index], &s->six_axis_cursors[index], states, 17);
+    InputEvent event = { .tick = tick, .type = InputEventType_SixAxis, .source = index };
+
+    for (size_t i = total; i > 0; i --) {
+        event.sampling_number = states[i-1].sampling_number;
+        event.six_axis.acceleration = states[i-1].acceleration;
+        event.six_axis.angular_velocity = states[i-1].angular_velocity;
+        _inputSamplerPush(s, &event);
+    }
+}
+
+static void _inputSamplerThreadFunc(void* arg)
+{
+    InputSampler* s = (InputSampler*)arg;
+
+    do {
+        u64 tick = armGetSystemTick();
+
+        for (u32 i = 0; i < 9; i ++)
+            if (s->config.npad_id_mask & BITL(_inputSamplerNpadId(i)))
+                _inputSamplerPollNpad(s, i, tick);
+        if (s->config.touch_screen)
+            _inputSamplerPollTouchScreen(s, tick);
+        if (s->config.keyboard)
+            _inputSamplerPollKeyboard(s, tick);
+        for (u32 i = 0; i < s->config.num_six_axis_sensors; i ++)
+            _inputSamplerPollSixAxis(s, i, tick);
+    } while (!leventWait(&s->exit_event, s->config.period_ns));
+}
+
+Result inputSamplerCreate(InputSampler* s, const InputSamplerConfig* config)
+{
+    if (!config->queue_size || (config->queue_size & (config->queue_size - 1)))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (config->num_six_axis_sensors > INPUT_SAMPLER_MAX_SIX_AXIS_SENSORS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    s->config = *config;
+    if (!s->config.period_ns)
+        s->config.period_ns = INPUT_SAMPLER_DEFAULT_PERIOD_NS;
+    leventInit(&s->exit_event, false, false);
+
+    s->events = (InputEvent*)__libnx_alloc(sizeof(InputEvent) * config->queue_size);
+    s->scratch = (InputSamplerScratch*)__libnx_alloc(sizeof(InputSamplerScratch));
+    if (!s->events || !s->scratch) {
+        __libnx_free(s->events);
+        __libnx_free(s->scratch);
+        s->events = NULL;
+        s->scratch = NULL;
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    Result rc = threadCreate(&s->thread, _inputSamplerThreadFunc, s, NULL, INPUT_SAMPLER_STACK_SIZE, config->prio, config->cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&s->thread);
+        if (R_FAILED(rc))
+            threadClose(&s->thread);
+    }
+
+    if (R_FAILED(rc)) {
+        __libnx_free(s->events);
+        __libnx_free(s->scratch);
+        s->events = NULL;
+        s->scratch = NULL;
+    }
+
+    return rc;
+}
+
+void inputSamplerClose(InputSampler* s)
+{
+    if (!s->events)
+        return;
+
+    leventSignal(&s->exit_event);
+    threadWaitForExit(&s->thread);
+    threadClose(&s->thread);
+
+    __libnx_free(s->events);
+    __libnx_free(s->scratch);
+    s->events = NULL;
+    s->scratch = NULL;
+}
+
+// Single-consumer
+size_t inputSamplerPopEvents(InputSampler* s, InputEvent* events, size_t count)
+{
+    u32 read_pos = s->read_pos;
+    u32 write_pos = __atomic_load_n(&s->write_pos, __ATOMIC_ACQUIRE);
+    size_t total = write_pos - read_pos;
+    if (total > count)
+        total = count;
+
+    for (size_t i = 0; i < total; i ++)
+        events[i] = s->events[(read_pos + i) & (s->config.queue_size - 1)];
+
+    __atomic_store_n(&s->read_pos, read_pos + total, __ATOMIC_RELEASE);
+    return total;
+}
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/iosupport.h>
+#include <sys/socket.h>
+
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
+#include "runtime/nxlink_log.h"
+#include "alloc.h"
+
+#define NXLINK_LOG_DEFAULT_BUFFER_SIZE    0x10000
+#define NXLINK_LOG_DEFAULT_FLUSH_INTERVAL 100000000ULL
+#define NXLINK_LOG_STACK_SIZE             0x10000 // The compressor uses 16 KiB of stack.
+
+int _nxlinkConnectSocket(void);
+
+static ssize_t _nxlinkLogStdoutWrite(struct _reent *r, void *fd, const char *ptr, size_t len);
+static ssize_t _nxlinkLogStderrWrite(struct _reent *r, void *fd, const char *ptr, size_t len);
+
+static const devoptab_t g_nxlinkLogStdoutDotab = {
+    .name    = "nxlog",
+    .write_r = _nxlinkLogStdoutWrite,
+};
+
+static const devoptab_t g_nxlinkLogStderrDotab = {
+    .name    = "nxlog",
+    .write_r = _nxlinkLogStderrWrite,
+};
+
+static struct {
+    Mutex mutex;
+    CondVar writer_cv;  // Signaled when the back buffer got sent.
+    CondVar flusher_cv; // Signaled when the front buffer should be sent.
+    Thread thread;
+    NxlinkLogConfig config;
+    int sock;
+    bool initialized;
+    bool exiting;
+
+    u8 *front;          // Buffer records are written to.
+    u8 *back;           // Buffer being sent by the flusher thread.
+    u8 *compressed;
+    u32 front_size;
+    u64 flush_request;  // Incremented to request the front buffer to be sent.
+    u64 flush_done;     // Value of flush_request when the last send started.
+
+    const devoptab_t *old_stdout;
+    const devoptab_t *old_stderr;
+} g_nxlinkLog;
+
+static __thread u64 g_nxlinkLogThreadId;
+
+static bool _nxlinkLogSend(const void *data, size_t size) {
+    const u8 *pos = (const u8 *)data;
+    while (size) {
+        ssize_t ret = send(g_nxlinkLog.sock, pos, size, 0);
+        if (ret <= 0)
+            return false;
+        pos += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+static void _nxlinkLogSendBlock(const u8 *data, u32 size) {
+    NxlinkLogBlockHeader hdr = {
+        .magic = NXLINK_LOG_BLOCK_MAGIC,
+        .flags = 0,
+        .raw_size = size,
+        .data_size = size,
+    };
+
+    if (g_nxlinkLog.compressed) {
+        size_t comp_size = nxlinkLogCompress(data, size, g_nxlinkLog.compressed, size);
+        if (comp_size) {
+            hdr.flags |= NxlinkLogBlockFlag_Compressed;
+            hdr.data_size = comp_size;
+            data = g_nxlinkLog.compressed;
+        }
+    }
+
+    if (_nxlinkLogSend(&hdr, sizeof(hdr)))
+        _nxlinkLogSend(data, hdr.data_size);
+}
+
+static void _nxlinkLogThreadFunc(void *arg) {
+    mutexLock(&g_nxlinkLog.mutex);
+
+    for (;;) {
+        if (!g_nxlinkLog.exiting && g_nxlinkLog.flush_request == g_nxlinkLog.flush_done) {
+            if (!g_nxlinkLog.front_size) {
+                condvarWait(&g_nxlinkLog.flusher_cv, &g_nxlinkLog.mutex);
+                continue;
+            }
+            // Batch records until the buffer is half full or the flush interval elapsed.
+            if (g_nxlinkLog.front_size < g_nxlinkLog.config.buffer_size / 2)
+                condvarWaitTimeout(&g_nxlinkLog.flusher_cv, &g_nxlinkLog.mutex, g_nxlinkLog.config.flush_interval);
+        }
+
+        u64 flush_request = g_nxlinkLog.flush_request;
+        if (g_nxlinkLog.front_size) {
+            // Swap the buffers, so that records can keep being written while this one is sent.
+            u8 *data = g_nxlinkLog.front;
+            u32 size = g_nxlinkLog.front_size;
+            g_nxlinkLog.front = g_nxlinkLog.back;
+            g_nxlinkLog.front_size = 0;
+            g_nxlinkLog.back = data;
+            mutexUnlock(&g_nxlinkLog.mutex);
+
+            _nxlinkLogSendBlock(data, size);
+
+            mutexLock(&g_nxlinkLog.mutex);
+        }
+
+        g_nxlinkLog.flush_done = flush_request;
+        condvarWakeAll(&g_nxlinkLog.writer_cv);
+
+        if (g_nxlinkLog.exiting && !g_nxlinkLog.front_size)
+            break;
+    }
+
+    mutexUnlock(&g_nxlinkLog.mutex);
+}
+
+Result nxlinkLogInitialize(const NxlinkLogConfig *config) {
+    if (g_nxlinkLog.initialized)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    memset(&g_nxlinkLog, 0, sizeof(g_nxlinkLog));
+    g_nxlinkLog.config = *config;
+    if (!g_nxlinkLog.config.buffer_size)
+        g_nxlinkLog.config.buffer_size = NXLINK_LOG_DEFAULT_BUFFER_SIZE;
+    if (!g_nxlinkLog.config.flush_interval)
+        g_nxlinkLog.config.flush_interval = NXLINK_LOG_DEFAULT_FLUSH_INTERVAL;
+    g_nxlinkLog.config.buffer_size = (g_nxlinkLog.config.buffer_size + 7) & ~7;
+    if (g_nxlinkLog.config.buffer_size < 2*sizeof(NxlinkLogRecordHeader))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u32 size = g_nxlinkLog.config.buffer_size;
+    g_nxlinkLog.front = (u8 *)__libnx_alloc(size * (config->compress ? 3 : 2));
+    if (!g_nxlinkLog.front)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    g_nxlinkLog.back = g_nxlinkLog.front + size;
+    g_nxlinkLog.compressed = config->compress ? g_nxlinkLog.back + size : NULL;
+    u8 *alloc = g_nxlinkLog.front;
+
+    Result rc = 0;
+    g_nxlinkLog.sock = _nxlinkConnectSocket();
+    if (g_nxlinkLog.sock < 0)
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    if (R_SUCCEEDED(rc)) {
+        NxlinkLogStreamHeader hdr = {
+            .magic = NXLINK_LOG_STREAM_MAGIC,
+            .version = NXLINK_LOG_VERSION,
+            .tick_frequency = armGetSystemTickFreq(),
+        };
+        if (!_nxlinkLogSend(&hdr, sizeof(hdr)))
+            rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        rc = threadCreate(&g_nxlinkLog.thread, _nxlinkLogThreadFunc, NULL, NULL, NXLINK_LOG_STACK_SIZE, config->prio, config->cpuid);
+        if (R_SUCCEEDED(rc)) {
+            rc = threadStart(&g_nxlinkLog.thread);
+            if (R_FAILED(rc))
+                threadClose(&g_nxlinkLog.thread);
+        }
+    }
+
+    if (R_FAILED(rc)) {
+        if (g_nxlinkLog.sock >= 0)
+            close(g_nxlinkLog.sock);
+        __libnx_free(alloc);
+        return rc;
+    }
+
+    g_nxlinkLog.initialized = true;
+
+    if (config->redirect_stdout) {
+        fflush(stdout);
+        g_nxlinkLog.old_stdout = devoptab_list[STD_OUT];
+        devoptab_list[STD_OUT] = &g_nxlinkLogStdoutDotab;
+    }
+
+    if (config->redirect_stderr) {
+        fflush(stderr);
+        g_nxlinkLog.old_stderr = devoptab_list[STD_ERR];
+        devoptab_list[STD_ERR] = &g_nxlinkLogStderrDotab;
+    }
+
+    return 0;
+}
+
+void nxlinkLogExit(void) {
+    if (!g_nxlinkLog.initialized)
+        return;
+
+    if (g_nxlinkLog.config.redirect_stdout) {
+        fflush(stdout);
+        devoptab_list[STD_OUT] = g_nxlinkLog.old_stdout;
+    }
+    if (g_nxlinkLog.config.redirect_stderr) {
+        fflush(stderr);
+        devoptab_list[STD_ERR] = g_nxlinkLog.old_stderr;
+    }
+
+    mutexLock(&g_nxlinkLog.mutex);
+    g_nxlinkLog.exiting = true;
+    condvarWakeAll(&g_nxlinkLog.flusher_cv);
+    mutexUnlock(&g_nxlinkLog.mutex);
+
+    threadWaitForExit(&g_nxlinkLog.thread);
+    threadClose(&g_nxlinkLog.thread);
+
+    close(g_nxlinkLog.sock);
+    __libnx_free(g_nxlinkLog.front < g_nxlinkLog.back ? g_nxlinkLog.front : g_nxlinkLog.back);
+    g_nxlinkLog.initialized = false;
+}
+
+void nxlinkLogWrite(NxlinkLogLevel level, const char *msg, size_t size) {
+    if (!g_nxlinkLog.initialized)
+        return;
+
+    NxlinkLogRecordHeader hdr = {
+        .tick = armGetSystemTick(),
+        .level = level,
+    };
+
+    if (!g_nxlinkLogThreadId)
+        svcGetThreadId(&g_nxlinkLogThreadId, CUR_THREAD_HANDLE);
+    hdr.thread_id = g_nxlinkLogThreadId;
+
+    u32 buffer_size = g_nxlinkLog.config.buffer_size;
+    if (size > buffer_size - sizeof(hdr))
+        size = buffer_size - sizeof(hdr);
+    hdr.size = size;
+    u32 record_size = (sizeof(hdr) + size + 7) & ~7;
+
+    mutexLock(&g_nxlinkLog.mutex);
+
+    // Both buffers are full: wait for the flusher thread to free one.
+    while (g_nxlinkLog.front_size + record_size > buffer_size && !g_nxlinkLog.exiting) {
+        if (g_nxlinkLog.flush_request == g_nxlinkLog.flush_done)
+            g_nxlinkLog.flush_request++;
+        condvarWakeOne(&g_nxlinkLog.flusher_cv);
+        condvarWait(&g_nxlinkLog.writer_cv, &g_nxlinkLog.mutex);
+    }
+
+    if (!g_nxlinkLog.exiting) {
+        u32 old_size = g_nxlinkLog.front_size;
+        u8 *pos = g_nxlinkLog.front + old_size;
+        memcpy(pos, &hdr, sizeof(hdr));
+        memcpy(pos + sizeof(hdr), msg, size);
+        memset(pos + sizeof(hdr) + size, 0, record_size - sizeof(hdr) - size);
+        g_nxlinkLog.front_size += record_size;
+
+        u32 half = buffer_size / 2;
+        if (!old_size || (old_size < half && g_nxlinkLog.front_size >= half))
+            condvarWakeOne(&g_nxlinkLog.flusher_cv);
+    }
+
+    mutexUnlock(&g_nxlinkLog.mutex);
+}
+
+void nxlinkLogPrintf(NxlinkLogLevel level, const char *fmt, ...) {
+    char buf[512];
+    va_list va;
+    va_start(va, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, va);
+    va_end(va);
+
+    if (len < 0)
+        return;
+    if (len >= sizeof(buf))
+        len = sizeof(buf) - 1;
+    nxlinkLogWrite(level, buf, len);
+}
+
+void nxlinkLogFlush(void) {
+    if (!g_nxlinkLog.initialized)
+        return;
+
+    mutexLock(&g_nxlinkLog.mutex);
+
+    u64 target = ++g_nxlinkLog.flush_request;
+    condvarWakeOne(&g_nxlinkLog.flusher_cv);
+    while (g_nxlinkLog.flush_done < target && !g_nxlinkLog.exiting)
+        condvarWait(&g_nxlinkLog.writer_cv, &g_nxlinkLog.mutex);
+
+    mutexUnlock(&g_nxlinkLog.mutex);
+}
+
+static ssize_t _nxlinkLogStdoutWrite(struct _reent *r, void *fd, const char *ptr, size_t len) {
+    nxlinkLogWrite(NxlinkLogLevel_Info, ptr, len);
+    return len;
+}
+
+static ssize_t _nxlinkLogStderrWrite(struct _reent *r, void *fd, const char *ptr, size_t len) {
+    nxlinkLogWrite(NxlinkLogLevel_Error, ptr, len);
+    return len;
+}
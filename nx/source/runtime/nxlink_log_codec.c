@@ -0,0 +1,178 @@
+// This file only depends on the C library, so that it can also be built on the host to decode log streams.
+#include <string.h>
+#include <sys/types.h>
+#include "runtime/nxlink_log.h"
+
+#define LZ4_HASH_BITS     12
+#define LZ4_MIN_MATCH     4
+#define LZ4_LAST_LITERALS 5  // The last 5 bytes are always literals.
+#define LZ4_MF_LIMIT      12 // The last match must start at least 12 bytes before the end.
+#define LZ4_MAX_OFFSET    0xFFFF
+
+static inline u32 _lz4Read32(const u8 *p) {
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline u32 _lz4Hash(u32 v) {
+    return (v * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static u8 *_lz4WriteLength(u8 *op, size_t len) {
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = len;
+    return op;
+}
+
+static u8 *_lz4WriteSequence(u8 *op, u8 *oend, const u8 *anchor, size_t lit, u16 offset, size_t match) {
+    if ((size_t)(oend - op) < 1 + lit/255 + 1 + lit + 2 + match/255 + 1)
+        return NULL;
+
+    u8 *token = op++;
+    *token = (lit >= 15 ? 15 : lit) << 4;
+    if (lit >= 15)
+        op = _lz4WriteLength(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    if (offset) {
+        *op++ = offset & 0xFF;
+        *op++ = offset >> 8;
+        *token |= match >= 15 ? 15 : match;
+        if (match >= 15)
+            op = _lz4WriteLength(op, match - 15);
+    }
+
+    return op;
+}
+
+size_t nxlinkLogCompress(const void *src, size_t src_size, void *dst, size_t dst_capacity) {
+    const u8 *base = (const u8 *)src;
+    const u8 *ip = base, *anchor = base, *end = base + src_size;
+    u8 *op = (u8 *)dst, *oend = op + dst_capacity;
+    u32 table[1U << LZ4_HASH_BITS] = {0};
+
+    if (src_size > LZ4_MF_LIMIT) {
+        const u8 *mflimit = end - LZ4_MF_LIMIT;
+        const u8 *matchlimit = end - LZ4_LAST_LITERALS;
+
+        while (ip < mflimit) {
+            u32 seq = _lz4Read32(ip);
+            u32 h = _lz4Hash(seq);
+            const u8 *ref = base + table[h];
+            table[h] = ip - base;
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || _lz4Read32(ref) != seq) {
+                ip++;
+                continue;
+            }
+
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            const u8 *mp = ip + LZ4_MIN_MATCH, *rp = ref + LZ4_MIN_MATCH;
+            while (mp < matchlimit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            op = _lz4WriteSequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip - LZ4_MIN_MATCH);
+            if (!op)
+                return 0;
+            ip = anchor = mp;
+        }
+    }
+
+    op = _lz4WriteSequence(op, oend, anchor, end - anchor, 0, 0);
+    return op ? (size_t)(op - (u8 *)dst) : 0;
+}
+
+ssize_t nxlinkLogDecompress(const void *src, size_t src_size, void *dst, size_t dst_capacity) {
+    const u8 *ip = (const u8 *)src, *iend = ip + src_size;
+    u8 *op = (u8 *)dst, *oend = op + dst_capacity;
+
+    while (ip < iend) {
+        u8 token = *ip++;
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            u8 b;
+            do {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+
+        if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit)
+            return -1;
+        memcpy(op, ip, lit);
+        ip += lit;
+        op += lit;
+
+        if (ip == iend)
+            break; // The last sequence only has literals.
+
+        if (iend - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (u8 *)dst))
+            return -1;
+
+        size_t match = token & 15;
+        if (match == 15) {
+            u8 b;
+            do {
+                if (ip >= iend)
+                    return -1;
+                b = *ip++;
+                match += b;
+            } while (b == 255);
+        }
+        match += LZ4_MIN_MATCH;
+
+        if ((size_t)(oend - op) < match)
+            return -1;
+        const u8 *mp = op - offset;
+        while (match--)
+            *op++ = *mp++; // Matches can overlap their output.
+    }
+
+    return op - (u8 *)dst;
+}
+
+ssize_t nxlinkLogDecodeBlock(const NxlinkLogBlockHeader *hdr, const void *data, void *out, size_t out_size) {
+    if (hdr->magic != NXLINK_LOG_BLOCK_MAGIC || hdr->raw_size > out_size)
+        return -1;
+
+    if (!(hdr->flags & NxlinkLogBlockFlag_Compressed)) {
+        if (hdr->data_size != hdr->raw_size)
+            return -1;
+        memcpy(out, data, hdr->raw_size);
+        return hdr->raw_size;
+    }
+
+    ssize_t ret = nxlinkLogDecompress(data, hdr->data_size, out, hdr->raw_size);
+    return ret == (ssize_t)hdr->raw_size ? ret : -1;
+}
+
+const NxlinkLogRecordHeader *nxlinkLogNextRecord(const void *data, size_t size, size_t *offset, const char **msg) {
+    NxlinkLogRecordHeader *hdr;
+    if (*offset > size || size - *offset < sizeof(*hdr))
+        return NULL;
+
+    hdr = (NxlinkLogRecordHeader *)((u8 *)data + *offset);
+    if (hdr->size > size - *offset - sizeof(*hdr))
+        return NULL;
+
+    *msg = (const char *)(hdr + 1);
+    *offset += (sizeof(*hdr) + hdr->size + 7) & ~7; // Records are 8-byte aligned.
+    if (*offset > size)
+        *offset = size;
+    return hdr;
+}
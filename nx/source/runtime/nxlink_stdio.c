@@ -12,7 +12,8 @@
 
 static int sock = -1;
 
-int nxlinkConnectToHost(bool redirStdout, bool redirStderr)
+// Also used by the binary log channel.
+int _nxlinkConnectSocket(void)
 {
     if (!__nxlink_host.s_addr) {
         errno = ENETUNREACH;
@@ -21,20 +22,20 @@ int nxlinkConnectToHost(bool redirStdout, bool redirStderr)
 
     struct sockaddr_in srv_addr;
 
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
         return -1;
     }
 
     // set to non-blocking
-    int flags = fcntl(sock, F_GETFL, 0);
+    int flags = fcntl(fd, F_GETFL, 0);
     if (flags == -1) {
-        close(sock);
+        close(fd);
         return -1;
     }
 
-    if (fcntl(sock, F_SETFL, flags | O_NONBLOCK) != 0) {
-        close(sock);
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+        close(fd);
         return -1;
     }
 
@@ -43,37 +44,47 @@ int nxlinkConnectToHost(bool redirStdout, bool redirStderr)
     srv_addr.sin_addr = __nxlink_host;
     srv_addr.sin_port = htons(NXLINK_CLIENT_PORT);
 
-    int ret = connect(sock, (struct sockaddr *) &srv_addr, sizeof(srv_addr));
+    int ret = connect(fd, (struct sockaddr *) &srv_addr, sizeof(srv_addr));
     if (ret != 0 && errno != EINPROGRESS) {
         int err = errno;
-        close(sock);
-        close(err);
+        close(fd);
+        errno = err;
         return -1;
     }
 
     if (ret != 0) { // EINPROGRESS
         struct pollfd pfd;
 
-        pfd.fd      = sock;
+        pfd.fd      = fd;
         pfd.events  = POLLOUT;
         pfd.revents = 0;
 
         int n = poll(&pfd, 1, 1000); // only wait up to 1s to connect
         if (n < 0) {
-            close(sock);
+            close(fd);
             return -1;
         }
 
         if (n == 0 || !(pfd.revents & POLLOUT)) {
-            close(sock);
+            close(fd);
             errno = ETIMEDOUT;
             return -1;
         }
     }
 
     // reset back to blocking
-    if (fcntl(sock, F_SETFL, flags & ~O_NONBLOCK) != 0) {
-        close(sock);
+    if (fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int nxlinkConnectToHost(bool redirStdout, bool redirStderr)
+{
+    sock = _nxlinkConnectSocket();
+    if (sock < 0) {
         return -1;
     }
 
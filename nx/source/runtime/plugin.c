@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <string.h>
+#include "result.h"
+#include "kernel/mutex.h"
+#include "services/ro.h"
+#include "runtime/diag.h"
+#include "runtime/plugin.h"
+#include "nro.h"
+#include "alloc.h"
+#include "dynamic.h"
+
+typedef struct {
+    uintptr_t base;
+    const Elf64_Sym* symtab;
+    const char* strtab;
+    const u32* gnu_hash;
+    const u32* hash;
+} PluginSymbols;
+
+typedef struct {
+    const Elf64_Rela* rela;
+    size_t rela_count;
+    const Elf64_Relr* relr;
+    size_t relr_count;
+    const Elf64_Rela* jmprel;
+    size_t jmprel_count;
+    u64* pltgot;
+    bool bind_now;
+    void (*init)(void);
+    void (**init_array)(void);
+    size_t init_array_count;
+    void (*fini)(void);
+    void (**fini_array)(void);
+    size_t fini_array_count;
+} PluginDynamic;
+
+typedef struct PluginNrr PluginNrr;
+struct PluginNrr {
+    PluginNrr* next;
+    void* data;
+};
+
+struct Plugin {
+    Plugin* next;
+    u32 refcount;
+    u32 flags;
+    PluginSymbols syms;
+    PluginDynamic dyn;
+    void* nro;
+    void* bss;
+    u64 map_address;
+    u8 build_id[0x20];
+};
+
+extern u8 _start[];
+extern const Mod0Header __nx_mod0;
+
+void __nx_plugin_lazy_trampoline(void);
+uintptr_t _pluginLazyResolve(Plugin* p, u64* got_entry);
+
+static RMutex g_pluginMutex;
+static bool g_pluginInitialized;
+static PluginSymbols g_pluginMainSyms;
+static Plugin* g_pluginList; // In loading order.
+static PluginNrr* g_pluginNrrList;
+
+static bool _pluginParseDynamic(uintptr_t base, const Mod0Header* mod0, PluginSymbols* syms, PluginDynamic* d)
+{
+    if (mod0->magic_mod0 != MOD0_MAGIC)
+        return false;
+
+    memset(syms, 0, sizeof(*syms));
+    memset(d, 0, sizeof(*d));
+    syms->base = base;
+
+    for (const Elf64_Dyn* dyn = _dynResolveOffset(mod0, mod0->dyn_offset); dyn->d_tag != DT_NULL; dyn++) {
+        void* ptr = (void*)(base + dyn->d_un.d_ptr);
+        switch (dyn->d_tag) {
+            case DT_SYMTAB:          syms->symtab = (const Elf64_Sym*)ptr; break;
+            case DT_STRTAB:          syms->strtab = (const char*)ptr; break;
+            case DT_GNU_HASH:        syms->gnu_hash = (const u32*)ptr; break;
+            case DT_HASH:            syms->hash = (const u32*)ptr; break;
+            case DT_RELA:            d->rela = (const Elf64_Rela*)ptr; break;
+            case DT_RELASZ:          d->rela_count = dyn->d_un.d_val / sizeof(Elf64_Rela); break;
+            case DT_RELR:            d->relr = (const Elf64_Relr*)ptr; break;
+            case DT_RELRSZ:          d->relr_count = dyn->d_un.d_val / sizeof(Elf64_Relr); break;
+            case DT_JMPREL:          d->jmprel = (const Elf64_Rela*)ptr; break;
+            case DT_PLTRELSZ:        d->jmprel_count = dyn->d_un.d_val / sizeof(Elf64_Rela); break;
+            case DT_PLTGOT:          d->pltgot = (u64*)ptr; break;
+            case DT_BIND_NOW:        d->bind_now = true; break;
+            case DT_FLAGS:           d->bind_now |= (dyn->d_un.d_val & DF_BIND_NOW) != 0; break;
+            case DT_FLAGS_1:         d->bind_now |= (dyn->d_un.d_val & DF_1_NOW) != 0; break;
+            case DT_INIT:            d->init = (void (*)(void))ptr; break;
+            case DT_INIT_ARRAY:      d->init_array = (void (**)(void))ptr; break;
+            case DT_INIT_ARRAYSZ:    d->init_array_count = dyn->d_un.d_val / sizeof(void*); break;
+            case DT_FINI:            d->fini = (void (*)(void))ptr; break;
+            case DT_FINI_ARRAY:      d->fini_array = (void (**)(void))ptr; break;
+            case DT_FINI_ARRAYSZ:    d->fini_array_count = dyn->d_un.d_val / sizeof(void*); break;
+        }
+    }
+
+    return syms->symtab && syms->strtab;
+}
+
+static u32 _pluginGnuHash(const char* name)
+{
+    u32 h = 5381;
+    for (; *name; name++)
+        h = h * 33 + (u8)*name;
+    return h;
+}
+
+static u32 _pluginSysvHash(const char* name)
+{
+    u32 h = 0;
+    for (; *name; name++) {
+        h = (h << 4) + (u8)*name;
+        h ^= (h >> 24) & 0xF0;
+    }
+    return h & 0x0FFFFFFF;
+}
+
+static bool _pluginSymbolMatches(const PluginSymbols* m, u32 index, const char* name)
+{
+    const Elf64_Sym* sym = &m->symtab[index];
+    if (sym->st_shndx == SHN_UNDEF || ELF64_ST_BIND(sym->st_info) == STB_LOCAL || ELF64_ST_TYPE(sym->st_info) == STT_TLS)
+        return false;
+    return strcmp(m->strtab + sym->st_name, name) == 0;
+}
+
+static const Elf64_Sym* _pluginLookup(const PluginSymbols* m, const char* name, u32 gnu_h)
+{
+    if (m->gnu_hash) {
+        u32 nbuckets = m->gnu_hash[0];
+        u32 symoffset = m->gnu_hash[1];
+        u32 bloom_size = m->gnu_hash[2];
+        u32 bloom_shift = m->gnu_hash[3];
+        const u64* bloom = (const u64*)&m->gnu_hash[4];
+        const u32* buckets = (const u32*)&bloom[bloom_size];
+        const u32* chain = &buckets[nbuckets];
+
+        // The bloom filter rejects most of the symbols which aren't defined by this module.
+        u64 word = bloom[(gnu_h / 64) % bloom_size];
+        u64 mask = (1ULL << (gnu_h % 64)) | (1ULL << ((gnu_h >> bloom_shift) % 64));
+        if ((word & mask) != mask)
+            return NULL;
+
+        u32 index = buckets[gnu_h % nbuckets];
+        if (index < symoffset)
+            return NULL;
+
+        for (;; index++) {
+            u32 h = chain[index - symoffset];
+            if ((h | 1) == (gnu_h | 1) && _pluginSymbolMatches(m, index, name))
+                return &m->symtab[index];
+            if (h & 1)
+                break;
+        }
+    }
+    else if (m->hash) {
+        u32 nbuckets = m->hash[0];
+        const u32* buckets = &m->hash[2];
+        const u32* chain = &buckets[nbuckets];
+
+        for (u32 index = buckets[_pluginSysvHash(name) % nbuckets]; index; index = chain[index])
+            if (_pluginSymbolMatches(m, index, name))
+                return &m->symtab[index];
+    }
+
+    return NULL;
+}
+
+static bool _pluginLookupGlobal(Plugin* self, const char* name, uintptr_t* out)
+{
+    u32 gnu_h = _pluginGnuHash(name);
+    const Elf64_Sym* sym = _pluginLookup(&g_pluginMainSyms, name, gnu_h);
+    if (sym) {
+        *out = g_pluginMainSyms.base + sym->st_value;
+        return true;
+    }
+
+    for (Plugin* p = g_pluginList; p; p = p->next) {
+        if (p == self || !(p->flags & PluginFlag_Global))
+            continue;
+        sym = _pluginLookup(&p->syms, name, gnu_h);
+        if (sym) {
+            *out = p->syms.base + sym->st_value;
+            return true;
+        }
+    }
+
+    if (self) {
+        sym = _pluginLookup(&self->syms, name, gnu_h);
+        if (sym) {
+            *out = self->syms.base + sym->st_value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool _pluginResolveSymbol(Plugin* p, u32 index, uintptr_t* out)
+{
+    if (!index) {
+        *out = 0;
+        return true;
+    }
+
+    // Local and non-default visibility symbols always bind to the module itself.
+    const Elf64_Sym* sym = &p->syms.symtab[index];
+    if (sym->st_shndx != SHN_UNDEF && (ELF64_ST_BIND(sym->st_info) == STB_LOCAL || ELF64_ST_VISIBILITY(sym->st_other) != STV_DEFAULT)) {
+        *out = p->syms.base + sym->st_value;
+        return true;
+    }
+
+    if (_pluginLookupGlobal(p, p->syms.strtab + sym->st_name, out))
+        return true;
+
+    if (ELF64_ST_BIND(sym->st_info) == STB_WEAK) {
+        *out = 0;
+        return true;
+    }
+
+    return false;
+}
+
+static Result _pluginRelocate(Plugin* p, const Elf64_Rela* rela, size_t count, bool lazy)
+{
+    uintptr_t base = p->syms.base;
+
+    for (; count--; rela++) {
+        u64* ptr = (u64*)(base + rela->r_offset);
+        uintptr_t value;
+
+        switch (ELF64_R_TYPE(rela->r_info)) {
+            default:
+                return MAKERESULT(Module_Libnx, LibnxError_BadReloc);
+
+            case R_AARCH64_NONE:
+                break;
+
+            case R_AARCH64_RELATIVE:
+                *ptr = base + rela->r_addend;
+                break;
+
+            case R_AARCH64_JUMP_SLOT:
+                if (lazy) {
+                    // The .got.plt entry points to the PLT header, which calls the lazy binding trampoline.
+                    *ptr += base;
+                    break;
+                }
+                // fallthrough
+
+            case R_AARCH64_GLOB_DAT:
+            case R_AARCH64_ABS64:
+                if (!_pluginResolveSymbol(p, ELF64_R_SYM(rela->r_info), &value))
+                    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+                *ptr = value + rela->r_addend;
+                break;
+        }
+    }
+
+    return 0;
+}
+
+uintptr_t _pluginLazyResolve(Plugin* p, u64* got_entry)
+{
+    uintptr_t offset = (uintptr_t)got_entry - p->syms.base;
+    const Elf64_Rela* rela = NULL;
+
+    // .got.plt entries normally follow the order of the PLT relocations, after the 3 reserved entries.
+    size_t index = got_entry - (p->dyn.pltgot + 3);
+    if (index < p->dyn.jmprel_count && p->dyn.jmprel[index].r_offset == offset)
+        rela = &p->dyn.jmprel[index];
+    else {
+        for (index = 0; index < p->dyn.jmprel_count; index++) {
+            if (p->dyn.jmprel[index].r_offset == offset) {
+                rela = &p->dyn.jmprel[index];
+                break;
+            }
+        }
+    }
+
+    uintptr_t value = 0;
+    rmutexLock(&g_pluginMutex);
+    bool found = rela && _pluginResolveSymbol(p, ELF64_R_SYM(rela->r_info), &value);
+    rmutexUnlock(&g_pluginMutex);
+
+    if (!found)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_NotFound));
+
+    value += rela->r_addend;
+    __atomic_store_n(got_entry, value, __ATOMIC_RELAXED);
+    return value;
+}
+
+static Result _pluginReadFile(const char* path, void** out, size_t* out_size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    Result rc = 0;
+    void* data = NULL;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0)
+        size = ftell(f);
+    if (size <= 0 || fseek(f, 0, SEEK_SET) != 0)
+        rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    // ro requires page-aligned buffers.
+    size_t aligned_size = (size + 0xFFF) &~ 0xFFF;
+    if (R_SUCCEEDED(rc)) {
+        data = __libnx_aligned_alloc(0x1000, aligned_size);
+        if (!data)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        if (fread(data, 1, size, f) != (size_t)size)
+            rc = MAKERESULT(Module_Libnx, LibnxError_IoError);
+        else
+            memset((u8*)data + size, 0, aligned_size - size);
+    }
+
+    fclose(f);
+
+    if (R_FAILED(rc)) {
+        __libnx_free(data);
+        return rc;
+    }
+
+    *out = data;
+    *out_size = aligned_size;
+    return 0;
+}
+
+static Result _pluginUnload(Plugin* p)
+{
+    for (size_t i = p->dyn.fini_array_count; i > 0; i--)
+        p->dyn.fini_array[i-1]();
+    if (p->dyn.fini)
+        p->dyn.fini();
+
+    for (Plugin** link = &g_pluginList; *link; link = &(*link)->next) {
+        if (*link == p) {
+            *link = p->next;
+            break;
+        }
+    }
+
+    Result rc = ldrRoUnloadNro(p->map_address);
+
+    // The buffers stay mapped to the module if it couldn't be unloaded.
+    if (R_SUCCEEDED(rc)) {
+        __libnx_free(p->nro);
+        __libnx_free(p->bss);
+        __libnx_free(p);
+    }
+
+    return rc;
+}
+
+Result pluginInitialize(void)
+{
+    rmutexLock(&g_pluginMutex);
+
+    Result rc = 0;
+    if (g_pluginInitialized)
+        rc = MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    if (R_SUCCEEDED(rc))
+        rc = ldrRoInitialize();
+
+    if (R_SUCCEEDED(rc)) {
+        PluginDynamic dyn;
+        if (!_pluginParseDynamic((uintptr_t)_start, &__nx_mod0, &g_pluginMainSyms, &dyn))
+            memset(&g_pluginMainSyms, 0, sizeof(g_pluginMainSyms));
+        g_pluginInitialized = true;
+    }
+
+    rmutexUnlock(&g_pluginMutex);
+    return rc;
+}
+
+void pluginExit(void)
+{
+    rmutexLock(&g_pluginMutex);
+
+    if (g_pluginInitialized) {
+        // Unload in reverse loading order.
+        while (g_pluginList) {
+            Plugin* last = g_pluginList;
+            while (last->next)
+                last = last->next;
+            _pluginUnload(last);
+        }
+
+        while (g_pluginNrrList) {
+            PluginNrr* nrr = g_pluginNrrList;
+            g_pluginNrrList = nrr->next;
+            if (R_SUCCEEDED(ldrRoUnloadNrr((u64)nrr->data)))
+                __libnx_free(nrr->data);
+            __libnx_free(nrr);
+        }
+
+        ldrRoExit();
+        g_pluginInitialized = false;
+    }
+
+    rmutexUnlock(&g_pluginMutex);
+}
+
+Result pluginRegisterNrr(const char* path)
+{
+    if (!g_pluginInitialized)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    PluginNrr* nrr = (PluginNrr*)__libnx_alloc(sizeof(PluginNrr));
+    if (!nrr)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    size_t size = 0;
+    Result rc = _pluginReadFile(path, &nrr->data, &size);
+    if (R_SUCCEEDED(rc)) {
+        rc = ldrRoLoadNrr((u64)nrr->data, size);
+        if (R_FAILED(rc))
+            __libnx_free(nrr->data);
+    }
+
+    if (R_FAILED(rc)) {
+        __libnx_free(nrr);
+        return rc;
+    }
+
+    rmutexLock(&g_pluginMutex);
+    nrr->next = g_pluginNrrList;
+    g_pluginNrrList = nrr;
+    rmutexUnlock(&g_pluginMutex);
+    return 0;
+}
+
+Result pluginOpen(Plugin** out, const char* path, u32 flags)
+{
+    if (!g_pluginInitialized)
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    void* nro = NULL;
+    size_t nro_size = 0;
+    Result rc = _pluginReadFile(path, &nro, &nro_size);
+    if (R_FAILED(rc))
+        return rc;
+
+    // The NRO buffer isn't accessible anymore once loaded, so grab what's needed from the header beforehand.
+    const NroStart* start = (const NroStart*)nro;
+    const NroHeader* header = (const NroHeader*)(start + 1);
+    if (nro_size < sizeof(NroStart) + sizeof(NroHeader) || header->magic != NROHEADER_MAGIC
+        || header->size > nro_size || (header->size & 0xFFF) || start->mod_offset > header->size - sizeof(Mod0Header)) {
+        __libnx_free(nro);
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    }
+
+    u32 mod_offset = start->mod_offset;
+    u64 load_size = header->size;
+    size_t bss_size = (header->bss_size + 0xFFF) &~ 0xFFF;
+
+    rmutexLock(&g_pluginMutex);
+
+    for (Plugin* p = g_pluginList; p; p = p->next) {
+        if (memcmp(p->build_id, header->build_id, sizeof(p->build_id)) == 0) {
+            p->refcount++;
+            p->flags |= flags & PluginFlag_Global;
+            rmutexUnlock(&g_pluginMutex);
+            __libnx_free(nro);
+            *out = p;
+            return 0;
+        }
+    }
+
+    Plugin* p = (Plugin*)__libnx_alloc(sizeof(Plugin));
+    if (!p)
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    if (R_SUCCEEDED(rc)) {
+        memset(p, 0, sizeof(*p));
+        p->refcount = 1;
+        p->flags = flags;
+        p->nro = nro;
+        memcpy(p->build_id, header->build_id, sizeof(p->build_id));
+
+        if (bss_size) {
+            p->bss = __libnx_aligned_alloc(0x1000, bss_size);
+            if (!p->bss)
+                rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+            else
+                memset(p->bss, 0, bss_size);
+        }
+    }
+
+    if (R_SUCCEEDED(rc))
+        rc = ldrRoLoadNro(&p->map_address, (u64)nro, load_size, (u64)p->bss, bss_size);
+
+    bool loaded = R_SUCCEEDED(rc);
+    const Mod0Header* mod0 = NULL;
+    if (R_SUCCEEDED(rc)) {
+        mod0 = (const Mod0Header*)(p->map_address + mod_offset);
+        if (!_pluginParseDynamic(p->map_address, mod0, &p->syms, &p->dyn))
+            rc = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        u8* bss_start = _dynResolveOffset(mod0, mod0->bss_start_offset);
+        u8* bss_end = _dynResolveOffset(mod0, mod0->bss_end_offset);
+        if (bss_start != bss_end)
+            memset(bss_start, 0, bss_end - bss_start);
+
+        if (p->dyn.relr && p->dyn.relr_count)
+            _dynProcessRelr(p->syms.base, p->dyn.relr, p->dyn.relr_count);
+        if (p->dyn.rela && p->dyn.rela_count)
+            rc = _pluginRelocate(p, p->dyn.rela, p->dyn.rela_count, false);
+    }
+
+    if (R_SUCCEEDED(rc) && p->dyn.jmprel && p->dyn.jmprel_count) {
+        bool lazy = !(flags & PluginFlag_Now) && !p->dyn.bind_now && p->dyn.pltgot;
+        if (lazy) {
+            p->dyn.pltgot[1] = (u64)p;
+            p->dyn.pltgot[2] = (u64)__nx_plugin_lazy_trampoline;
+        }
+        rc = _pluginRelocate(p, p->dyn.jmprel, p->dyn.jmprel_count, lazy);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        Plugin** link = &g_pluginList;
+        while (*link)
+            link = &(*link)->next;
+        *link = p;
+
+        if (p->dyn.init)
+            p->dyn.init();
+        for (size_t i = 0; i < p->dyn.init_array_count; i++)
+            p->dyn.init_array[i]();
+
+        *out = p;
+    }
+    else {
+        // The buffers stay mapped to the module if it couldn't be unloaded.
+        bool mapped = loaded && R_FAILED(ldrRoUnloadNro(p->map_address));
+        if (!mapped) {
+            __libnx_free(nro);
+            if (p) {
+                __libnx_free(p->bss);
+                __libnx_free(p);
+            }
+        }
+    }
+
+    rmutexUnlock(&g_pluginMutex);
+    return rc;
+}
+
+void* pluginGetSymbol(Plugin* p, const char* name)
+{
+    uintptr_t addr = 0;
+    rmutexLock(&g_pluginMutex);
+
+    if (p) {
+        const Elf64_Sym* sym = _pluginLookup(&p->syms, name, _pluginGnuHash(name));
+        if (sym)
+            addr = p->syms.base + sym->st_value;
+    }
+    else if (!_pluginLookupGlobal(NULL, name, &addr))
+        addr = 0;
+
+    rmutexUnlock(&g_pluginMutex);
+    return (void*)addr;
+}
+
+Result pluginClose(Plugin* p)
+{
+    Result rc = 0;
+    rmutexLock(&g_pluginMutex);
+
+    if (!--p->refcount)
+        rc = _pluginUnload(p);
+
+    rmutexUnlock(&g_pluginMutex);
+    return rc;
+}
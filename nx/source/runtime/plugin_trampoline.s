@@ -0,0 +1,58 @@
+.macro CODE_BEGIN name
+	.section .text.\name, "ax", %progbits
+	.global \name
+	.type \name, %function
+	.align 2
+	.cfi_startproc
+\name:
+.endm
+
+.macro CODE_END
+	.cfi_endproc
+.endm
+
+// Lazy binding entry, reached through the PLT header of a plugin:
+//   x16 = &.got.plt[2], [sp] = &.got.plt[n] (pushed x16), [sp+8] = caller x30
+// .got.plt[1] holds the Plugin object.
+CODE_BEGIN __nx_plugin_lazy_trampoline
+	// The PLT header pushed x16 and x30, so the CFA is 16 bytes above sp
+	.cfi_def_cfa_offset 16
+	.cfi_offset x30, -8
+
+	// Preserve the argument registers of the actual call
+	sub  sp, sp, #0xD0
+	.cfi_adjust_cfa_offset 0xD0
+	stp  x0, x1, [sp, #0x00]
+	stp  x2, x3, [sp, #0x10]
+	stp  x4, x5, [sp, #0x20]
+	stp  x6, x7, [sp, #0x30]
+	str  x8,     [sp, #0x40]
+	stp  q0, q1, [sp, #0x50]
+	stp  q2, q3, [sp, #0x70]
+	stp  q4, q5, [sp, #0x90]
+	stp  q6, q7, [sp, #0xB0]
+
+	// x0 = _pluginLazyResolve(plugin, got_entry)
+	ldur x0, [x16, #-8]
+	ldr  x1, [sp, #0xD0]
+	bl   _pluginLazyResolve
+	mov  x17, x0
+
+	ldp  x0, x1, [sp, #0x00]
+	ldp  x2, x3, [sp, #0x10]
+	ldp  x4, x5, [sp, #0x20]
+	ldp  x6, x7, [sp, #0x30]
+	ldr  x8,     [sp, #0x40]
+	ldp  q0, q1, [sp, #0x50]
+	ldp  q2, q3, [sp, #0x70]
+	ldp  q4, q5, [sp, #0x90]
+	ldp  q6, q7, [sp, #0xB0]
+	add  sp, sp, #0xD0
+	.cfi_adjust_cfa_offset -0xD0
+
+	// Pop the registers pushed by the PLT header and jump to the resolved function
+	ldp  x16, x30, [sp], #16
+	.cfi_adjust_cfa_offset -16
+	.cfi_restore x30
+	br   x17
+CODE_END
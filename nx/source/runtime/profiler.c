@@ -0,0 +1,387 @@
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "runtime/profiler.h"
+#include "../runtime/alloc.h"
+
+#define PROFILER_DEFAULT_PERIOD_NS  1000000ULL
+#define PROFILER_DEFAULT_MAX_STACKS 4096
+#define PROFILER_STACK_SIZE         0x4000
+
+extern char _start[];
+extern char __nx_mod0[];
+
+typedef struct {
+    u64 addr;
+    u64 size;
+    const char* name;
+} ProfilerSymbol;
+
+typedef struct {
+    ProfilerSymbol* syms;
+    size_t count;
+    uintptr_t base;
+} ProfilerSymbolTable;
+
+typedef struct {
+    u64 key;
+    u64 count;
+} ProfilerHistogramEntry;
+
+static u32 _profilerHashStack(const u64* frames, u32 depth)
+{
+    u64 hash = 0xcbf29ce484222325ULL;
+    for (u32 i = 0; i < depth; i ++) {
+        hash ^= frames[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return (u32)(hash ^ (hash >> 32));
+}
+
+static void _profilerRecord(Profiler* p, const u64* frames, u32 depth)
+{
+    u32 mask = p->config.max_stacks - 1;
+    u32 idx = _profilerHashStack(frames, depth) & mask;
+
+    p->num_samples++;
+    for (u32 i = 0; i <= mask; i ++, idx = (idx + 1) & mask) {
+        ProfilerStack* s = &p->stacks[idx];
+        if (!s->count) {
+            s->count = 1;
+            s->depth = depth;
+            memcpy(s->frames, frames, depth * sizeof(u64));
+            return;
+        }
+        if (s->depth == depth && memcmp(s->frames, frames, depth * sizeof(u64)) == 0) {
+            s->count++;
+            return;
+        }
+    }
+
+    p->dropped_samples++;
+}
+
+static inline bool _profilerIsValidFrame(u64 fp, u64 prev_fp, u64 stack_lo, u64 stack_hi)
+{
+    return fp > prev_fp && !(fp & 0xF) && fp >= stack_lo && fp + 16 <= stack_hi;
+}
+
+// Called with the target thread paused: must not allocate or take locks.
+static void _profilerSampleThread(Profiler* p, Thread* t)
+{
+    ThreadContext ctx;
+    u64 frames[PROFILER_MAX_DEPTH];
+    u32 depth = 0;
+
+    if (R_FAILED(threadPause(t)))
+        return;
+
+    if (R_SUCCEEDED(threadDumpContext(&ctx, t)) && threadContextIsAArch64(&ctx)) {
+        u64 stack_lo = (u64)t->stack_mirror;
+        u64 stack_hi = stack_lo + t->stack_sz;
+        u64 fp = ctx.fp;
+
+        frames[depth++] = ctx.pc.x;
+        if (!_profilerIsValidFrame(fp, 0, stack_lo, stack_hi)) {
+            // No usable frame chain, the link register is the best we have.
+            frames[depth++] = ctx.lr;
+        } else {
+            // Frame records are {previous fp, return address}.
+            u64 prev_fp = 0;
+            while (depth < PROFILER_MAX_DEPTH && _profilerIsValidFrame(fp, prev_fp, stack_lo, stack_hi)) {
+                u64 ret = ((u64*)fp)[1];
+                if (!ret)
+                    break;
+                frames[depth++] = ret;
+                prev_fp = fp;
+                fp = ((u64*)fp)[0];
+            }
+        }
+    }
+
+    threadResume(t);
+
+    if (depth)
+        _profilerRecord(p, frames, depth);
+}
+
+static void _profilerThreadFunc(void* arg)
+{
+    Profiler* p = (Profiler*)arg;
+
+    while (!leventWait(&p->exit_event, p->config.period_ns)) {
+        mutexLock(&p->mutex);
+        for (u32 i = 0; i < p->num_targets; i ++)
+            _profilerSampleThread(p, p->targets[i]);
+        mutexUnlock(&p->mutex);
+    }
+}
+
+Result profilerCreate(Profiler* p, const ProfilerConfig* config)
+{
+    memset(p, 0, sizeof(*p));
+    p->config = *config;
+    if (!p->config.period_ns)
+        p->config.period_ns = PROFILER_DEFAULT_PERIOD_NS;
+    if (!p->config.max_stacks)
+        p->config.max_stacks = PROFILER_DEFAULT_MAX_STACKS;
+    if (p->config.max_stacks & (p->config.max_stacks - 1))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexInit(&p->mutex);
+    p->stacks = (ProfilerStack*)__libnx_alloc(sizeof(ProfilerStack) * p->config.max_stacks);
+    if (!p->stacks)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    profilerReset(p);
+    return 0;
+}
+
+void profilerClose(Profiler* p)
+{
+    profilerStop(p);
+    __libnx_free(p->stacks);
+    p->stacks = NULL;
+}
+
+Result profilerAddThread(Profiler* p, Thread* t)
+{
+    Result rc = 0;
+    mutexLock(&p->mutex);
+    if (p->num_targets < PROFILER_MAX_THREADS)
+        p->targets[p->num_targets++] = t;
+    else
+        rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    mutexUnlock(&p->mutex);
+    return rc;
+}
+
+void profilerRemoveThread(Profiler* p, Thread* t)
+{
+    mutexLock(&p->mutex);
+    for (u32 i = 0; i < p->num_targets; i ++) {
+        if (p->targets[i] == t) {
+            p->targets[i] = p->targets[--p->num_targets];
+            break;
+        }
+    }
+    mutexUnlock(&p->mutex);
+}
+
+Result profilerStart(Profiler* p)
+{
+    if (p->running)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    leventInit(&p->exit_event, false, false);
+    Result rc = threadCreate(&p->thread, _profilerThreadFunc, p, NULL, PROFILER_STACK_SIZE, p->config.prio, p->config.cpuid);
+    if (R_SUCCEEDED(rc)) {
+        rc = threadStart(&p->thread);
+        if (R_FAILED(rc))
+            threadClose(&p->thread);
+    }
+
+    if (R_SUCCEEDED(rc))
+        p->running = true;
+    return rc;
+}
+
+void profilerStop(Profiler* p)
+{
+    if (!p->running)
+        return;
+
+    leventSignal(&p->exit_event);
+    threadWaitForExit(&p->thread);
+    threadClose(&p->thread);
+    p->running = false;
+}
+
+void profilerReset(Profiler* p)
+{
+    memset(p->stacks, 0, sizeof(ProfilerStack) * p->config.max_stacks);
+    p->num_samples = 0;
+    p->dropped_samples = 0;
+}
+
+static int _profilerSymbolCompare(const void* a, const void* b)
+{
+    const ProfilerSymbol* sa = (const ProfilerSymbol*)a;
+    const ProfilerSymbol* sb = (const ProfilerSymbol*)b;
+    return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+static size_t _profilerGetGnuHashSymCount(const u32* gnu_hash)
+{
+    u32 nbuckets = gnu_hash[0];
+    u32 symoffset = gnu_hash[1];
+    u32 bloom_size = gnu_hash[2];
+    const u32* buckets = &gnu_hash[4 + bloom_size * 2];
+    const u32* chains = &buckets[nbuckets];
+
+    u32 last = 0;
+    for (u32 i = 0; i < nbuckets; i ++)
+        if (buckets[i] > last)
+            last = buckets[i];
+    if (last < symoffset)
+        return symoffset;
+
+    while (!(chains[last - symoffset] & 1))
+        last++;
+    return last + 1;
+}
+
+// Builds a sorted table of the function symbols exported by the main module.
+static void _profilerLoadSymbols(ProfilerSymbolTable* tbl)
+{
+    memset(tbl, 0, sizeof(*tbl));
+    tbl->base = (uintptr_t)_start;
+
+    const u8* mod0 = (const u8*)__nx_mod0;
+    const Elf64_Dyn* dyn = (const Elf64_Dyn*)(mod0 + *(const s32*)(mod0 + 4));
+    const Elf64_Sym* symtab = NULL;
+    const char* strtab = NULL;
+    size_t num_syms = 0;
+
+    for (; dyn->d_tag != DT_NULL; dyn++) {
+        switch (dyn->d_tag) {
+            case DT_SYMTAB:
+                symtab = (const Elf64_Sym*)(tbl->base + dyn->d_un.d_ptr);
+                break;
+            case DT_STRTAB:
+                strtab = (const char*)(tbl->base + dyn->d_un.d_ptr);
+                break;
+            case DT_HASH:
+                num_syms = ((const u32*)(tbl->base + dyn->d_un.d_ptr))[1];
+                break;
+            case DT_GNU_HASH:
+                if (!num_syms)
+                    num_syms = _profilerGetGnuHashSymCount((const u32*)(tbl->base + dyn->d_un.d_ptr));
+                break;
+        }
+    }
+
+    if (!symtab || !strtab || !num_syms)
+        return;
+
+    tbl->syms = (ProfilerSymbol*)__libnx_alloc(sizeof(ProfilerSymbol) * num_syms);
+    if (!tbl->syms)
+        return;
+
+    for (size_t i = 0; i < num_syms; i ++) {
+        const Elf64_Sym* sym = &symtab[i];
+        if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC || sym->st_shndx == SHN_UNDEF || !sym->st_value)
+            continue;
+        ProfilerSymbol* out = &tbl->syms[tbl->count++];
+        out->addr = tbl->base + sym->st_value;
+        out->size = sym->st_size;
+        out->name = strtab + sym->st_name;
+    }
+
+    qsort(tbl->syms, tbl->count, sizeof(ProfilerSymbol), _profilerSymbolCompare);
+}
+
+static const ProfilerSymbol* _profilerFindSymbol(const ProfilerSymbolTable* tbl, u64 addr)
+{
+    size_t lo = 0, hi = tbl->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (tbl->syms[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (!lo)
+        return NULL;
+    const ProfilerSymbol* sym = &tbl->syms[lo - 1];
+    if (sym->size && addr >= sym->addr + sym->size)
+        return NULL;
+    return sym;
+}
+
+static void _profilerWriteFrame(const ProfilerSymbolTable* tbl, FILE* f, u64 addr)
+{
+    const ProfilerSymbol* sym = _profilerFindSymbol(tbl, addr);
+    if (sym)
+        fputs(sym->name, f);
+    else if (addr >= tbl->base)
+        fprintf(f, "[main+0x%lx]", addr - tbl->base);
+    else
+        fprintf(f, "[0x%lx]", addr);
+}
+
+// Return addresses point after the call instruction, which may already belong to the next function.
+static inline u64 _profilerFrameAddr(const ProfilerStack* s, u32 i)
+{
+    return i ? s->frames[i] - 4 : s->frames[i];
+}
+
+void profilerWriteCollapsed(Profiler* p, FILE* f)
+{
+    ProfilerSymbolTable tbl;
+    _profilerLoadSymbols(&tbl);
+
+    for (u32 i = 0; i < p->config.max_stacks; i ++) {
+        const ProfilerStack* s = &p->stacks[i];
+        if (!s->count)
+            continue;
+
+        for (u32 j = s->depth; j > 0; j --) {
+            _profilerWriteFrame(&tbl, f, _profilerFrameAddr(s, j-1));
+            fputc(j > 1 ? ';' : ' ', f);
+        }
+        fprintf(f, "%u\n", s->count);
+    }
+
+    __libnx_free(tbl.syms);
+}
+
+static int _profilerHistogramCompare(const void* a, const void* b)
+{
+    const ProfilerHistogramEntry* ea = (const ProfilerHistogramEntry*)a;
+    const ProfilerHistogramEntry* eb = (const ProfilerHistogramEntry*)b;
+    return ea->count > eb->count ? -1 : ea->count < eb->count;
+}
+
+Result profilerWriteHistogram(Profiler* p, FILE* f)
+{
+    ProfilerHistogramEntry* entries = (ProfilerHistogramEntry*)__libnx_alloc(sizeof(ProfilerHistogramEntry) * p->config.max_stacks);
+    if (!entries)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    ProfilerSymbolTable tbl;
+    _profilerLoadSymbols(&tbl);
+
+    // Aggregate samples by function (or by address for unknown code), using the innermost frame.
+    size_t num_entries = 0;
+    for (u32 i = 0; i < p->config.max_stacks; i ++) {
+        const ProfilerStack* s = &p->stacks[i];
+        if (!s->count)
+            continue;
+
+        const ProfilerSymbol* sym = _profilerFindSymbol(&tbl, s->frames[0]);
+        u64 key = sym ? sym->addr : s->frames[0];
+
+        size_t j;
+        for (j = 0; j < num_entries && entries[j].key != key; j ++);
+        if (j == num_entries)
+            entries[num_entries++] = (ProfilerHistogramEntry){ .key = key, .count = 0 };
+        entries[j].count += s->count;
+    }
+
+    qsort(entries, num_entries, sizeof(ProfilerHistogramEntry), _profilerHistogramCompare);
+
+    fprintf(f, "# %lu samples, %lu dropped\n", p->num_samples, p->dropped_samples);
+    for (size_t i = 0; i < num_entries; i ++) {
+        fprintf(f, "%8lu %6.2f%% ", entries[i].count, p->num_samples ? 100.0 * entries[i].count / p->num_samples : 0.0);
+        _profilerWriteFrame(&tbl, f, entries[i].key);
+        fputc('\n', f);
+    }
+
+    __libnx_free(tbl.syms);
+    __libnx_free(entries);
+    return 0;
+}
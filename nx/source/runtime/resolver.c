@@ -9,6 +9,11 @@
 #include <sys/socket.h>
 
 #include "result.h"
+#include "arm/counter.h"
+#include "kernel/mutex.h"
+#include "kernel/condvar.h"
+#include "kernel/thread.h"
+#include "kernel/uevent.h"
 //#include "kernel/random.h"
 #include "services/sfdnsres.h"
 #include "services/nifm.h"
@@ -28,6 +33,8 @@ static size_t g_resolverHostByAddrBufferSize    = 0x200;  // ResolverOptionLocal
 static size_t g_resolverAddrInfoBufferSize      = 0x1000; // ResolverOptionLocalKey::GetAddrInfoBufferSizeUnsigned64
 static size_t g_resolverAddrInfoHintsBufferSize = 0x400;  // ResolverOptionLocalKey::GetAddrInfoHintsBufferSizeUnsigned64
 
+#define RESOLVER_ASYNC_STACK_SIZE 0x4000
+
 Result resolverGetLastResult(void) {
     return g_resolverResult;
 }
@@ -485,15 +492,7 @@ const char *gai_strerror(int err) {
     return buf;
 }
 
-int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
-    if (!node && !service)
-        return EAI_NONAME;
-
-    if (!res) {
-        errno = EINVAL;
-        return EAI_SYSTEM;
-    }
-
+static int _resolverGetAddrInfoSerialized(u32 cancel_handle, bool use_nsd, const char *node, const char *service, const struct addrinfo *hints, struct addrinfo_serialized_hdr **out) {
     if (!g_resolverAddrInfoBufferSize) {
         errno = ENOSPC;
         return EAI_SYSTEM;
@@ -518,8 +517,8 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
 
     s32 ret = 0;
     Result rc = sfdnsresGetAddrInfoRequest(
-        g_resolverCancelHandle,
-        !g_resolverDisableServiceDiscovery,
+        cancel_handle,
+        use_nsd,
         node,
         service,
         hints_serialized, hints_sz,
@@ -528,7 +527,6 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
         &ret,
         NULL);
     g_resolverResult = rc;
-    g_resolverCancelHandle = 0;
     __libnx_free(hints_serialized);
 
     if (R_FAILED(rc)) {
@@ -541,6 +539,28 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
         ret = EAI_SYSTEM;
     }
 
+    if (ret == 0)
+        *out = out_serialized;
+    else
+        __libnx_free(out_serialized);
+    return ret;
+}
+
+static int _resolverCacheLookup(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
+static void _resolverCacheInsert(const char *node, const char *service, const struct addrinfo *hints, int ret, const struct addrinfo_serialized_hdr *serialized);
+
+static int _resolverGetAddrInfo(u32 cancel_handle, bool use_nsd, bool use_cache, const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+    if (use_cache) {
+        int ret = _resolverCacheLookup(node, service, hints, res);
+        if (ret != EAI_AGAIN)
+            return ret;
+    }
+
+    struct addrinfo_serialized_hdr *out_serialized = NULL;
+    int ret = _resolverGetAddrInfoSerialized(cancel_handle, use_nsd, node, service, hints, &out_serialized);
+    if (use_cache)
+        _resolverCacheInsert(node, service, hints, ret, out_serialized);
+
     if (ret == 0) {
         *res = _resolverDeserializeAddrInfoList(out_serialized);
         if (!*res) {
@@ -553,6 +573,20 @@ int getaddrinfo(const char *node, const char *service, const struct addrinfo *hi
     return ret;
 }
 
+int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+    if (!node && !service)
+        return EAI_NONAME;
+
+    if (!res) {
+        errno = EINVAL;
+        return EAI_SYSTEM;
+    }
+
+    int ret = _resolverGetAddrInfo(g_resolverCancelHandle, !g_resolverDisableServiceDiscovery, !g_resolverDisableDnsCache, node, service, hints, res);
+    g_resolverCancelHandle = 0;
+    return ret;
+}
+
 int getnameinfo(const struct sockaddr *sa, socklen_t salen,
                 char *host, socklen_t hostlen,
                 char *serv, socklen_t servlen,
@@ -617,3 +651,488 @@ struct servent *getservent(void) { h_errno = NO_RECOVERY; errno = ENOSYS; return
 void sethostent(int a) { (void)a;}
 void setnetent(int a) { (void)a;}
 void setprotoent(int a) { (void)a; }
+
+// Client-side cache of getaddrinfo results.
+
+typedef struct {
+    char *key;   // node '\0' service '\0', each prefixed with whether it's present
+    size_t key_size;
+    int hints[4];
+    int ret;
+    u64 expires;
+    struct addrinfo_serialized_hdr *data;
+} ResolverCacheEntry;
+
+static Mutex g_resolverCacheMutex;
+static ResolverCacheEntry *g_resolverCache;
+static u32 g_resolverCacheSize;
+static u64 g_resolverCachePositiveTtl;
+static u64 g_resolverCacheNegativeTtl;
+
+static size_t _resolverCacheMakeKey(char *out, const char *node, const char *service) {
+    size_t node_len = node ? strlen(node) + 1 : 0;
+    size_t service_len = service ? strlen(service) + 1 : 0;
+    if (out) {
+        out[0] = node != NULL;
+        memcpy(&out[1], node, node_len);
+        out[1+node_len] = service != NULL;
+        memcpy(&out[2+node_len], service, service_len);
+    }
+    return 2 + node_len + service_len;
+}
+
+static void _resolverCacheMakeHints(int *out, const struct addrinfo *hints) {
+    out[0] = hints ? hints->ai_flags : 0;
+    out[1] = hints ? hints->ai_family : 0;
+    out[2] = hints ? hints->ai_socktype : 0;
+    out[3] = hints ? hints->ai_protocol : 0;
+}
+
+static void _resolverCacheFreeEntry(ResolverCacheEntry *e) {
+    __libnx_free(e->key);
+    __libnx_free(e->data);
+    memset(e, 0, sizeof(*e));
+}
+
+static ResolverCacheEntry *_resolverCacheFind(const char *node, const char *service, const struct addrinfo *hints) {
+    char key[_resolverCacheMakeKey(NULL, node, service)];
+    int key_hints[4];
+    _resolverCacheMakeKey(key, node, service);
+    _resolverCacheMakeHints(key_hints, hints);
+
+    for (u32 i = 0; i < g_resolverCacheSize; i ++) {
+        ResolverCacheEntry *e = &g_resolverCache[i];
+        if (e->key && e->key_size == sizeof(key) && memcmp(e->key, key, sizeof(key)) == 0 && memcmp(e->hints, key_hints, sizeof(key_hints)) == 0)
+            return e;
+    }
+
+    return NULL;
+}
+
+static size_t _resolverAddrInfoListSize(const struct addrinfo_serialized_hdr *hdr) {
+    const u8 *pos = (const u8 *)hdr;
+    while (((const struct addrinfo_serialized_hdr *)pos)->magic == htonl(0xBEEFCAFE)) {
+        const struct addrinfo_serialized_hdr *cur = (const struct addrinfo_serialized_hdr *)pos;
+        size_t subsize1 = cur->ai_addrlen ? ntohl(cur->ai_addrlen) : 4;
+        pos += sizeof(struct addrinfo_serialized_hdr) + subsize1;
+        pos += strlen((const char *)pos) + 1;
+    }
+    return pos - (const u8 *)hdr + 4; // Sentinel value
+}
+
+static int _resolverCacheLookup(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res) {
+    int ret = EAI_AGAIN;
+
+    mutexLock(&g_resolverCacheMutex);
+
+    ResolverCacheEntry *e = _resolverCacheFind(node, service, hints);
+    if (e && armGetSystemTick() >= e->expires) {
+        _resolverCacheFreeEntry(e);
+        e = NULL;
+    }
+
+    if (e) {
+        ret = e->ret;
+        if (ret == 0) {
+            *res = _resolverDeserializeAddrInfoList(e->data);
+            if (!*res) {
+                errno = ENOMEM;
+                ret = EAI_MEMORY;
+            }
+        }
+    }
+
+    mutexUnlock(&g_resolverCacheMutex);
+    return ret;
+}
+
+static void _resolverCacheInsert(const char *node, const char *service, const struct addrinfo *hints, int ret, const struct addrinfo_serialized_hdr *serialized) {
+    // Only definitive answers are cached, not transient failures.
+    if (ret != 0 && ret != EAI_NONAME && ret != EAI_NODATA)
+        return;
+
+    mutexLock(&g_resolverCacheMutex);
+
+    if (g_resolverCacheSize) {
+        u64 ttl = ret == 0 ? g_resolverCachePositiveTtl : g_resolverCacheNegativeTtl;
+        ResolverCacheEntry *e = _resolverCacheFind(node, service, hints);
+        if (!e) {
+            // Replace the entry closest to expiring (free entries have expires == 0).
+            e = &g_resolverCache[0];
+            for (u32 i = 1; i < g_resolverCacheSize; i ++)
+                if (g_resolverCache[i].expires < e->expires)
+                    e = &g_resolverCache[i];
+        }
+        _resolverCacheFreeEntry(e);
+
+        e->key_size = _resolverCacheMakeKey(NULL, node, service);
+        e->key = __libnx_alloc(e->key_size);
+        if (ret == 0) {
+            size_t size = _resolverAddrInfoListSize(serialized);
+            e->data = __libnx_alloc(size);
+            if (e->data)
+                memcpy(e->data, serialized, size);
+        }
+
+        if (ttl && e->key && (ret != 0 || e->data)) {
+            _resolverCacheMakeKey(e->key, node, service);
+            _resolverCacheMakeHints(e->hints, hints);
+            e->ret = ret;
+            e->expires = armGetSystemTick() + armNsToTicks(ttl);
+        } else
+            _resolverCacheFreeEntry(e);
+    }
+
+    mutexUnlock(&g_resolverCacheMutex);
+}
+
+Result resolverCacheInitialize(u32 num_entries, u64 positive_ttl, u64 negative_ttl) {
+    if (!num_entries)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    ResolverCacheEntry *entries = __libnx_alloc(sizeof(ResolverCacheEntry) * num_entries);
+    if (!entries)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    memset(entries, 0, sizeof(ResolverCacheEntry) * num_entries);
+
+    Result rc = 0;
+    mutexLock(&g_resolverCacheMutex);
+    if (g_resolverCache)
+        rc = MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+    else {
+        g_resolverCache = entries;
+        g_resolverCacheSize = num_entries;
+        g_resolverCachePositiveTtl = positive_ttl;
+        g_resolverCacheNegativeTtl = negative_ttl;
+    }
+    mutexUnlock(&g_resolverCacheMutex);
+
+    if (R_FAILED(rc))
+        __libnx_free(entries);
+    return rc;
+}
+
+void resolverCacheFlush(void) {
+    mutexLock(&g_resolverCacheMutex);
+    for (u32 i = 0; i < g_resolverCacheSize; i ++)
+        _resolverCacheFreeEntry(&g_resolverCache[i]);
+    mutexUnlock(&g_resolverCacheMutex);
+}
+
+void resolverCacheExit(void) {
+    resolverCacheFlush();
+
+    mutexLock(&g_resolverCacheMutex);
+    __libnx_free(g_resolverCache);
+    g_resolverCache = NULL;
+    g_resolverCacheSize = 0;
+    mutexUnlock(&g_resolverCacheMutex);
+}
+
+// Asynchronous getaddrinfo, serviced by a pool of worker threads. sfdnsres opens a new session for each
+// command, so the workers' queries are processed concurrently.
+
+typedef enum {
+    ResolverRequestState_Queued,
+    ResolverRequestState_Running,
+    ResolverRequestState_Done,
+} ResolverRequestState;
+
+struct ResolverRequest {
+    ResolverRequest *next;
+    UEvent event;
+    ResolverRequestState state;
+    bool cancelled;
+    u32 cancel_handle;
+
+    bool use_nsd;
+    bool use_cache;
+    bool has_hints;
+    char *node;
+    char *service;
+    struct addrinfo hints;
+
+    int ret;
+    int err;
+    Result rc;
+    struct addrinfo *res;
+};
+
+static Mutex g_resolverAsyncMutex;
+static CondVar g_resolverAsyncCondVar;
+static ResolverRequest *g_resolverAsyncQueueHead, *g_resolverAsyncQueueTail;
+static Thread *g_resolverAsyncWorkers;
+static u32 g_resolverAsyncNumWorkers;
+static bool g_resolverAsyncExiting;
+
+// Must be called with g_resolverAsyncMutex held.
+static void _resolverRequestComplete(ResolverRequest *req, int ret, int err, Result rc) {
+    req->ret = ret;
+    req->err = err;
+    req->rc = rc;
+    req->state = ResolverRequestState_Done;
+    ueventSignal(&req->event);
+}
+
+static void _resolverAsyncWorkerFunc(void *arg) {
+    mutexLock(&g_resolverAsyncMutex);
+
+    for (;;) {
+        while (!g_resolverAsyncQueueHead && !g_resolverAsyncExiting)
+            condvarWait(&g_resolverAsyncCondVar, &g_resolverAsyncMutex);
+        if (g_resolverAsyncExiting)
+            break;
+
+        ResolverRequest *req = g_resolverAsyncQueueHead;
+        g_resolverAsyncQueueHead = req->next;
+        if (!g_resolverAsyncQueueHead)
+            g_resolverAsyncQueueTail = NULL;
+        req->next = NULL;
+        req->state = ResolverRequestState_Running;
+        mutexUnlock(&g_resolverAsyncMutex);
+
+        u32 cancel_handle = 0;
+        sfdnsresGetCancelHandleRequest(&cancel_handle);
+
+        mutexLock(&g_resolverAsyncMutex);
+        req->cancel_handle = cancel_handle;
+        bool cancelled = req->cancelled;
+        mutexUnlock(&g_resolverAsyncMutex);
+
+        int ret = EAI_SYSTEM;
+        errno = ECANCELED;
+        g_resolverResult = 0;
+        if (!cancelled)
+            ret = _resolverGetAddrInfo(cancel_handle, req->use_nsd, req->use_cache, req->node, req->service, req->has_hints ? &req->hints : NULL, &req->res);
+        int err = errno;
+
+        mutexLock(&g_resolverAsyncMutex);
+        if (req->cancelled && ret == 0) {
+            freeaddrinfo(req->res);
+            req->res = NULL;
+            ret = EAI_SYSTEM;
+            err = ECANCELED;
+        }
+        _resolverRequestComplete(req, ret, err, g_resolverResult);
+    }
+
+    mutexUnlock(&g_resolverAsyncMutex);
+}
+
+Result resolverAsyncInitialize(u32 num_workers, int prio, int cpuid) {
+    if (!num_workers)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    Result rc = 0;
+    bool cleanup = false;
+    mutexLock(&g_resolverAsyncMutex);
+
+    if (g_resolverAsyncWorkers)
+        rc = MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    if (R_SUCCEEDED(rc)) {
+        g_resolverAsyncWorkers = __libnx_alloc(sizeof(Thread) * num_workers);
+        if (!g_resolverAsyncWorkers)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    if (R_SUCCEEDED(rc)) {
+        g_resolverAsyncExiting = false;
+        g_resolverAsyncNumWorkers = 0;
+        for (u32 i = 0; R_SUCCEEDED(rc) && i < num_workers; i ++) {
+            Thread *t = &g_resolverAsyncWorkers[i];
+            rc = threadCreate(t, _resolverAsyncWorkerFunc, NULL, NULL, RESOLVER_ASYNC_STACK_SIZE, prio, cpuid);
+            if (R_SUCCEEDED(rc)) {
+                rc = threadStart(t);
+                if (R_SUCCEEDED(rc))
+                    g_resolverAsyncNumWorkers++;
+                else
+                    threadClose(t);
+            }
+        }
+        cleanup = R_FAILED(rc);
+    }
+
+    mutexUnlock(&g_resolverAsyncMutex);
+
+    if (cleanup)
+        resolverAsyncExit();
+    return rc;
+}
+
+void resolverAsyncExit(void) {
+    mutexLock(&g_resolverAsyncMutex);
+    g_resolverAsyncExiting = true;
+    condvarWakeAll(&g_resolverAsyncCondVar);
+
+    // Fail the requests which were never picked up.
+    while (g_resolverAsyncQueueHead) {
+        ResolverRequest *req = g_resolverAsyncQueueHead;
+        g_resolverAsyncQueueHead = req->next;
+        req->next = NULL;
+        _resolverRequestComplete(req, EAI_SYSTEM, ECANCELED, 0);
+    }
+    g_resolverAsyncQueueTail = NULL;
+    mutexUnlock(&g_resolverAsyncMutex);
+
+    for (u32 i = 0; i < g_resolverAsyncNumWorkers; i ++) {
+        threadWaitForExit(&g_resolverAsyncWorkers[i]);
+        threadClose(&g_resolverAsyncWorkers[i]);
+    }
+
+    mutexLock(&g_resolverAsyncMutex);
+    __libnx_free(g_resolverAsyncWorkers);
+    g_resolverAsyncWorkers = NULL;
+    g_resolverAsyncNumWorkers = 0;
+    mutexUnlock(&g_resolverAsyncMutex);
+}
+
+static char *_resolverStrdup(const char *str) {
+    if (!str)
+        return NULL;
+    size_t len = strlen(str) + 1;
+    char *out = __libnx_alloc(len);
+    if (out)
+        memcpy(out, str, len);
+    return out;
+}
+
+static void _resolverRequestFree(ResolverRequest *req) {
+    freeaddrinfo(req->res);
+    __libnx_free(req->node);
+    __libnx_free(req->service);
+    __libnx_free(req);
+}
+
+Result resolverGetAddrInfoAsync(ResolverRequest **out, const char *node, const char *service, const struct addrinfo *hints) {
+    if (!out || (!node && !service))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    ResolverRequest *req = __libnx_alloc(sizeof(ResolverRequest));
+    if (!req)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    memset(req, 0, sizeof(*req));
+    ueventCreate(&req->event, false);
+    req->use_nsd = !g_resolverDisableServiceDiscovery;
+    req->use_cache = !g_resolverDisableDnsCache;
+    req->node = _resolverStrdup(node);
+    req->service = _resolverStrdup(service);
+    if (hints) {
+        req->has_hints = true;
+        req->hints.ai_flags = hints->ai_flags;
+        req->hints.ai_family = hints->ai_family;
+        req->hints.ai_socktype = hints->ai_socktype;
+        req->hints.ai_protocol = hints->ai_protocol;
+    }
+
+    if ((node && !req->node) || (service && !req->service)) {
+        _resolverRequestFree(req);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    // Answer straight away from the cache when possible.
+    if (req->use_cache) {
+        int ret = _resolverCacheLookup(req->node, req->service, req->has_hints ? &req->hints : NULL, &req->res);
+        if (ret != EAI_AGAIN) {
+            req->ret = ret;
+            req->err = errno;
+            req->state = ResolverRequestState_Done;
+            ueventSignal(&req->event);
+            *out = req;
+            return 0;
+        }
+    }
+
+    Result rc = 0;
+    mutexLock(&g_resolverAsyncMutex);
+    if (!g_resolverAsyncNumWorkers || g_resolverAsyncExiting)
+        rc = MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+    else {
+        if (g_resolverAsyncQueueTail)
+            g_resolverAsyncQueueTail->next = req;
+        else
+            g_resolverAsyncQueueHead = req;
+        g_resolverAsyncQueueTail = req;
+        condvarWakeOne(&g_resolverAsyncCondVar);
+    }
+    mutexUnlock(&g_resolverAsyncMutex);
+
+    if (R_FAILED(rc))
+        _resolverRequestFree(req);
+    else
+        *out = req;
+    return rc;
+}
+
+Waiter resolverRequestGetWaiter(ResolverRequest *req) {
+    return waiterForUEvent(&req->event);
+}
+
+bool resolverRequestIsDone(ResolverRequest *req) {
+    mutexLock(&g_resolverAsyncMutex);
+    bool done = req->state == ResolverRequestState_Done;
+    mutexUnlock(&g_resolverAsyncMutex);
+    return done;
+}
+
+Result resolverRequestWait(ResolverRequest *req, u64 timeout) {
+    return waitSingle(waiterForUEvent(&req->event), timeout);
+}
+
+int resolverRequestGetResult(ResolverRequest *req, struct addrinfo **res) {
+    mutexLock(&g_resolverAsyncMutex);
+
+    int ret;
+    if (req->state != ResolverRequestState_Done) {
+        errno = EINPROGRESS;
+        ret = EAI_SYSTEM;
+    } else {
+        ret = req->ret;
+        errno = req->err;
+        g_resolverResult = req->rc;
+        if (ret == 0) {
+            *res = req->res;
+            req->res = NULL;
+        }
+    }
+
+    mutexUnlock(&g_resolverAsyncMutex);
+    return ret;
+}
+
+void resolverRequestCancel(ResolverRequest *req) {
+    mutexLock(&g_resolverAsyncMutex);
+
+    if (req->state == ResolverRequestState_Queued) {
+        ResolverRequest *prev = NULL;
+        for (ResolverRequest *cur = g_resolverAsyncQueueHead; cur; prev = cur, cur = cur->next) {
+            if (cur != req)
+                continue;
+            if (prev)
+                prev->next = req->next;
+            else
+                g_resolverAsyncQueueHead = req->next;
+            if (g_resolverAsyncQueueTail == req)
+                g_resolverAsyncQueueTail = prev;
+            req->next = NULL;
+            break;
+        }
+        _resolverRequestComplete(req, EAI_SYSTEM, ECANCELED, 0);
+    } else if (req->state == ResolverRequestState_Running) {
+        req->cancelled = true;
+        if (req->cancel_handle)
+            resolverCancel(req->cancel_handle);
+    }
+
+    mutexUnlock(&g_resolverAsyncMutex);
+}
+
+void resolverRequestClose(ResolverRequest *req) {
+    if (!req)
+        return;
+
+    resolverRequestCancel(req);
+    resolverRequestWait(req, UINT64_MAX);
+    _resolverRequestFree(req);
+}
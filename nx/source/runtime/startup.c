@@ -0,0 +1,42 @@
+#include "arm/counter.h"
+#include "runtime/startup.h"
+
+// Written by the runtime linker before relocations are applied: only direct (non-GOT) accesses are valid there.
+static StartupTimeline g_startupTimeline;
+
+void _startupSetPhaseTick(StartupPhase phase, u64 tick)
+{
+    g_startupTimeline.phase_ticks[phase] = tick;
+}
+
+void _startupSetRelocationStats(u64 num_relocations, u32 num_threads)
+{
+    g_startupTimeline.num_relocations = num_relocations;
+    g_startupTimeline.num_reloc_threads = num_threads;
+}
+
+void startupMark(const char* label)
+{
+    u64 tick = armGetSystemTick();
+    u32 index = __atomic_load_n(&g_startupTimeline.num_marks, __ATOMIC_RELAXED);
+    do {
+        if (index >= STARTUP_MAX_MARKS)
+            return;
+    } while (!__atomic_compare_exchange_n(&g_startupTimeline.num_marks, &index, index + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    g_startupTimeline.marks[index].label = label;
+    g_startupTimeline.marks[index].tick = tick;
+}
+
+const StartupTimeline* startupGetTimeline(void)
+{
+    return &g_startupTimeline;
+}
+
+u64 startupGetRelocationTime(void)
+{
+    const u64* ticks = g_startupTimeline.phase_ticks;
+    if (!ticks[StartupPhase_Entry] || !ticks[StartupPhase_RelocationsDone])
+        return 0;
+    return armTicksToNs(ticks[StartupPhase_RelocationsDone] - ticks[StartupPhase_Entry]);
+}
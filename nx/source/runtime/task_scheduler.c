@@ -0,0 +1,379 @@
+#include <string.h>
+#include "result.h"
+#include "kernel/svc.h"
+#include "runtime/task_scheduler.h"
+#include "../kernel/arbiter.h"
+#include "../runtime/alloc.h"
+
+#define TASK_SCHEDULER_DEFAULT_STACK_SIZE 0x10000
+#define TASK_SCHEDULER_DEFAULT_DEQUE_SIZE 256
+#define TASK_SCHEDULER_STEAL_ATTEMPTS     4
+
+static __thread TaskWorker* g_taskCurrentWorker;
+
+static inline TaskWorker* _taskGetCurrentWorker(TaskScheduler* s)
+{
+    TaskWorker* w = g_taskCurrentWorker;
+    return w && w->sched == s ? w : NULL;
+}
+
+// Chase-Lev deque: the owner pushes and takes at the bottom, thieves steal from the top.
+
+static bool _taskDequePush(TaskScheduler* s, TaskWorker* w, Task* task)
+{
+    s64 b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    s64 t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    if (b - t > s->deque_mask)
+        return false;
+
+    __atomic_store_n(&w->buffer[b & s->deque_mask], task, __ATOMIC_RELAXED);
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static Task* _taskDequeTake(TaskScheduler* s, TaskWorker* w)
+{
+    s64 b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+
+    Task* task = NULL;
+    if (t <= b) {
+        task = __atomic_load_n(&w->buffer[b & s->deque_mask], __ATOMIC_RELAXED);
+        if (t == b) {
+            // Last entry: race against thieves for it
+            if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+                task = NULL;
+            __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    } else
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+
+    return task;
+}
+
+// Returns NULL if the deque is empty, or if another thread won the race for the entry (*retry is set in that case).
+static Task* _taskDequeSteal(TaskScheduler* s, TaskWorker* w, bool* retry)
+{
+    s64 t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    s64 b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return NULL;
+
+    Task* task = __atomic_load_n(&w->buffer[t & s->deque_mask], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        *retry = true;
+        return NULL;
+    }
+
+    return task;
+}
+
+static Task* _taskInjectPop(TaskScheduler* s)
+{
+    if (!__atomic_load_n(&s->inject_count, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    mutexLock(&s->inject_mutex);
+    Task* task = s->inject_head;
+    if (task) {
+        s->inject_head = task->next;
+        if (!s->inject_head)
+            s->inject_tail = NULL;
+        __atomic_fetch_sub(&s->inject_count, 1, __ATOMIC_RELAXED);
+    }
+    mutexUnlock(&s->inject_mutex);
+
+    return task;
+}
+
+static void _taskInjectPush(TaskScheduler* s, Task* task)
+{
+    task->next = NULL;
+
+    mutexLock(&s->inject_mutex);
+    if (s->inject_tail)
+        s->inject_tail->next = task;
+    else
+        s->inject_head = task;
+    s->inject_tail = task;
+    __atomic_fetch_add(&s->inject_count, 1, __ATOMIC_RELEASE);
+    mutexUnlock(&s->inject_mutex);
+}
+
+static Task* _taskFind(TaskScheduler* s, TaskWorker* self)
+{
+    Task* task;
+
+    if (self && (task = _taskDequeTake(s, self)))
+        return task;
+
+    if ((task = _taskInjectPop(s)))
+        return task;
+
+    // Steal from the other workers, starting at a random one
+    u32 start = 0;
+    if (self) {
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 17;
+        self->rng ^= self->rng << 5;
+        start = self->rng;
+    }
+
+    for (u32 attempt = 0; attempt < TASK_SCHEDULER_STEAL_ATTEMPTS; attempt ++) {
+        bool retry = false;
+        for (u32 i = 0; i < s->num_workers; i ++) {
+            TaskWorker* victim = &s->workers[(start + i) % s->num_workers];
+            if (victim != self && (task = _taskDequeSteal(s, victim, &retry)))
+                return task;
+        }
+        if (!retry)
+            break;
+    }
+
+    return NULL;
+}
+
+static void _taskWakeWorker(TaskScheduler* s)
+{
+    __atomic_fetch_add(&s->park_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->num_parked, __ATOMIC_SEQ_CST))
+        _arbSignal(&s->park_seq, 1);
+}
+
+// Group waiters park alongside the workers, so completing a group wakes every parked thread.
+static void _taskWakeAll(TaskScheduler* s)
+{
+    __atomic_fetch_add(&s->park_seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&s->num_parked, __ATOMIC_SEQ_CST))
+        _arbSignal(&s->park_seq, -1);
+}
+
+static void _taskRun(TaskScheduler* s, Task* task)
+{
+    TaskGroup* g = task->group;
+    task->func(task->arg);
+
+    // The group may go out of scope as soon as pending reaches zero, so don't touch it afterwards.
+    if (__atomic_sub_fetch(&g->pending, 1, __ATOMIC_ACQ_REL) == 0)
+        _taskWakeAll(s);
+}
+
+static void _taskWorkerThreadFunc(void* arg)
+{
+    TaskWorker* w = (TaskWorker*)arg;
+    TaskScheduler* s = w->sched;
+    g_taskCurrentWorker = w;
+
+    for (;;) {
+        Task* task = _taskFind(s, w);
+        if (task) {
+            _taskRun(s, task);
+            continue;
+        }
+
+        // Read the sequence number before checking for work one last time, so that a task
+        // spawned after the check changes it and prevents us from going to sleep.
+        u32 seq = __atomic_load_n(&s->park_seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s->exiting, __ATOMIC_ACQUIRE))
+            break;
+
+        task = _taskFind(s, w);
+        if (task) {
+            _taskRun(s, task);
+            continue;
+        }
+
+        __atomic_fetch_add(&s->num_parked, 1, __ATOMIC_SEQ_CST);
+        _arbWaitIfEqual(&s->park_seq, seq, UINT64_MAX);
+        __atomic_fetch_sub(&s->num_parked, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static void _taskSchedulerStopWorkers(TaskScheduler* s, u32 count)
+{
+    __atomic_store_n(&s->exiting, true, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&s->park_seq, 1, __ATOMIC_SEQ_CST);
+    _arbSignal(&s->park_seq, -1);
+
+    for (u32 i = 0; i < count; i ++) {
+        threadWaitForExit(&s->workers[i].thread);
+        threadClose(&s->workers[i].thread);
+    }
+}
+
+Result taskSchedulerCreate(TaskScheduler* s, const TaskSchedulerConfig* config)
+{
+    Result rc = 0;
+    u32 deque_size = config->deque_size ? config->deque_size : TASK_SCHEDULER_DEFAULT_DEQUE_SIZE;
+    size_t stack_size = config->stack_size ? config->stack_size : TASK_SCHEDULER_DEFAULT_STACK_SIZE;
+
+    if (deque_size & (deque_size - 1))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (config->num_workers > TASK_SCHEDULER_MAX_WORKERS)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    u64 core_mask = config->core_mask;
+    if (!core_mask) {
+        rc = svcGetInfo(&core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0);
+        if (R_FAILED(rc))
+            return rc;
+    }
+    core_mask &= 0xF;
+    if (!core_mask)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(s, 0, sizeof(*s));
+    mutexInit(&s->inject_mutex);
+    s->deque_mask = deque_size - 1;
+    s->num_workers = config->num_workers ? config->num_workers : __builtin_popcountll(core_mask);
+    if (s->num_workers > TASK_SCHEDULER_MAX_WORKERS)
+        s->num_workers = TASK_SCHEDULER_MAX_WORKERS;
+
+    Task** buffers = (Task**)__libnx_alloc(sizeof(Task*) * deque_size * s->num_workers);
+    if (!buffers)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    u32 i;
+    u64 remaining_cores = core_mask;
+    for (i = 0; i < s->num_workers; i ++) {
+        TaskWorker* w = &s->workers[i];
+        w->buffer = &buffers[i * deque_size];
+        w->sched = s;
+        w->rng = 0x9E3779B9 * (i + 1);
+
+        if (!remaining_cores)
+            remaining_cores = core_mask;
+        int cpuid = __builtin_ctzll(remaining_cores);
+        remaining_cores &= remaining_cores - 1;
+
+        rc = threadCreate(&w->thread, _taskWorkerThreadFunc, w, NULL, stack_size, config->prio, cpuid);
+        if (R_FAILED(rc))
+            break;
+
+        // Keep the worker on its core, so that each deque stays in its core's cache
+        rc = svcSetThreadCoreMask(w->thread.handle, cpuid, BIT(cpuid));
+        if (R_SUCCEEDED(rc))
+            rc = threadStart(&w->thread);
+        if (R_FAILED(rc)) {
+            threadClose(&w->thread);
+            break;
+        }
+    }
+
+    if (R_FAILED(rc)) {
+        _taskSchedulerStopWorkers(s, i);
+        __libnx_free(buffers);
+        s->workers[0].buffer = NULL;
+    }
+
+    return rc;
+}
+
+void taskSchedulerClose(TaskScheduler* s)
+{
+    if (!s->workers[0].buffer)
+        return;
+
+    _taskSchedulerStopWorkers(s, s->num_workers);
+
+    __libnx_free(s->workers[0].buffer);
+    s->workers[0].buffer = NULL;
+}
+
+void taskSchedulerSpawn(TaskScheduler* s, TaskGroup* g, Task* task, TaskFunc func, void* arg)
+{
+    task->func = func;
+    task->arg = arg;
+    task->group = g;
+    __atomic_fetch_add(&g->pending, 1, __ATOMIC_RELAXED);
+
+    TaskWorker* w = _taskGetCurrentWorker(s);
+    if (w) {
+        if (!_taskDequePush(s, w, task)) {
+            _taskRun(s, task);
+            return;
+        }
+    } else
+        _taskInjectPush(s, task);
+
+    _taskWakeWorker(s);
+}
+
+void taskGroupWait(TaskScheduler* s, TaskGroup* g)
+{
+    TaskWorker* w = _taskGetCurrentWorker(s);
+
+    while (__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE)) {
+        Task* task = _taskFind(s, w);
+        if (task) {
+            _taskRun(s, task);
+            continue;
+        }
+
+        // Park like an idle worker, so that tasks spawned in the meantime wake us up and we keep helping.
+        // As in the worker loop, the sequence number is read before checking one last time.
+        u32 seq = __atomic_load_n(&s->park_seq, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&g->pending, __ATOMIC_ACQUIRE))
+            break;
+
+        task = _taskFind(s, w);
+        if (task) {
+            _taskRun(s, task);
+            continue;
+        }
+
+        __atomic_fetch_add(&s->num_parked, 1, __ATOMIC_SEQ_CST);
+        _arbWaitIfEqual(&s->park_seq, seq, UINT64_MAX);
+        __atomic_fetch_sub(&s->num_parked, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+typedef struct {
+    TaskRangeFunc func;
+    void* arg;
+    u64 next;
+    u64 end;
+    u64 grain;
+} TaskParallelFor;
+
+static void _taskParallelForFunc(void* arg)
+{
+    TaskParallelFor* pf = (TaskParallelFor*)arg;
+
+    // Chunks are handed out dynamically, which balances uneven workloads without any further splitting
+    for (;;) {
+        u64 begin = __atomic_fetch_add(&pf->next, pf->grain, __ATOMIC_RELAXED);
+        if (begin >= pf->end)
+            break;
+        u64 end = pf->end - begin > pf->grain ? begin + pf->grain : pf->end;
+        pf->func(pf->arg, begin, end);
+    }
+}
+
+void taskSchedulerParallelFor(TaskScheduler* s, u64 begin, u64 end, u64 grain, TaskRangeFunc func, void* arg)
+{
+    if (begin >= end)
+        return;
+    if (!grain)
+        grain = 1;
+    if (end - begin <= grain) {
+        func(arg, begin, end);
+        return;
+    }
+
+    TaskParallelFor pf = { .func = func, .arg = arg, .next = begin, .end = end, .grain = grain };
+    Task tasks[TASK_SCHEDULER_MAX_WORKERS];
+    TaskGroup g;
+    taskGroupInit(&g);
+
+    u64 num_chunks = (end - begin + grain - 1) / grain;
+    u32 num_tasks = num_chunks - 1 < s->num_workers ? num_chunks - 1 : s->num_workers;
+    for (u32 i = 0; i < num_tasks; i ++)
+        taskSchedulerSpawn(s, &g, &tasks[i], _taskParallelForFunc, &pf);
+
+    _taskParallelForFunc(&pf);
+    taskGroupWait(s, &g);
+}
@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include <string.h>
+#include "result.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "runtime/diag.h"
+#include "runtime/tcalloc.h"
+
+#define TCALLOC_HEADER_SIZE  0x10
+#define TCALLOC_SLAB_SIZE    0x10000
+#define TCALLOC_BATCH_BYTES  0x1000  // Amount of memory moved at once between thread caches and the central lists
+#define TCALLOC_CLASS_LARGE  0xFFFF
+
+#define TCALLOC_MAGIC        0x5443 // "TC"
+
+// Allocations aligned to at least this skip the header (which would cost a whole alignment unit of padding),
+// and are tracked in a list instead
+#define TCALLOC_RAW_ALIGNMENT 0x1000
+
+// Stored in the TLS slot once the thread cache was destroyed, so frees from later TLS destructors don't recreate it
+#define TCALLOC_CACHE_EXITING ((TcallocThreadCache*)1)
+
+// Every block is preceded by a header, which lets tcallocFree route it without any lookup
+typedef struct {
+    u16 magic;
+    u16 size_class;
+    u32 padding;
+    void* base; // Start of the underlying malloc block for large allocations
+} TcallocHeader;
+
+typedef struct TcallocBlock TcallocBlock;
+struct TcallocBlock {
+    TcallocBlock* next;
+};
+
+typedef struct TcallocRawBlock TcallocRawBlock;
+struct TcallocRawBlock {
+    TcallocRawBlock* next;
+    void* ptr;
+};
+
+static const u16 g_tcallocClassSizes[] = {
+    0x10, 0x20, 0x30, 0x40, 0x60, 0x80, 0xC0, 0x100,
+    0x180, 0x200, 0x300, 0x400, 0x600, 0x800,
+};
+
+#define TCALLOC_NUM_CLASSES (sizeof(g_tcallocClassSizes)/sizeof(g_tcallocClassSizes[0]))
+
+typedef struct {
+    Mutex mutex;
+    TcallocBlock* free_list;
+    u32 free_count;
+} TcallocCentral;
+
+typedef struct {
+    TcallocBlock* free_list[TCALLOC_NUM_CLASSES];
+    u32 free_count[TCALLOC_NUM_CLASSES];
+} TcallocThreadCache;
+
+static TcallocCentral g_tcallocCentral[TCALLOC_NUM_CLASSES];
+static Mutex g_tcallocTlsMutex;
+static s32 g_tcallocTlsSlot = -1;
+static Mutex g_tcallocRawMutex;
+static TcallocRawBlock* g_tcallocRawBlocks;
+
+static inline u32 _tcallocGetClass(size_t size)
+{
+    u32 i;
+    for (i = 0; i < TCALLOC_NUM_CLASSES - 1 && g_tcallocClassSizes[i] < size; i ++);
+    return i;
+}
+
+static inline size_t _tcallocBlockSize(u32 size_class)
+{
+    return TCALLOC_HEADER_SIZE + g_tcallocClassSizes[size_class];
+}
+
+static inline u32 _tcallocBatchCount(u32 size_class)
+{
+    u32 count = TCALLOC_BATCH_BYTES / _tcallocBlockSize(size_class);
+    return count < 4 ? 4 : count;
+}
+
+// Carves a new slab into blocks. Must be called with the central mutex held.
+static bool _tcallocCentralGrow(TcallocCentral* c, u32 size_class)
+{
+    u8* slab = (u8*)malloc(TCALLOC_SLAB_SIZE);
+    if (!slab)
+        return false;
+
+    size_t block_size = _tcallocBlockSize(size_class);
+    for (size_t off = 0; off + block_size <= TCALLOC_SLAB_SIZE; off += block_size) {
+        TcallocHeader* hdr = (TcallocHeader*)(slab + off);
+        hdr->magic = TCALLOC_MAGIC;
+        hdr->size_class = size_class;
+        TcallocBlock* block = (TcallocBlock*)(hdr + 1);
+        block->next = c->free_list;
+        c->free_list = block;
+        c->free_count ++;
+    }
+
+    return true;
+}
+
+// Moves up to count blocks from the central list to out; returns the number of blocks moved.
+static u32 _tcallocCentralFetch(u32 size_class, TcallocBlock** out, u32 count)
+{
+    TcallocCentral* c = &g_tcallocCentral[size_class];
+    u32 total = 0;
+
+    mutexLock(&c->mutex);
+    if (!c->free_list)
+        _tcallocCentralGrow(c, size_class);
+
+    TcallocBlock* head = c->free_list;
+    TcallocBlock* tail = NULL;
+    for (TcallocBlock* b = head; b && total < count; b = b->next) {
+        tail = b;
+        total ++;
+    }
+    if (tail) {
+        c->free_list = tail->next;
+        c->free_count -= total;
+        tail->next = NULL;
+    }
+    mutexUnlock(&c->mutex);
+
+    *out = total ? head : NULL;
+    return total;
+}
+
+static void _tcallocCentralRelease(u32 size_class, TcallocBlock* head, TcallocBlock* tail, u32 count)
+{
+    TcallocCentral* c = &g_tcallocCentral[size_class];
+
+    mutexLock(&c->mutex);
+    tail->next = c->free_list;
+    c->free_list = head;
+    c->free_count += count;
+    mutexUnlock(&c->mutex);
+}
+
+static void _tcallocCacheFlush(TcallocThreadCache* tc)
+{
+    for (u32 i = 0; i < TCALLOC_NUM_CLASSES; i ++) {
+        TcallocBlock* head = tc->free_list[i];
+        if (!head)
+            continue;
+
+        TcallocBlock* tail = head;
+        while (tail->next)
+            tail = tail->next;
+        _tcallocCentralRelease(i, head, tail, tc->free_count[i]);
+
+        tc->free_list[i] = NULL;
+        tc->free_count[i] = 0;
+    }
+}
+
+static void _tcallocCacheDestructor(void* arg)
+{
+    TcallocThreadCache* tc = (TcallocThreadCache*)arg;
+    _tcallocCacheFlush(tc);
+    free(tc);
+    threadTlsSet(g_tcallocTlsSlot, TCALLOC_CACHE_EXITING);
+}
+
+static TcallocThreadCache* _tcallocGetCache(void)
+{
+    s32 slot = __atomic_load_n(&g_tcallocTlsSlot, __ATOMIC_ACQUIRE);
+    if (slot < 0) {
+        mutexLock(&g_tcallocTlsMutex);
+        slot = g_tcallocTlsSlot;
+        if (slot < 0) {
+            slot = threadTlsAlloc(_tcallocCacheDestructor);
+            if (slot < 0) {
+                mutexUnlock(&g_tcallocTlsMutex);
+                return NULL;
+            }
+            __atomic_store_n(&g_tcallocTlsSlot, slot, __ATOMIC_RELEASE);
+        }
+        mutexUnlock(&g_tcallocTlsMutex);
+    }
+
+    TcallocThreadCache* tc = (TcallocThreadCache*)threadTlsGet(slot);
+    if (tc == TCALLOC_CACHE_EXITING)
+        return NULL;
+    if (!tc) {
+        tc = (TcallocThreadCache*)calloc(1, sizeof(TcallocThreadCache));
+        if (tc)
+            threadTlsSet(slot, tc);
+    }
+
+    return tc;
+}
+
+static void* _tcallocLargeAlloc(size_t alignment, size_t size)
+{
+    if (alignment < TCALLOC_HEADER_SIZE)
+        alignment = TCALLOC_HEADER_SIZE;
+    if (size > SIZE_MAX - 2*alignment)
+        return NULL;
+
+    size_t total = (alignment + size + alignment - 1) &~ (alignment - 1);
+    u8* base = (u8*)aligned_alloc(alignment, total);
+    if (!base)
+        return NULL;
+
+    TcallocHeader* hdr = (TcallocHeader*)(base + alignment) - 1;
+    hdr->magic = TCALLOC_MAGIC;
+    hdr->size_class = TCALLOC_CLASS_LARGE;
+    hdr->base = base;
+    return hdr + 1;
+}
+
+static void* _tcallocRawAlloc(size_t alignment, size_t size)
+{
+    TcallocRawBlock* raw = (TcallocRawBlock*)malloc(sizeof(TcallocRawBlock));
+    if (!raw)
+        return NULL;
+
+    raw->ptr = aligned_alloc(alignment, size);
+    if (!raw->ptr) {
+        free(raw);
+        return NULL;
+    }
+
+    mutexLock(&g_tcallocRawMutex);
+    raw->next = g_tcallocRawBlocks;
+    g_tcallocRawBlocks = raw;
+    mutexUnlock(&g_tcallocRawMutex);
+    return raw->ptr;
+}
+
+// Frees p if it was allocated by _tcallocRawAlloc.
+static bool _tcallocRawFree(void* p)
+{
+    TcallocRawBlock* raw = NULL;
+
+    mutexLock(&g_tcallocRawMutex);
+    for (TcallocRawBlock** it = &g_tcallocRawBlocks; *it; it = &(*it)->next) {
+        if ((*it)->ptr == p) {
+            raw = *it;
+            *it = raw->next;
+            break;
+        }
+    }
+    mutexUnlock(&g_tcallocRawMutex);
+
+    if (!raw)
+        return false;
+
+    free(raw->ptr);
+    free(raw);
+    return true;
+}
+
+void* tcallocAlloc(size_t size)
+{
+    if (size > TCALLOC_MAX_SMALL_SIZE)
+        return _tcallocLargeAlloc(TCALLOC_HEADER_SIZE, size);
+
+    u32 size_class = _tcallocGetClass(size);
+    TcallocThreadCache* tc = _tcallocGetCache();
+    TcallocBlock* block;
+
+    if (!tc) {
+        // No cache available, go through the central list directly
+        _tcallocCentralFetch(size_class, &block, 1);
+        return block;
+    }
+
+    if (!tc->free_list[size_class])
+        tc->free_count[size_class] = _tcallocCentralFetch(size_class, &tc->free_list[size_class], _tcallocBatchCount(size_class));
+
+    block = tc->free_list[size_class];
+    if (block) {
+        tc->free_list[size_class] = block->next;
+        tc->free_count[size_class] --;
+    }
+
+    return block;
+}
+
+void* tcallocAlignedAlloc(size_t alignment, size_t size)
+{
+    // Small blocks are only guaranteed to be aligned to the header size
+    if (alignment <= TCALLOC_HEADER_SIZE)
+        return tcallocAlloc(size);
+    if (alignment >= TCALLOC_RAW_ALIGNMENT)
+        return _tcallocRawAlloc(alignment, size);
+
+    return _tcallocLargeAlloc(alignment, size);
+}
+
+void tcallocFree(void* p)
+{
+    if (!p)
+        return;
+
+    // Only raw blocks are this aligned, other than the occasional block with a header
+    if (!((uintptr_t)p & (TCALLOC_RAW_ALIGNMENT - 1)) && _tcallocRawFree(p))
+        return;
+
+    TcallocHeader* hdr = (TcallocHeader*)p - 1;
+    if (hdr->magic != TCALLOC_MAGIC)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_BadInput));
+
+    if (hdr->size_class == TCALLOC_CLASS_LARGE) {
+        free(hdr->base);
+        return;
+    }
+
+    u32 size_class = hdr->size_class;
+    TcallocBlock* block = (TcallocBlock*)p;
+    TcallocThreadCache* tc = _tcallocGetCache();
+    if (!tc) {
+        _tcallocCentralRelease(size_class, block, block, 1);
+        return;
+    }
+
+    block->next = tc->free_list[size_class];
+    tc->free_list[size_class] = block;
+    tc->free_count[size_class] ++;
+
+    // Keep the cache bounded: hand a batch back to the central list once it holds two of them
+    u32 batch = _tcallocBatchCount(size_class);
+    if (tc->free_count[size_class] >= 2*batch) {
+        TcallocBlock* head = tc->free_list[size_class];
+        TcallocBlock* tail = head;
+        for (u32 i = 1; i < batch; i ++)
+            tail = tail->next;
+
+        tc->free_list[size_class] = tail->next;
+        tc->free_count[size_class] -= batch;
+        _tcallocCentralRelease(size_class, head, tail, batch);
+    }
+}
+
+void tcallocFlushThreadCache(void)
+{
+    s32 slot = __atomic_load_n(&g_tcallocTlsSlot, __ATOMIC_ACQUIRE);
+    if (slot < 0)
+        return;
+
+    TcallocThreadCache* tc = (TcallocThreadCache*)threadTlsGet(slot);
+    if (tc && tc != TCALLOC_CACHE_EXITING)
+        _tcallocCacheFlush(tc);
+}
@@ -0,0 +1,136 @@
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/svc.h"
+#include "kernel/mutex.h"
+#include "kernel/thread.h"
+#include "runtime/trace.h"
+#include "trace_internal.h"
+#include "../runtime/alloc.h"
+
+bool __nx_trace_enabled;
+
+Mutex g_traceMutex;
+TraceBuffer* g_traceBuffers;
+u32 g_traceCapacity;
+static s32 g_traceTlsSlot = -1;
+
+static void _traceThreadExit(void* arg)
+{
+    // Keep the events around for exporting, but let the next new thread reuse the buffer.
+    // This bounds memory usage to the peak number of concurrently recording threads.
+    TraceBuffer* buf = (TraceBuffer*)arg;
+    mutexLock(&g_traceMutex);
+    buf->exited = true;
+    mutexUnlock(&g_traceMutex);
+}
+
+Result traceInitialize(u32 events_per_thread)
+{
+    if (!events_per_thread || (events_per_thread & (events_per_thread - 1)))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    mutexLock(&g_traceMutex);
+    Result rc = 0;
+    if (g_traceCapacity)
+        rc = MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+    else {
+        g_traceTlsSlot = threadTlsAlloc(_traceThreadExit);
+        if (g_traceTlsSlot < 0)
+            rc = MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        else
+            __atomic_store_n(&g_traceCapacity, events_per_thread, __ATOMIC_RELEASE);
+    }
+    mutexUnlock(&g_traceMutex);
+
+    return rc;
+}
+
+void traceExit(void)
+{
+    traceSetEnabled(false);
+
+    mutexLock(&g_traceMutex);
+    if (g_traceCapacity) {
+        // Stale buffer pointers left in other threads' slots get cleared when the slot is allocated again.
+        __atomic_store_n(&g_traceCapacity, 0, __ATOMIC_RELEASE);
+        threadTlsFree(g_traceTlsSlot);
+        g_traceTlsSlot = -1;
+    }
+    while (g_traceBuffers) {
+        TraceBuffer* buf = g_traceBuffers;
+        g_traceBuffers = buf->next;
+        __libnx_free(buf);
+    }
+    mutexUnlock(&g_traceMutex);
+}
+
+void traceSetEnabled(bool enable)
+{
+    __atomic_store_n(&__nx_trace_enabled, enable && __atomic_load_n(&g_traceCapacity, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+void traceClear(void)
+{
+    mutexLock(&g_traceMutex);
+    for (TraceBuffer* buf = g_traceBuffers; buf; buf = buf->next)
+        __atomic_store_n(&buf->pos, 0, __ATOMIC_RELEASE);
+    mutexUnlock(&g_traceMutex);
+}
+
+static TraceBuffer* _traceGetThreadBuffer(void)
+{
+    TraceBuffer* buf = (TraceBuffer*)threadTlsGet(g_traceTlsSlot);
+    if (buf)
+        return buf;
+
+    mutexLock(&g_traceMutex);
+    if (g_traceCapacity) {
+        for (buf = g_traceBuffers; buf && !buf->exited; buf = buf->next);
+        if (!buf) {
+            buf = (TraceBuffer*)__libnx_alloc(sizeof(TraceBuffer) + sizeof(TraceEvent) * g_traceCapacity);
+            if (buf) {
+                buf->next = g_traceBuffers;
+                g_traceBuffers = buf;
+            }
+        }
+        if (buf) {
+            buf->exited = false;
+            __atomic_store_n(&buf->pos, 0, __ATOMIC_RELEASE);
+            if (R_FAILED(svcGetThreadId(&buf->thread_id, CUR_THREAD_HANDLE)))
+                buf->thread_id = 0;
+            threadTlsSet(g_traceTlsSlot, buf);
+        }
+    }
+    mutexUnlock(&g_traceMutex);
+
+    return buf;
+}
+
+void traceRecord(TraceEventType type, const char* name, u64 value)
+{
+    // Recording after traceExit (or before traceInitialize) is a no-op.
+    u32 capacity = __atomic_load_n(&g_traceCapacity, __ATOMIC_ACQUIRE);
+    if (!capacity)
+        return;
+
+    u64 tick = armGetSystemTick();
+    TraceBuffer* buf = _traceGetThreadBuffer();
+    if (!buf)
+        return;
+
+    u32 pos = buf->pos;
+    TraceEvent* ev = &buf->events[pos & (capacity - 1)];
+    ev->tick = tick;
+    ev->name = name;
+    ev->value = value;
+    ev->type = type;
+    __atomic_store_n(&buf->pos, pos + 1, __ATOMIC_RELEASE);
+}
+
+Result traceSendSyncRequest(Handle session, u32 request_id)
+{
+    traceBegin("ipc", request_id);
+    Result rc = svcSendSyncRequest(session);
+    traceEnd("ipc", request_id);
+    return rc;
+}
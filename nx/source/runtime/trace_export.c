@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include "result.h"
+#include "arm/counter.h"
+#include "kernel/mutex.h"
+#include "runtime/trace.h"
+#include "runtime/trace_file.h"
+#include "trace_internal.h"
+
+static bool _traceWriteEvent(TraceWriteFunc func, void* user, const TraceEvent* ev, u64 thread_id, bool first)
+{
+    static const char* const phases[] = { "B", "E", "i", "C" };
+    char line[0x100];
+    u64 ns = armTicksToNs(ev->tick);
+    int len;
+
+    if (ev->type == TraceEventType_Counter)
+        len = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lu.%03lu,\"pid\":0,\"tid\":%lu,\"args\":{\"value\":%lu}}",
+            first ? "" : ",", ev->name, ns / 1000, ns % 1000, thread_id, ev->value);
+    else
+        len = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"%s\",%s\"ts\":%lu.%03lu,\"pid\":0,\"tid\":%lu,\"args\":{\"arg\":%lu}}",
+            first ? "" : ",", ev->name, phases[ev->type & 3], ev->type == TraceEventType_Instant ? "\"s\":\"t\"," : "",
+            ns / 1000, ns % 1000, thread_id, ev->value);
+
+    if (len < 0)
+        return false;
+    return func(line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1, user);
+}
+
+Result traceExportChromeJson(TraceWriteFunc func, void* user)
+{
+    static const char header[] = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    static const char footer[] = "\n]}\n";
+    bool ok = func(header, sizeof(header) - 1, user);
+    bool first = true;
+
+    mutexLock(&g_traceMutex);
+    for (TraceBuffer* buf = g_traceBuffers; ok && buf; buf = buf->next) {
+        u32 end = __atomic_load_n(&buf->pos, __ATOMIC_ACQUIRE);
+        u32 start = end > g_traceCapacity ? end - g_traceCapacity : 0;
+        for (u32 i = start; ok && i != end; i ++) {
+            ok = _traceWriteEvent(func, user, &buf->events[i & (g_traceCapacity - 1)], buf->thread_id, first);
+            first = false;
+        }
+    }
+    mutexUnlock(&g_traceMutex);
+
+    if (ok)
+        ok = func(footer, sizeof(footer) - 1, user);
+    return ok ? 0 : MAKERESULT(Module_Libnx, LibnxError_IoError);
+}
+
+static bool _traceFileWrite(const void* data, size_t size, void* user)
+{
+    return fwrite(data, 1, size, (FILE*)user) == size;
+}
+
+Result traceWriteChromeJson(FILE* f)
+{
+    return traceExportChromeJson(_traceFileWrite, f);
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "types.h"
+#include "kernel/mutex.h"
+#include "runtime/trace.h"
+
+typedef struct TraceBuffer TraceBuffer;
+
+struct TraceBuffer {
+    TraceBuffer* next;
+    u64 thread_id;
+    u32 pos;          // Number of events written so far, only modified by the owner thread.
+    bool exited;      // The owner thread exited, the buffer can be handed to a new thread.
+    TraceEvent events[];
+};
+
+extern Mutex g_traceMutex;
+extern TraceBuffer* g_traceBuffers; // Protected by g_traceMutex.
+extern u32 g_traceCapacity;
@@ -20,7 +20,7 @@ typedef struct {
     s32 voice_count;
     s32 sink_count;
     s32 effect_count;
-    s32 unk1;
+    s32 perf_frame_count;
     u8  unk2;
     u8  _padding1[3];
     s32 splitter_count;
@@ -49,6 +49,8 @@ Result _audrenInitialize(const AudioRendererConfig* config) {
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
     if (config->num_mix_buffers < 1 || config->num_mix_buffers > 256)
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    if (config->num_perf_frames < 0 || config->num_perf_frames > 256)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
 
     // Choose revision (i.e. if splitters are used then at least revision 2 must be used)
     u32 hosver = hosversionGet();
@@ -74,6 +76,7 @@ Result _audrenInitialize(const AudioRendererConfig* config) {
     param.voice_count      = config->num_voices;
     param.sink_count       = config->num_sinks;
     param.effect_count     = config->num_effects;
+    param.perf_frame_count = config->num_perf_frames;
     param.revision         = g_audrenRevision;
 
     // Open IAudioRendererManager
@@ -3,6 +3,7 @@
 #include "service_guard.h"
 #include "sf/sessionmgr.h"
 #include "runtime/hosversion.h"
+#include "runtime/trace.h"
 #include "services/fs.h"
 
 __attribute__((weak)) u32 __nx_fs_num_sessions = 3;
@@ -985,10 +986,13 @@ Result fsFileRead(FsFile* f, s64 off, void* buf, u64 read_size, u32 option, u64*
         u64 read_size;
     } in = { option, 0, off, read_size };
 
-    return _fsObjectDispatchInOut(&f->s, 0, in, *bytes_read,
+    traceBegin("fsFileRead", read_size);
+    Result rc = _fsObjectDispatchInOut(&f->s, 0, in, *bytes_read,
         .buffer_attrs = { SfBufferAttr_HipcMapAlias | SfBufferAttr_Out | SfBufferAttr_HipcMapTransferAllowsNonSecure },
         .buffers = { { buf, read_size } },
     );
+    traceEnd("fsFileRead", read_size);
+    return rc;
 }
 
 Result fsFileWrite(FsFile* f, s64 off, const void* buf, u64 write_size, u32 option) {
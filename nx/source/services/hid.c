@@ -420,6 +420,71 @@ static size_t _hidGetStates(HidCommonLifoHeader *header, void* in_states, size_t
     return total_entries;
 }
 
+// Maximum number of times a torn entry is re-read before giving up on it (and on anything older).
+#define HID_STATE_CURSOR_MAX_RETRIES 3
+
+static size_t _hidGetNewStates(HidCommonLifoHeader *header, void* in_states, size_t max_states, size_t state_offset, size_t sampling_number_offset, HidStateCursor *cursor, void* states, size_t entrysize, size_t count) {
+    s32 total_entries = (s32)atomic_load_explicit(&header->count, memory_order_acquire);
+    if (total_entries < 0) total_entries = 0;
+    if (total_entries > max_states) total_entries = max_states;
+    s32 tail = (s32)atomic_load_explicit(&header->tail, memory_order_acquire);
+
+    // Find the newest entry to return: when more entries are unread than fit in the output, return the oldest ones
+    // and leave the rest for the next call.
+    u64 newest_wanted = UINT64_MAX;
+    u64 first_sampling_number = 0;
+    s32 num_new = 0;
+    for (; num_new<total_entries; num_new++) {
+        s32 entrypos = ((tail + max_states) - num_new) % max_states;
+        u64 sampling_number = atomic_load_explicit((u64*)((uintptr_t)in_states + entrypos*(state_offset+entrysize)), memory_order_acquire);
+        if (num_new == 0) {
+            // The sampling number went backwards (controller reconnected, shared memory re-initialized...): restart from the newest entry.
+            if (sampling_number < cursor->next_sampling_number) cursor->next_sampling_number = sampling_number;
+            first_sampling_number = sampling_number;
+        }
+        else if (sampling_number != first_sampling_number-num_new) break;
+        if (sampling_number < cursor->next_sampling_number) break;
+    }
+    if ((size_t)num_new > count)
+        newest_wanted = first_sampling_number - (num_new - count);
+
+    // Walk from the newest entry backwards, skipping the entries left for later and stopping at the first already-consumed entry.
+    size_t total = 0;
+    u64 prev_sampling_number = 0;
+    for (s32 i=0; i<total_entries && total<count; i++) {
+        s32 entrypos = ((tail + max_states) - i) % max_states;
+        void* state_entry = (void*)((uintptr_t)in_states + entrypos*(state_offset+entrysize));
+        void* out_state = (void*)((uintptr_t)states + total*entrysize);
+
+        u64 sampling_number0=0, sampling_number1=0;
+        bool torn = true;
+        for (s32 retry=0; torn && retry<HID_STATE_CURSOR_MAX_RETRIES; retry++) {
+            sampling_number0 = atomic_load_explicit((u64*)state_entry, memory_order_acquire);
+            memcpy(out_state, (void*)((uintptr_t)state_entry + state_offset), entrysize);
+            sampling_number1 = atomic_load_explicit((u64*)state_entry, memory_order_acquire);
+            torn = sampling_number0 != sampling_number1;
+        }
+
+        // Stop on an entry that is still being written, or that was overwritten by newer data since the walk started.
+        u64 sampling_number = *((u64*)((uintptr_t)out_state+sampling_number_offset));
+        if (torn || (i>0 && sampling_number != prev_sampling_number-1)) break;
+        if (sampling_number < cursor->next_sampling_number) break;
+
+        prev_sampling_number = sampling_number;
+        if (sampling_number <= newest_wanted)
+            total++;
+    }
+
+    if (total) {
+        u64 oldest = *((u64*)((uintptr_t)states + (total-1)*entrysize + sampling_number_offset));
+        if (cursor->next_sampling_number && oldest > cursor->next_sampling_number)
+            cursor->dropped_count += oldest - cursor->next_sampling_number;
+        cursor->next_sampling_number = *((u64*)((uintptr_t)states + sampling_number_offset)) + 1;
+    }
+
+    return total;
+}
+
 void hidInitializeTouchScreen(void) {
     Result rc = _hidActivateTouchScreen();
     if (R_FAILED(rc)) diagAbortWithResult(rc);
@@ -438,6 +503,19 @@ size_t hidGetTouchScreenStates(HidTouchScreenState *states, size_t count) {
     return total;
 }
 
+size_t hidGetTouchScreenStatesSince(HidStateCursor *cursor, HidTouchScreenState *states, size_t count) {
+    HidSharedMemory *sharedmem = (HidSharedMemory*)hidGetSharedmemAddr();
+    if (sharedmem == NULL)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+
+    size_t total = _hidGetNewStates(&sharedmem->touchscreen.lifo.header, sharedmem->touchscreen.lifo.storage, 17, offsetof(HidTouchScreenStateAtomicStorage,state), offsetof(HidTouchScreenState,sampling_number), cursor, states, sizeof(HidTouchScreenState), count);
+    size_t max_touches = sizeof(states[0].touches)/sizeof(states[0].touches[0]);
+    for (size_t i=0; i<total; i++) {
+        if (states[i].count > max_touches) states[i].count = max_touches;
+    }
+    return total;
+}
+
 void hidInitializeMouse(void) {
     Result rc = _hidActivateMouse();
     if (R_FAILED(rc)) diagAbortWithResult(rc);
@@ -452,6 +530,14 @@ size_t hidGetMouseStates(HidMouseState *states, size_t count) {
     return total;
 }
 
+size_t hidGetMouseStatesSince(HidStateCursor *cursor, HidMouseState *states, size_t count) {
+    HidSharedMemory *sharedmem = (HidSharedMemory*)hidGetSharedmemAddr();
+    if (sharedmem == NULL)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+
+    return _hidGetNewStates(&sharedmem->mouse.lifo.header, sharedmem->mouse.lifo.storage, 17, offsetof(HidMouseStateAtomicStorage,state), offsetof(HidMouseState,sampling_number), cursor, states, sizeof(HidMouseState), count);
+}
+
 void hidInitializeKeyboard(void) {
     Result rc = _hidActivateKeyboard();
     if (R_FAILED(rc)) diagAbortWithResult(rc);
@@ -466,6 +552,14 @@ size_t hidGetKeyboardStates(HidKeyboardState *states, size_t count) {
     return total;
 }
 
+size_t hidGetKeyboardStatesSince(HidStateCursor *cursor, HidKeyboardState *states, size_t count) {
+    HidSharedMemory *sharedmem = (HidSharedMemory*)hidGetSharedmemAddr();
+    if (sharedmem == NULL)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_NotInitialized));
+
+    return _hidGetNewStates(&sharedmem->keyboard.lifo.header, sharedmem->keyboard.lifo.storage, 17, offsetof(HidKeyboardStateAtomicStorage,state), offsetof(HidKeyboardState,sampling_number), cursor, states, sizeof(HidKeyboardState), count);
+}
+
 size_t hidGetHomeButtonStates(HidHomeButtonState *states, size_t count) {
     HidSharedMemory *sharedmem = (HidSharedMemory*)hidGetSharedmemAddr();
     if (sharedmem == NULL)
@@ -503,6 +597,51 @@ static size_t _hidGetNpadStates(HidNpadCommonLifo *lifo, HidNpadCommonState *sta
     return _hidGetStates(&lifo->header, lifo->storage, 17, offsetof(HidNpadCommonStateAtomicStorage,state), offsetof(HidNpadCommonState,sampling_number), states, sizeof(HidNpadCommonState), count);
 }
 
+size_t hidGetNpadStatesSince(HidNpadIdType id, HidNpadStyleTag style, HidStateCursor *cursor, HidNpadCommonState *states, size_t count) {
+    HidNpadInternalState *npad = _hidGetNpadInternalState(id);
+    HidNpadCommonLifo *lifo = NULL;
+    switch (style) {
+        case HidNpadStyleTag_NpadFullKey:
+        case HidNpadStyleTag_NpadGc:
+        case HidNpadStyleTag_NpadLark:
+        case HidNpadStyleTag_NpadLucia:
+        case HidNpadStyleTag_NpadLager:
+            lifo = &npad->full_key_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadHandheld:
+        case HidNpadStyleTag_NpadHandheldLark:
+            lifo = &npad->handheld_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadJoyDual:
+            lifo = &npad->joy_dual_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadJoyLeft:
+            lifo = &npad->joy_left_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadJoyRight:
+            lifo = &npad->joy_right_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadPalma:
+            lifo = &npad->palma_lifo;
+        break;
+
+        case HidNpadStyleTag_NpadSystemExt:
+        case HidNpadStyleTag_NpadSystem:
+            lifo = &npad->system_ext_lifo;
+        break;
+
+        default:
+        return 0;
+    }
+
+    return _hidGetNewStates(&lifo->header, lifo->storage, 17, offsetof(HidNpadCommonStateAtomicStorage,state), offsetof(HidNpadCommonState,sampling_number), cursor, states, sizeof(HidNpadCommonState), count);
+}
+
 size_t hidGetNpadStatesFullKey(HidNpadIdType id, HidNpadFullKeyState *states, size_t count) {
     size_t total = _hidGetNpadStates(&_hidGetNpadInternalState(id)->full_key_lifo, states, count);
 
@@ -722,8 +861,7 @@ size_t hidGetNpadStatesSystem(HidNpadIdType id, HidNpadSystemState *states, size
     return total;
 }
 
-size_t hidGetSixAxisSensorStates(HidSixAxisSensorHandle handle, HidSixAxisSensorState *states, size_t count) {
-    HidNpadSixAxisSensorLifo *lifo = NULL;
+static HidNpadSixAxisSensorLifo* _hidGetSixAxisSensorLifo(HidSixAxisSensorHandle handle) {
     HidNpadInternalState *npad = _hidGetNpadInternalState(handle.player_number);
     switch(_hidGetSixAxisSensorHandleNpadStyleIndex(handle)) {
         default:
@@ -731,36 +869,43 @@ size_t hidGetSixAxisSensorStates(HidSixAxisSensorHandle handle, HidSixAxisSensor
 
         case 0: // NpadFullKey/NpadPalma
         case 5: // NpadGc (not actually returned by GetHandles, NpadFullKey is used instead)
-            lifo = &npad->full_key_six_axis_sensor_lifo;
-        break;
+            return &npad->full_key_six_axis_sensor_lifo;
 
         case 1: // NpadHandheld/NpadHandheldLark
-            lifo = &npad->handheld_six_axis_sensor_lifo;
-        break;
+            return &npad->handheld_six_axis_sensor_lifo;
 
         case 2: // NpadJoyDual
-            if (handle.device_idx==0) lifo = &npad->joy_dual_left_six_axis_sensor_lifo;
-            else if (handle.device_idx==1) lifo = &npad->joy_dual_right_six_axis_sensor_lifo;
+            if (handle.device_idx==0) return &npad->joy_dual_left_six_axis_sensor_lifo;
+            else if (handle.device_idx==1) return &npad->joy_dual_right_six_axis_sensor_lifo;
             else diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_ShouldNotHappen));
-        break;
 
         case 3: // NpadJoyLeft
-            lifo = &npad->joy_left_six_axis_sensor_lifo;
-        break;
+            return &npad->joy_left_six_axis_sensor_lifo;
 
         case 4: // NpadJoyRight
-            lifo = &npad->joy_right_six_axis_sensor_lifo;
-        break;
+            return &npad->joy_right_six_axis_sensor_lifo;
 
         case 29: // System(Ext) (not actually returned by GetHandles)
         case 30:
-        return 0;
+        return NULL;
     }
+}
+
+size_t hidGetSixAxisSensorStates(HidSixAxisSensorHandle handle, HidSixAxisSensorState *states, size_t count) {
+    HidNpadSixAxisSensorLifo *lifo = _hidGetSixAxisSensorLifo(handle);
+    if (lifo == NULL) return 0;
 
     size_t total = _hidGetStates(&lifo->header, lifo->storage, 17, offsetof(HidSixAxisSensorStateAtomicStorage,state), offsetof(HidSixAxisSensorState,sampling_number), states, sizeof(HidSixAxisSensorState), count);
     return total;
 }
 
+size_t hidGetSixAxisSensorStatesSince(HidSixAxisSensorHandle handle, HidStateCursor *cursor, HidSixAxisSensorState *states, size_t count) {
+    HidNpadSixAxisSensorLifo *lifo = _hidGetSixAxisSensorLifo(handle);
+    if (lifo == NULL) return 0;
+
+    return _hidGetNewStates(&lifo->header, lifo->storage, 17, offsetof(HidSixAxisSensorStateAtomicStorage,state), offsetof(HidSixAxisSensorState,sampling_number), cursor, states, sizeof(HidSixAxisSensorState), count);
+}
+
 void hidInitializeGesture(void) {
     Result rc = _hidActivateGesture();
     if (R_FAILED(rc)) diagAbortWithResult(rc);